@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_BENCH_H
+#define NETB_BENCH_H
+
+#include "EventLoop.hpp"
+#include "Histogram.hpp"
+#include <chrono>
+#include <future>
+#include <thread>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+NETB_BEGIN
+
+// Nanoseconds of monotonic clock
+inline int64_t BenchNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Run a function in loop thread and wait until it is done
+inline void RunInLoop(EventLoop* loop, const std::function<void ()>& f)
+{
+    std::promise<void> done;
+    loop->Invoke([&f, &done]()
+    {
+        f();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+// Deterministic pseudo random numbers, so that runs are repeatable
+class BenchRandom
+{
+public:
+    explicit BenchRandom(uint64_t seed = 0x9e3779b97f4a7c15ULL) : _state(seed) { }
+
+    uint64_t Next()
+    {
+        // xorshift64*
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545f4914f6cdd1dULL;
+    }
+
+    // In [0, n)
+    uint64_t Next(uint64_t n) { return Next() % n; }
+
+private:
+    uint64_t _state;
+};
+
+//
+// Command line options as "--name value" or "-n value" pairs, and
+// "--name" alone for flags. Lists are comma separated.
+//
+class BenchOptions
+{
+public:
+    // Short names are mapped to long ones, e.g. {"c", "connections"}
+    BenchOptions(int argc, char* argv[], const std::map<std::string, std::string>& aliases)
+    : _valid(true)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string name = argv[i];
+            if(name.compare(0, 2, "--") == 0)
+            {
+                name = name.substr(2);
+            }
+            else if(name.size() == 2 && name[0] == '-' && aliases.count(name.substr(1)))
+            {
+                name = aliases.find(name.substr(1))->second;
+            }
+            else
+            {
+                _valid = false;
+                continue;
+            }
+            bool flag = i + 1 >= argc || argv[i + 1][0] == '-';
+            _values[name] = flag ? std::string() : argv[++i];
+        }
+    }
+
+    bool Valid() const { return _valid; }
+    bool Has(const std::string& name) const { return _values.count(name) > 0; }
+
+    std::string String(const std::string& name, const std::string& def) const
+    {
+        auto it = _values.find(name);
+        return it == _values.end() ? def : it->second;
+    }
+
+    long Integer(const std::string& name, long def) const
+    {
+        auto it = _values.find(name);
+        return it == _values.end() || it->second.empty() ? def : strtol(it->second.c_str(), nullptr, 0);
+    }
+
+    std::vector<std::string> Strings(const std::string& name, const std::string& def) const
+    {
+        std::vector<std::string> v;
+        std::istringstream iss(String(name, def));
+        std::string s;
+        while(std::getline(iss, s, ','))
+        {
+            if(!s.empty()) v.push_back(s);
+        }
+        return v;
+    }
+
+    std::vector<long> Integers(const std::string& name, const std::string& def) const
+    {
+        std::vector<long> v;
+        std::vector<std::string> ss = Strings(name, def);
+        for(size_t i = 0; i < ss.size(); ++i)
+        {
+            v.push_back(strtol(ss[i].c_str(), nullptr, 0));
+        }
+        return v;
+    }
+
+private:
+    bool _valid;
+    std::map<std::string, std::string> _values;
+};
+
+//
+// Result of one benchmark run as a flat JSON object, fields are kept
+// in the order they are added
+//
+class BenchResult
+{
+public:
+    explicit BenchResult(const std::string& name)
+    {
+        Set("benchmark", name);
+    }
+
+    void Set(const std::string& key, const std::string& value)
+    {
+        std::string s = "\"";
+        for(size_t i = 0; i < value.size(); ++i)
+        {
+            if(value[i] == '"' || value[i] == '\\') s += '\\';
+            s += value[i];
+        }
+        Raw(key, s + "\"");
+    }
+
+    void Set(const std::string& key, const char* value) { Set(key, std::string(value)); }
+
+    void Set(const std::string& key, double value)
+    {
+        char s[32];
+        snprintf(s, sizeof(s), "%.6g", value);
+        Raw(key, s);
+    }
+
+    void Set(const std::string& key, long value) { Raw(key, std::to_string(value)); }
+    void Set(const std::string& key, int value) { Raw(key, std::to_string(value)); }
+    void Set(const std::string& key, uint64_t value) { Raw(key, std::to_string(value)); }
+
+    // Percentiles of a histogram, values are divided by scale,
+    // e.g. 1000 for nanoseconds recorded and microseconds reported
+    void Latency(const std::string& prefix, const Histogram& h, double scale)
+    {
+        Set(prefix + "_p50", h.Percentile(50) / scale);
+        Set(prefix + "_p90", h.Percentile(90) / scale);
+        Set(prefix + "_p99", h.Percentile(99) / scale);
+        Set(prefix + "_p999", h.Percentile(99.9) / scale);
+        Set(prefix + "_max", h.Max() / scale);
+        Set(prefix + "_mean", h.Count() > 0 ? (double)h.Sum() / h.Count() / scale : 0.0);
+    }
+
+    std::string Json() const
+    {
+        std::string s = "{";
+        for(size_t i = 0; i < _fields.size(); ++i)
+        {
+            if(i > 0) s += ", ";
+            s += "\"" + _fields[i].first + "\": " + _fields[i].second;
+        }
+        return s + "}";
+    }
+
+private:
+    std::vector<std::pair<std::string, std::string>> _fields;
+
+    void Raw(const std::string& key, const std::string& value)
+    {
+        _fields.push_back(std::make_pair(key, value));
+    }
+};
+
+// Print a report of results with the build and host, so that numbers
+// of different runs may be compared
+inline void BenchReport(std::ostream& os, const std::string& suite, const std::vector<BenchResult>& results)
+{
+    os << "{\n  \"suite\": \"" << suite << "\",\n";
+    os << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+#ifdef __OPTIMIZE__
+    os << "  \"optimized\": true,\n";
+#else
+    os << "  \"optimized\": false,\n";
+#endif
+    os << "  \"cpus\": " << std::thread::hardware_concurrency() << ",\n";
+    os << "  \"results\": [";
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        os << (i > 0 ? ",\n    " : "\n    ") << results[i].Json();
+    }
+    os << "\n  ]\n}\n";
+}
+
+NETB_END
+
+#endif
@@ -0,0 +1,539 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Bench.h"
+#include "EventLoopThread.hpp"
+#include "AsyncTcpSocket.hpp"
+#include "HttpMessage.hpp"
+#include <fstream>
+#include <thread>
+#include <deque>
+#include <csignal>
+
+NETB_BEGIN
+
+using namespace std::placeholders;
+
+// Protocols of target servers
+enum class MODE
+{
+    ECHO,   // messages of given size are echoed, as examples/echo
+    HTTP    // HTTP/1.1 GET with keep-alive, as examples/http
+};
+
+// Parameters of a run
+struct LoadConfig
+{
+    MODE mode;
+    SocketAddress address;
+    std::string host;
+    double rate;        // requests per second of all threads
+    long connections;
+    long threads;
+    long depth;         // requests in flight per connection
+    long size;          // bytes of echo messages
+    std::string url;    // path of HTTP requests
+    int64_t warmup;     // milliseconds
+    int64_t duration;   // milliseconds
+    int64_t drain;      // milliseconds to wait for responses after sending
+};
+
+//
+// Connection with requests in order. Requests are scheduled at intended
+// times regardless of responses (open loop); those not sent yet as the
+// pipeline is full wait in a queue, so delays of the server are counted
+// into latency instead of slowing down the load.
+//
+class LoadConnection : public AsyncTcpSocket
+{
+public:
+    explicit LoadConnection(EventLoop* loop)
+    : AsyncTcpSocket(loop)
+    , received(0)
+    , dead(false)
+    {
+
+    }
+
+    std::deque<int64_t> waiting;    // intended times of requests not sent yet
+    std::deque<std::pair<int64_t, int64_t>> inflight;   // intended and sending times
+    size_t received;                // bytes of echo to the first request in flight
+    HttpResponse response;          // HTTP response being parsed
+    bool dead;                      // closed by peer or error
+};
+
+//
+// Connections on a loop thread, with a pacer thread that posts requests
+// to the loop at a constant rate. The pacer sleeps to shortly before the
+// next intended time and spins to it, as sleeping overshoots, then posts
+// all requests that are due, so a late wakeup or a busy loop never drops
+// requests from the schedule. The lag from intended to sending time is
+// recorded apart, so that jitter of the generator may be told from
+// queueing of the server.
+//
+class LoadWorker
+{
+public:
+    LoadWorker(const LoadConfig& c, const std::string& request)
+    : sent(0)
+    , completed(0)
+    , measured(0)
+    , errors(0)
+    , closed(0)
+    , _config(c)
+    , _request(request)
+    , _loop(_thread.Start())
+    , _next(0)
+    , _first(0)
+    , _interval(0)
+    , _measure(0)
+    , _end(0)
+    {
+
+    }
+
+    ~LoadWorker()
+    {
+        if(_pacer.joinable())
+        {
+            _pacer.join();
+        }
+        RunInLoop(_loop, [this]()
+        {
+            for(size_t i = 0; i < _connections.size(); ++i)
+            {
+                delete _connections[i];
+            }
+            _connections.clear();
+        });
+    }
+
+    // Connect in block mode, async facility is enabled on success
+    bool Connect(long n, Error* e)
+    {
+        for(long i = 0; i < n; ++i)
+        {
+            LoadConnection* conn = new LoadConnection(_loop);
+            conn->SetOptions(TcpOptions::Latency(), nullptr);
+            if(!conn->Connect(_config.address, e))
+            {
+                delete conn;
+                return false;
+            }
+            conn->SetReceivedCallback(std::bind(&LoadWorker::OnReceived, this, _1, _2));
+            conn->SetConnectedCallback(std::bind(&LoadWorker::OnConnected, this, _1, _2));
+            _connections.push_back(conn);
+        }
+        return true;
+    }
+
+    // Schedule requests at first + k * interval before end, those
+    // scheduled before measure are for warmup and not recorded
+    void Start(int64_t first, double interval, int64_t measure, int64_t end)
+    {
+        _first = first;
+        _interval = interval;
+        _measure = measure;
+        _end = end;
+        _pacer = std::thread(&LoadWorker::Pace, this);
+    }
+
+    // Wait until all requests are scheduled
+    void Join()
+    {
+        _pacer.join();
+    }
+
+    // Requests without response, called in loop thread
+    uint64_t Outstanding() const
+    {
+        uint64_t n = 0;
+        for(size_t i = 0; i < _connections.size(); ++i)
+        {
+            n += _connections[i]->waiting.size() + _connections[i]->inflight.size();
+        }
+        return n;
+    }
+
+    EventLoop* GetLoop() const { return _loop; }
+
+    // Results, only accessed in loop thread or after the loop is idle
+    Histogram corrected;    // from intended time to response
+    Histogram service;      // from sending to response
+    Histogram lag;          // from intended time to sending
+    uint64_t sent;
+    uint64_t completed;     // responses of all requests
+    uint64_t measured;      // responses in measurement
+    uint64_t errors;        // requests lost with closed connections
+    uint64_t closed;        // connections closed
+
+private:
+    const LoadConfig& _config;
+    const std::string& _request;
+    EventLoopThread _thread;
+    EventLoop* _loop;
+    std::thread _pacer;
+    std::vector<LoadConnection*> _connections;
+    size_t _next;           // round robin of connections
+
+    int64_t _first;
+    double _interval;
+    int64_t _measure;
+    int64_t _end;
+
+    // Max requests posted to the loop at once
+    static const size_t BATCH = 1024;
+
+    // Nanoseconds to spin before an intended time, longer than usual
+    // overshoot of sleeping
+    static const int64_t SPIN = 200000;
+
+    // In pacer thread
+    void Pace()
+    {
+        for(uint64_t k = 0; ; )
+        {
+            int64_t next = _first + (int64_t)(k * _interval);
+            if(next >= _end)
+            {
+                break;
+            }
+            int64_t now = BenchNow();
+            if(next > now + SPIN)
+            {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(next - now - SPIN));
+                continue;
+            }
+            if(next > now)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::vector<int64_t> due;
+            while(next <= now && next < _end && due.size() < BATCH)
+            {
+                due.push_back(next);
+                next = _first + (int64_t)(++k * _interval);
+            }
+            _loop->Invoke([this, due]() { Dispatch(due); });
+        }
+    }
+
+    // Assign requests to connections in round robin
+    void Dispatch(const std::vector<int64_t>& due)
+    {
+        for(size_t i = 0; i < due.size(); ++i)
+        {
+            LoadConnection* conn = nullptr;
+            for(size_t j = 0; j < _connections.size() && conn == nullptr; ++j)
+            {
+                LoadConnection* c = _connections[_next++ % _connections.size()];
+                if(!c->dead) conn = c;
+            }
+            if(conn == nullptr)
+            {
+                ++errors;
+                continue;
+            }
+            conn->waiting.push_back(due[i]);
+            Flush(conn);
+        }
+    }
+
+    // Send waiting requests until the pipeline is full
+    void Flush(LoadConnection* conn)
+    {
+        while(!conn->waiting.empty() && conn->inflight.size() < (size_t)_config.depth)
+        {
+            conn->inflight.push_back(std::make_pair(conn->waiting.front(), BenchNow()));
+            conn->waiting.pop_front();
+            conn->Send(_request.data(), _request.size());
+            ++sent;
+        }
+    }
+
+    // Response to the first request in flight
+    void Complete(LoadConnection* conn)
+    {
+        int64_t now = BenchNow();
+        std::pair<int64_t, int64_t> req = conn->inflight.front();
+        conn->inflight.pop_front();
+        ++completed;
+        if(req.first >= _measure)
+        {
+            corrected.Record(now - req.first);
+            service.Record(now - req.second);
+            lag.Record(req.second - req.first);
+        }
+        if(now >= _measure && now < _end)
+        {
+            ++measured;
+        }
+    }
+
+    void OnReceived(AsyncTcpSocket* sock, StreamBuffer* buf)
+    {
+        LoadConnection* conn = static_cast<LoadConnection*>(sock);
+        if(_config.mode == MODE::ECHO)
+        {
+            conn->received += buf->Readable();
+            buf->Clear();
+            while(conn->received >= (size_t)_config.size && !conn->inflight.empty())
+            {
+                conn->received -= _config.size;
+                Complete(conn);
+            }
+        }
+        else
+        {
+            while(buf->Readable() > 0 && conn->response.FromBuffer(buf))
+            {
+                conn->response.Reset();
+                if(!conn->inflight.empty())
+                {
+                    Complete(conn);
+                }
+            }
+        }
+        Flush(conn);
+    }
+
+    // Requests of a closed connection are lost
+    void OnConnected(AsyncTcpSocket* sock, bool connected)
+    {
+        LoadConnection* conn = static_cast<LoadConnection*>(sock);
+        if(!connected && !conn->dead)
+        {
+            conn->dead = true;
+            errors += conn->waiting.size() + conn->inflight.size();
+            conn->waiting.clear();
+            conn->inflight.clear();
+            ++closed;
+        }
+    }
+};
+
+// Return false if connecting fails
+static bool Run(const LoadConfig& c, BenchResult* result)
+{
+    std::string request;
+    if(c.mode == MODE::ECHO)
+    {
+        BenchRandom random;
+        for(long i = 0; i < c.size; ++i)
+        {
+            request += (char)('a' + random.Next(26));
+        }
+    }
+    else
+    {
+        request = "GET " + c.url + " HTTP/1.1\r\n"
+                  "Host: " + c.host + "\r\n"
+                  "User-Agent: netb-loadgen\r\n"
+                  "Accept: */*\r\n\r\n";
+    }
+
+    // Connections are spread over threads, each thread takes a share
+    // of the rate by its connections
+    long threads = std::max(1L, std::min(c.threads, c.connections));
+    std::vector<LoadWorker*> workers;
+    Error e;
+    bool ok = true;
+    for(long i = 0; i < threads && ok; ++i)
+    {
+        LoadWorker* worker = new LoadWorker(c, request);
+        workers.push_back(worker);
+        long n = c.connections / threads + (i < c.connections % threads ? 1 : 0);
+        ok = worker->Connect(n, &e);
+    }
+
+    BenchResult& r = *result;
+    r.Set("mode", c.mode == MODE::ECHO ? "echo" : "http");
+    r.Set("address", c.address.String());
+    r.Set("connections", c.connections);
+    r.Set("threads", threads);
+    r.Set("depth", c.depth);
+    if(c.mode == MODE::ECHO) r.Set("size", c.size);
+    else r.Set("url", c.url);
+    r.Set("target_rate", c.rate);
+    if(!ok)
+    {
+        std::cerr << "Connect failed: " << e.Report() << std::endl;
+        r.Set("error", e.Report());
+        for(size_t i = 0; i < workers.size(); ++i) delete workers[i];
+        return false;
+    }
+
+    // Threads are shifted by a fraction of interval, so that requests
+    // of all threads are evenly spaced
+    int64_t start = BenchNow() + 10000000;
+    int64_t measure = start + c.warmup * 1000000;
+    int64_t end = measure + c.duration * 1000000;
+    for(long i = 0; i < threads; ++i)
+    {
+        long n = c.connections / threads + (i < c.connections % threads ? 1 : 0);
+        double interval = 1e9 * c.connections / (c.rate * n);
+        workers[i]->Start(start + (int64_t)(1e9 / c.rate * i), interval, measure, end);
+    }
+    for(long i = 0; i < threads; ++i)
+    {
+        workers[i]->Join();
+    }
+
+    // Wait for responses of requests in flight
+    int64_t deadline = BenchNow() + c.drain * 1000000;
+    uint64_t unfinished = 0;
+    do
+    {
+        unfinished = 0;
+        for(long i = 0; i < threads; ++i)
+        {
+            RunInLoop(workers[i]->GetLoop(), [&unfinished, &workers, i]()
+            {
+                unfinished += workers[i]->Outstanding();
+            });
+        }
+        if(unfinished > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    while(unfinished > 0 && BenchNow() < deadline);
+
+    Histogram corrected;
+    Histogram service;
+    Histogram lag;
+    uint64_t sent = 0;
+    uint64_t completed = 0;
+    uint64_t measured = 0;
+    uint64_t errors = 0;
+    uint64_t closed = 0;
+    for(long i = 0; i < threads; ++i)
+    {
+        LoadWorker* w = workers[i];
+        RunInLoop(w->GetLoop(), [&, w]()
+        {
+            corrected.Merge(w->corrected);
+            service.Merge(w->service);
+            lag.Merge(w->lag);
+            sent += w->sent;
+            completed += w->completed;
+            measured += w->measured;
+            errors += w->errors;
+            closed += w->closed;
+        });
+        delete w;
+    }
+
+    r.Set("rate", measured * 1000.0 / c.duration);
+    r.Set("sent", sent);
+    r.Set("completed", completed);
+    r.Set("unfinished", unfinished);
+    r.Set("errors", errors);
+    r.Set("closed", closed);
+    r.Latency("latency_us", corrected, 1000);
+    r.Latency("service_us", service, 1000);
+    r.Latency("lag_us", lag, 1000);
+    return true;
+}
+
+NETB_END
+
+/////////////////////////////////////////////////////////////////////////////
+
+static void Usage()
+{
+    std::cerr << "Usage: loadgen [options]\n"
+              << "  -a, --address HOST:PORT  target server (127.0.0.1:9007 for echo, 127.0.0.1:8080 for http)\n"
+              << "  -m, --mode MODE          echo or http (echo)\n"
+              << "  -R, --rate N             requests per second of all connections (1000)\n"
+              << "  -c, --connections N      connections (16)\n"
+              << "  -T, --threads N          loop threads of connections (2)\n"
+              << "  -D, --depth N            requests in flight per connection (1)\n"
+              << "  -s, --size N             bytes of echo messages (64)\n"
+              << "  -u, --url PATH           path of HTTP requests (/)\n"
+              << "  -d, --duration MS        measurement (5000)\n"
+              << "  -w, --warmup MS          warm up before measurement (1000)\n"
+              << "  -o, --output FILE        JSON report, by default to stdout\n";
+}
+
+// Open-loop load generator of echo and HTTP servers
+int main(const int argc, char* argv[])
+{
+    signal(SIGPIPE, SIG_IGN);
+    netb::BenchOptions options(argc, argv, {{"a", "address"}, {"m", "mode"}, {"R", "rate"},
+                                            {"c", "connections"}, {"T", "threads"}, {"D", "depth"},
+                                            {"s", "size"}, {"u", "url"}, {"d", "duration"},
+                                            {"w", "warmup"}, {"o", "output"}, {"h", "help"}});
+    if(!options.Valid() || options.Has("help"))
+    {
+        Usage();
+        return 1;
+    }
+
+    netb::LoadConfig config;
+    std::string mode = options.String("mode", "echo");
+    if(mode == "echo") config.mode = netb::MODE::ECHO;
+    else if(mode == "http") config.mode = netb::MODE::HTTP;
+    else
+    {
+        Usage();
+        return 1;
+    }
+    std::string address = options.String("address", mode == "http" ? "127.0.0.1:8080" : "127.0.0.1:9007");
+    size_t colon = address.rfind(':');
+    if(colon == std::string::npos)
+    {
+        Usage();
+        return 1;
+    }
+    config.host = address.substr(0, colon);
+    config.address = netb::SocketAddress(config.host, (unsigned short)strtol(address.c_str() + colon + 1, nullptr, 10));
+    config.rate = strtod(options.String("rate", "1000").c_str(), nullptr);
+    config.connections = options.Integer("connections", 16);
+    config.threads = options.Integer("threads", 2);
+    config.depth = options.Integer("depth", 1);
+    config.size = options.Integer("size", 64);
+    config.url = options.String("url", "/");
+    config.warmup = options.Integer("warmup", 1000);
+    config.duration = options.Integer("duration", 5000);
+    config.drain = 1000;
+    if(config.rate <= 0 || config.connections <= 0 || config.threads <= 0 ||
+       config.depth <= 0 || config.size <= 0 || config.duration <= 0 || config.warmup < 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    std::vector<netb::BenchResult> results(1, netb::BenchResult("loadgen"));
+    if(!netb::Run(config, &results.back()))
+    {
+        return 1;
+    }
+    std::cerr << results.back().Json() << std::endl;
+
+    std::string output = options.String("output", "");
+    if(output.empty())
+    {
+        netb::BenchReport(std::cout, "loadgen", results);
+        return 0;
+    }
+    std::ofstream ofs(output);
+    netb::BenchReport(ofs, "loadgen", results);
+    return ofs ? 0 : 1;
+}
@@ -0,0 +1,721 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Bench.h"
+#include "EventLoopThread.hpp"
+#include "AsyncTcpAcceptor.hpp"
+#include "AsyncTcpSocket.hpp"
+#include "AsyncUdpSocket.hpp"
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <set>
+#include <csignal>
+
+NETB_BEGIN
+
+using namespace std::placeholders;
+
+// Phases of a run, only changed in the loop of clients
+enum class PHASE
+{
+    WARMUP,
+    MEASURE,
+    STOP
+};
+
+// Parameters of a run
+struct BenchConfig
+{
+    long connections;
+    long size;
+    int64_t warmup;     // milliseconds
+    int64_t duration;   // milliseconds
+};
+
+// Rate per second of count in nanoseconds
+static double PerSecond(uint64_t count, int64_t elapsed)
+{
+    return elapsed > 0 ? count * 1e9 / elapsed : 0.0;
+}
+
+static void Sleep(int64_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+//
+// TCP server on loopback with its own loop thread. Received data is
+// echoed or discarded, or connections are closed once accepted.
+// Options are applied to accepted connections.
+//
+class BenchServer
+{
+public:
+    enum class MODE
+    {
+        ECHO,
+        DISCARD,
+        CLOSE
+    };
+
+    explicit BenchServer(MODE mode, const TcpOptions& options = TcpOptions())
+    : _mode(mode)
+    , _loop(_thread.Start())
+    , _acceptor(_loop)
+    , _accepted(0)
+    , _received(0)
+    {
+        _acceptor.SetOptions(options);
+        _acceptor.SetAcceptedCallback(std::bind(&BenchServer::OnAccepted, this, _1, _2, _3));
+    }
+
+    ~BenchServer()
+    {
+        _acceptor.Close();
+        RunInLoop(_loop, [this]()
+        {
+            for(auto it = _connections.begin(); it != _connections.end(); ++it)
+            {
+                delete *it;
+            }
+            _connections.clear();
+        });
+    }
+
+    bool Open(Error* e)
+    {
+        return _acceptor.Open(SocketAddress("127.0.0.1", 0), true, false, e);
+    }
+
+    SocketAddress Address() const { return _acceptor.Address(); }
+    uint64_t Accepted() const { return _accepted.load(std::memory_order_relaxed); }
+    uint64_t Received() const { return _received.load(std::memory_order_relaxed); }
+
+private:
+    MODE _mode;
+    EventLoopThread _thread;
+    EventLoop* _loop;
+    AsyncTcpAcceptor _acceptor;
+    std::set<AsyncTcpSocket*> _connections;
+    std::atomic<uint64_t> _accepted;
+    std::atomic<uint64_t> _received;
+
+    static void Destroy(AsyncTcpSocket* conn)
+    {
+        delete conn;
+    }
+
+    bool OnAccepted(AsyncTcpAcceptor* acceptor, SOCKET s, const SocketAddress* addr)
+    {
+        _accepted.fetch_add(1, std::memory_order_relaxed);
+        if(_mode == MODE::CLOSE)
+        {
+            return false; // closed by acceptor
+        }
+        AsyncTcpSocket* conn = new (std::nothrow) AsyncTcpSocket(_loop, s, addr);
+        if(!conn)
+        {
+            return false;
+        }
+        conn->SetConnectedCallback(std::bind(&BenchServer::OnConnected, this, _1, _2));
+        conn->SetReceivedCallback(std::bind(&BenchServer::OnReceived, this, _1, _2));
+        if(!conn->Connected(nullptr))
+        {
+            delete conn;
+            return true;
+        }
+        _connections.insert(conn);
+        return true;
+    }
+
+    void OnConnected(AsyncTcpSocket* conn, bool connected)
+    {
+        if(!connected && _connections.erase(conn) > 0)
+        {
+            _loop->InvokeLater(std::bind(&BenchServer::Destroy, conn));
+        }
+    }
+
+    void OnReceived(AsyncTcpSocket* conn, StreamBuffer* buf)
+    {
+        _received.fetch_add(buf->Readable(), std::memory_order_relaxed);
+        if(_mode == MODE::ECHO)
+        {
+            conn->Send(buf);
+        }
+        buf->Clear();
+    }
+};
+
+//
+// Client connection of TCP benchmarks, fields are only used in loop
+//
+class BenchConnection : public AsyncTcpSocket
+{
+public:
+    explicit BenchConnection(EventLoop* loop)
+    : AsyncTcpSocket(loop)
+    , pending(0)
+    , sent_at(0)
+    {
+
+    }
+
+    size_t pending;     // bytes of echo to wait for
+    int64_t sent_at;    // time of sending the message
+};
+
+//
+// Connections of a run on a client loop thread
+//
+class BenchClients
+{
+public:
+    BenchClients()
+    : _loop(_thread.Start())
+    {
+
+    }
+
+    ~BenchClients()
+    {
+        RunInLoop(_loop, [this]()
+        {
+            for(size_t i = 0; i < _connections.size(); ++i)
+            {
+                delete _connections[i];
+            }
+            _connections.clear();
+        });
+    }
+
+    EventLoop* GetLoop() const { return _loop; }
+    const std::vector<BenchConnection*>& Connections() const { return _connections; }
+
+    // Connect in block mode, async facility is enabled on success
+    bool Connect(const SocketAddress& addr, long n, const TcpOptions& options, Error* e)
+    {
+        for(long i = 0; i < n; ++i)
+        {
+            BenchConnection* conn = new BenchConnection(_loop);
+            conn->SetOptions(options, nullptr);
+            if(!conn->Connect(addr, e))
+            {
+                delete conn;
+                return false;
+            }
+            _connections.push_back(conn);
+        }
+        return true;
+    }
+
+private:
+    EventLoopThread _thread;
+    EventLoop* _loop;
+    std::vector<BenchConnection*> _connections;
+};
+
+// Warm up, measure and stop in the loop of clients
+// Return elapsed nanoseconds of measurement
+static int64_t Measure(EventLoop* loop, const BenchConfig& c, PHASE* phase,
+                       const std::function<void ()>& start = nullptr,
+                       const std::function<void ()>& stop = nullptr)
+{
+    int64_t begin = 0;
+    int64_t end = 0;
+    Sleep(c.warmup);
+    RunInLoop(loop, [&]()
+    {
+        *phase = PHASE::MEASURE;
+        if(start) start();
+        begin = BenchNow();
+    });
+    Sleep(c.duration);
+    RunInLoop(loop, [&]()
+    {
+        end = BenchNow();
+        *phase = PHASE::STOP;
+        if(stop) stop();
+    });
+    return end - begin;
+}
+
+static void Parameters(BenchResult* r, const BenchConfig& c)
+{
+    r->Set("connections", c.connections);
+    r->Set("size", c.size);
+    r->Set("duration_ms", (long)c.duration);
+}
+
+//
+// Round trip latency of echo, one message in flight per connection,
+// with latency profile of TCP options on both sides
+//
+static BenchResult TcpPingPong(const BenchConfig& c)
+{
+    BenchResult r("tcp_pingpong");
+    Parameters(&r, c);
+    Error e;
+    BenchServer server(BenchServer::MODE::ECHO, TcpOptions::Latency());
+    BenchClients clients;
+    if(!server.Open(&e) || !clients.Connect(server.Address(), c.connections, TcpOptions::Latency(), &e))
+    {
+        r.Set("error", e.Report());
+        return r;
+    }
+    std::string payload(c.size, 'x');
+    Histogram latency;
+    uint64_t messages = 0;
+    PHASE phase = PHASE::WARMUP;
+    auto send = [&](BenchConnection* conn)
+    {
+        conn->pending = payload.size();
+        conn->sent_at = BenchNow();
+        conn->Send(payload.data(), payload.size());
+    };
+    auto received = [&](AsyncTcpSocket* sock, StreamBuffer* buf)
+    {
+        BenchConnection* conn = static_cast<BenchConnection*>(sock);
+        conn->pending -= std::min(conn->pending, buf->Readable());
+        buf->Clear();
+        if(conn->pending > 0)
+        {
+            return;
+        }
+        if(phase == PHASE::MEASURE)
+        {
+            latency.Record(BenchNow() - conn->sent_at);
+            ++messages;
+        }
+        if(phase != PHASE::STOP)
+        {
+            send(conn);
+        }
+    };
+    RunInLoop(clients.GetLoop(), [&]()
+    {
+        for(auto conn : clients.Connections())
+        {
+            conn->SetReceivedCallback(received);
+            send(conn);
+        }
+    });
+    int64_t elapsed = Measure(clients.GetLoop(), c, &phase);
+    r.Set("messages", messages);
+    r.Set("messages_per_sec", PerSecond(messages, elapsed));
+    r.Latency("latency_us", latency, 1000.0);
+    return r;
+}
+
+//
+// Bulk transfer to a discarding server, sending buffers are kept
+// between watermarks so that the socket is never idle
+//
+static BenchResult TcpThroughput(const BenchConfig& c)
+{
+    static const size_t LOW_WATERMARK = 64 * 1024;
+    static const size_t HIGH_WATERMARK = 256 * 1024;
+    BenchResult r("tcp_throughput");
+    Parameters(&r, c);
+    Error e;
+    BenchServer server(BenchServer::MODE::DISCARD);
+    BenchClients clients;
+    if(!server.Open(&e) || !clients.Connect(server.Address(), c.connections, TcpOptions(), &e))
+    {
+        r.Set("error", e.Report());
+        return r;
+    }
+    std::string payload(c.size, 'x');
+    PHASE phase = PHASE::WARMUP;
+    EventLoop* loop = clients.GetLoop();
+    // Fill up to high watermark, but yield to the loop after a round,
+    // in case the server drains as fast as it is filled
+    std::function<void (AsyncTcpSocket*)> pump = [&](AsyncTcpSocket* conn)
+    {
+        for(size_t n = 0; phase != PHASE::STOP && conn->Buffered() < HIGH_WATERMARK && n < HIGH_WATERMARK; n += payload.size())
+        {
+            conn->Send(payload.data(), payload.size());
+        }
+        if(phase != PHASE::STOP && conn->Buffered() < HIGH_WATERMARK)
+        {
+            loop->InvokeLater([&pump, conn]() { pump(conn); });
+        }
+    };
+    RunInLoop(loop, [&]()
+    {
+        for(auto conn : clients.Connections())
+        {
+            conn->SetWatermarks(LOW_WATERMARK, HIGH_WATERMARK);
+            conn->SetLowWatermarkCallback(std::bind(pump, _1));
+            conn->SetAutoCork(false);
+            pump(conn);
+        }
+    });
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    int64_t elapsed = Measure(loop, c, &phase, [&]() { begin = server.Received(); },
+                                               [&]() { end = server.Received(); });
+    RunInLoop(loop, [&]()
+    {
+        // Pumping in queue is done before this, and stops
+        for(auto conn : clients.Connections())
+        {
+            conn->SetLowWatermarkCallback(nullptr);
+        }
+    });
+    r.Set("bytes", end - begin);
+    r.Set("bytes_per_sec", PerSecond(end - begin, elapsed));
+    r.Set("messages_per_sec", PerSecond((end - begin) / payload.size(), elapsed));
+    return r;
+}
+
+//
+// Datagrams echoed per second, with a window of datagrams in flight
+// per socket. Datagrams are no larger than the receiving buffer.
+//
+static BenchResult UdpPps(const BenchConfig& c)
+{
+    static const int WINDOW = 16;
+    BenchResult r("udp_pps");
+    BenchConfig config = c;
+    config.size = std::min<long>(c.size, RECEIVE_BUFFER_SIZE);
+    Parameters(&r, config);
+    Error e;
+    EventLoopThread server_thread;
+    AsyncUdpSocket server(server_thread.Start());
+    server.SetReceivedCallback([](AsyncUdpSocket* sock, StreamBuffer* buf, const SocketAddress* addr)
+    {
+        sock->SendTo(buf, addr);
+        buf->Clear();
+    });
+    if(!server.Open(SocketAddress("127.0.0.1", 0), &e))
+    {
+        r.Set("error", e.Report());
+        return r;
+    }
+    SocketAddress addr = server.Address();
+    EventLoopThread client_thread;
+    EventLoop* loop = client_thread.Start();
+    std::vector<std::unique_ptr<AsyncUdpSocket>> clients;
+    std::string payload(config.size, 'x');
+    PHASE phase = PHASE::WARMUP;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t measured = 0;
+    auto echoed = [&](AsyncUdpSocket* sock, StreamBuffer* buf, const SocketAddress* from)
+    {
+        buf->Clear();
+        ++received;
+        if(phase == PHASE::MEASURE)
+        {
+            ++measured;
+        }
+        if(phase != PHASE::STOP)
+        {
+            sock->SendTo(payload.data(), payload.size(), addr);
+            ++sent;
+        }
+    };
+    for(long i = 0; i < config.connections; ++i)
+    {
+        clients.push_back(std::unique_ptr<AsyncUdpSocket>(new AsyncUdpSocket(loop)));
+        clients.back()->SetReceivedCallback(echoed);
+        if(!clients.back()->Open(SocketAddress("127.0.0.1", 0), &e))
+        {
+            r.Set("error", e.Report());
+            RunInLoop(loop, [&]() { clients.clear(); });
+            return r;
+        }
+    }
+    RunInLoop(loop, [&]()
+    {
+        for(size_t i = 0; i < clients.size(); ++i)
+        {
+            for(int j = 0; j < WINDOW; ++j, ++sent)
+            {
+                clients[i]->SendTo(payload.data(), payload.size(), addr);
+            }
+        }
+    });
+    int64_t elapsed = Measure(loop, config, &phase);
+    Sleep(100); // datagrams in flight
+    RunInLoop(loop, [&]()
+    {
+        r.Set("packets", measured);
+        r.Set("packets_per_sec", PerSecond(measured, elapsed));
+        r.Set("lost", sent - received);
+        clients.clear();
+    });
+    server.Close();
+    return r;
+}
+
+//
+// Connections accepted per second. Clients connect in block mode and
+// wait for the server to close, so that TIME_WAIT is left on the server
+// side and does not run out of local ports.
+//
+static BenchResult AcceptRate(const BenchConfig& c)
+{
+    BenchResult r("accept_rate");
+    r.Set("connections", c.connections);
+    r.Set("duration_ms", (long)c.duration);
+    Error e;
+    BenchServer server(BenchServer::MODE::CLOSE);
+    if(!server.Open(&e))
+    {
+        r.Set("error", e.Report());
+        return r;
+    }
+    SocketAddress addr = server.Address();
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> errors(0);
+    std::vector<std::thread> threads;
+    for(long i = 0; i < c.connections; ++i)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                TcpSocket sock(AF_INET);
+                char ch;
+                if(!sock.Connect(addr, nullptr) || sock.Receive(&ch, 1, nullptr) != 0)
+                {
+                    errors.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }));
+    }
+    Sleep(c.warmup);
+    uint64_t begin = server.Accepted();
+    int64_t start = BenchNow();
+    Sleep(c.duration);
+    uint64_t end = server.Accepted();
+    int64_t elapsed = BenchNow() - start;
+    stop = true;
+    for(size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    r.Set("accepted", end - begin);
+    r.Set("accepts_per_sec", PerSecond(end - begin, elapsed));
+    r.Set("errors", errors.load());
+    return r;
+}
+
+//
+// Functions posted to a loop from other threads per second, and the
+// time they wait in the queue. Each producer keeps a bounded number of
+// functions outstanding, so that the queue does not grow without limit.
+//
+static BenchResult InvokeRate(const BenchConfig& c)
+{
+    static const uint64_t OUTSTANDING = 1024;
+    static const uint64_t SAMPLE_MASK = 63; // time 1 in 64 functions
+    BenchResult r("invoke_rate");
+    r.Set("producers", c.connections);
+    r.Set("duration_ms", (long)c.duration);
+    EventLoopThread thread;
+    EventLoop* loop = thread.Start();
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> executed(0);
+    Histogram latency;
+    PHASE phase = PHASE::WARMUP;
+    std::vector<std::atomic<uint64_t>> outstanding(c.connections);
+    std::vector<std::thread> threads;
+    for(long i = 0; i < c.connections; ++i)
+    {
+        outstanding[i] = 0;
+        threads.push_back(std::thread([&, i]()
+        {
+            std::atomic<uint64_t>* count = &outstanding[i];
+            for(uint64_t n = 0; !stop.load(std::memory_order_relaxed); ++n)
+            {
+                if(count->load(std::memory_order_relaxed) >= OUTSTANDING)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                count->fetch_add(1, std::memory_order_relaxed);
+                int64_t posted = (n & SAMPLE_MASK) == 0 ? BenchNow() : 0;
+                loop->InvokeLater([&, count, posted]()
+                {
+                    count->fetch_sub(1, std::memory_order_relaxed);
+                    executed.store(executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    if(posted > 0 && phase == PHASE::MEASURE)
+                    {
+                        latency.Record(BenchNow() - posted);
+                    }
+                });
+            }
+        }));
+    }
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    int64_t elapsed = Measure(loop, c, &phase, [&]() { begin = executed.load(); },
+                                               [&]() { end = executed.load(); });
+    stop = true;
+    for(size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    RunInLoop(loop, []() { }); // drain
+    r.Set("invoked", end - begin);
+    r.Set("invokes_per_sec", PerSecond(end - begin, elapsed));
+    r.Latency("queue_wait_us", latency, 1000.0);
+    return r;
+}
+
+//
+// Scheduling, moving and cancelling timers of the loop, as connections
+// do with their deadlines. Deadlines are far enough that none expires.
+//
+static BenchResult TimerChurn(const BenchConfig& c)
+{
+    BenchResult r("timer_churn");
+    r.Set("timers", c.connections);
+    r.Set("duration_ms", (long)c.duration);
+    EventLoopThread thread;
+    EventLoop* loop = thread.Start();
+    uint64_t ops = 0;
+    int64_t elapsed = 0;
+    RunInLoop(loop, [&]()
+    {
+        std::vector<EventLoop::Timer> timers(c.connections);
+        BenchRandom random;
+        int64_t now = loop->Now();
+        for(size_t i = 0; i < timers.size(); ++i)
+        {
+            loop->ScheduleTimer(&timers[i], now + 1000 + random.Next(60000));
+        }
+        int64_t begin = BenchNow();
+        int64_t end = begin + c.duration * 1000000;
+        int64_t t = begin;
+        while(t < end)
+        {
+            for(int i = 0; i < 1024; ++i, ++ops)
+            {
+                EventLoop::Timer& timer = timers[random.Next(timers.size())];
+                uint64_t op = random.Next(4);
+                if(op == 0)
+                {
+                    loop->CancelTimer(&timer);
+                }
+                else if(op == 3 && timer.Active())
+                {
+                    timer.Deadline(timer.Deadline() + random.Next(1000)); // refresh on I/O
+                }
+                else
+                {
+                    loop->ScheduleTimer(&timer, now + 1000 + random.Next(60000));
+                }
+            }
+            t = BenchNow();
+        }
+        elapsed = t - begin;
+        for(size_t i = 0; i < timers.size(); ++i)
+        {
+            loop->CancelTimer(&timers[i]);
+        }
+    });
+    r.Set("ops", ops);
+    r.Set("ops_per_sec", PerSecond(ops, elapsed));
+    r.Set("ns_per_op", ops > 0 ? (double)elapsed / ops : 0.0);
+    return r;
+}
+
+NETB_END
+
+/////////////////////////////////////////////////////////////////////////////
+
+static void Usage()
+{
+    std::cerr << "Usage: netbench [options]\n"
+              << "  -b, --bench NAMES        tcp_pingpong,tcp_throughput,udp_pps,accept_rate,invoke_rate,timer_churn\n"
+              << "  -c, --connections LIST   connections of TCP and UDP benchmarks (1,16)\n"
+              << "  -s, --sizes LIST         message sizes in bytes (64,4096)\n"
+              << "  -p, --producers LIST     threads posting to the loop (1,4)\n"
+              << "  -t, --timers LIST        active timers (1000,100000)\n"
+              << "  -d, --duration MS        measurement of each run (1000)\n"
+              << "  -w, --warmup MS          warm up before measurement (200)\n"
+              << "  -o, --output FILE        JSON report, by default to stdout\n";
+}
+
+// Loopback benchmarks of event loop and sockets
+int main(const int argc, char* argv[])
+{
+    signal(SIGPIPE, SIG_IGN);
+    netb::BenchOptions options(argc, argv, {{"b", "bench"}, {"c", "connections"}, {"s", "sizes"},
+                                            {"p", "producers"}, {"t", "timers"}, {"d", "duration"},
+                                            {"w", "warmup"}, {"o", "output"}, {"h", "help"}});
+    if(!options.Valid() || options.Has("help"))
+    {
+        Usage();
+        return 1;
+    }
+    std::vector<std::string> benches = options.Strings("bench",
+        "tcp_pingpong,tcp_throughput,udp_pps,accept_rate,invoke_rate,timer_churn");
+    std::vector<long> connections = options.Integers("connections", "1,16");
+    std::vector<long> sizes = options.Integers("sizes", "64,4096");
+    std::vector<long> producers = options.Integers("producers", "1,4");
+    std::vector<long> timers = options.Integers("timers", "1000,100000");
+    netb::BenchConfig config;
+    config.warmup = options.Integer("warmup", 200);
+    config.duration = options.Integer("duration", 1000);
+
+    typedef netb::BenchResult (*Bench)(const netb::BenchConfig&);
+    std::vector<netb::BenchResult> results;
+    auto run = [&](Bench bench, const std::vector<long>& concurrency, const std::vector<long>& sizes)
+    {
+        for(size_t i = 0; i < concurrency.size(); ++i)
+        {
+            for(size_t j = 0; j < sizes.size(); ++j)
+            {
+                config.connections = concurrency[i];
+                config.size = sizes[j];
+                results.push_back(bench(config));
+                std::cerr << results.back().Json() << std::endl;
+            }
+        }
+    };
+    for(size_t i = 0; i < benches.size(); ++i)
+    {
+        const std::string& name = benches[i];
+        if(name == "tcp_pingpong") run(netb::TcpPingPong, connections, sizes);
+        else if(name == "tcp_throughput") run(netb::TcpThroughput, connections, sizes);
+        else if(name == "udp_pps") run(netb::UdpPps, connections, sizes);
+        else if(name == "accept_rate") run(netb::AcceptRate, connections, {0});
+        else if(name == "invoke_rate") run(netb::InvokeRate, producers, {0});
+        else if(name == "timer_churn") run(netb::TimerChurn, timers, {0});
+        else
+        {
+            std::cerr << "Unknown benchmark: " << name << std::endl;
+            return 1;
+        }
+    }
+
+    std::string output = options.String("output", "");
+    if(output.empty())
+    {
+        netb::BenchReport(std::cout, "netbench", results);
+        return 0;
+    }
+    std::ofstream ofs(output);
+    netb::BenchReport(ofs, "netbench", results);
+    return ofs ? 0 : 1;
+}
@@ -50,6 +50,9 @@ private:
         std::cout << "\n";
         conn->SetConnectedCallback(std::bind(&TcpEchoServer::OnConnected, this, _1, _2)); // for disconnected
         conn->SetReceivedCallback(std::bind(&TcpEchoServer::OnReceived, this, _1, _2)); // for received
+        conn->SetWatermarks(64 * 1024, 256 * 1024); // stop reading if peer does not read echoed data
+        conn->SetHighWatermarkCallback(std::bind(&TcpEchoServer::OnHighWatermark, this, _1, _2));
+        conn->SetLowWatermarkCallback(std::bind(&TcpEchoServer::OnLowWatermark, this, _1, _2));
         _connections.push_back(conn);
         Error e;
         if(!conn->Connected(&e))
@@ -96,6 +99,20 @@ private:
         conn->Send(buf);
         buf->Flush(); 
     }
+
+    // Echoed data is piling up, stop reading
+    void OnHighWatermark(AsyncTcpSocket* conn, size_t buffered)
+    {
+        std::cout << "Paused [" << conn << "][" << buffered << "]" << std::endl;
+        conn->PauseReading();
+    }
+
+    // Echoed data is drained, restart reading
+    void OnLowWatermark(AsyncTcpSocket* conn, size_t buffered)
+    {
+        std::cout << "Resumed [" << conn << "][" << buffered << "]" << std::endl;
+        conn->ResumeReading();
+    }
 };
 
 NETB_END
@@ -21,37 +21,63 @@ NETB_BEGIN
 
 using namespace std::placeholders;
 
-HttpConnection::HttpConnection(EventLoop* loop, SOCKET s, const SocketAddress* connected)
-: AsyncTcpSocket(loop, s, connected)
+HttpConnection::HttpConnection(HttpServer* server, SOCKET s, const SocketAddress* connected)
+: AsyncTcpSocket(server->GetLoop(), s, connected)
+, _server(server)
+, _request_size(0)
+, _request_start(0)
 {
     SetReceivedCallback(std::bind(&HttpConnection::OnReceived, this, _1, _2));
+    SetIdleTimeout(IDLE_TIMEOUT);
 }
 
 void HttpConnection::OnReceived(AsyncTcpSocket* conn, StreamBuffer* buf)
 {
     assert(conn == this);
     assert(buf != nullptr);
-    if(_request.FromBuffer(buf))
+    int64_t now = EventLoopStats::Now();
+    // Pipelined requests are handled in order
+    while(buf->Readable() > 0)
     {
+        if(_request_start == 0)
+        {
+            _request_start = now;
+        }
+        size_t readable = buf->Readable();
+        bool done = _request.FromBuffer(buf);
+        _request_size += readable - buf->Readable();
+        if(!done)
+        {
+            break;
+        }
         HandleRequest(conn);
         _request.Reset();
+        _request_size = 0;
+        _request_start = 0;
     }
 }
 
+// Request is printed after the response is sent, out of its latency
 void HttpConnection::HandleRequest(AsyncTcpSocket* conn)
 {
+    HttpResponse res;
+    size_t size = SendResponse(conn, res);
+    HttpServer::RouteStats* route = _server->Route(_request.GetUrl());
+    route->io.OnReceived(_request_size);
+    route->io.OnSent(size, size);
+    route->io.OnLatency(EventLoopStats::Now() - _request_start);
     std::cout << "Received a HTTP request: \n";
     std::cout << _request.String();
-    HttpResponse res;
-    SendResponse(conn, res);
 }
 
-void HttpConnection::SendResponse(AsyncTcpSocket* conn, const HttpResponse& response)
+size_t HttpConnection::SendResponse(AsyncTcpSocket* conn, const HttpResponse& response)
 {
     assert(conn != nullptr);
     StreamBuffer buf;
     response.ToBuffer(&buf);
+    size_t size = buf.Readable();
     conn->Send(&buf);
+    return size;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -79,13 +105,26 @@ bool HttpServer::OnAccepted(AsyncTcpAcceptor* acceptor, SOCKET s, const SocketAd
     assert(acceptor == this);
     assert(s != INVALID_SOCKET);
     assert(_connections.find(s) == _connections.end());
-    HttpConnection* conn = new HttpConnection(GetLoop(), s, addr);
+    HttpConnection* conn = new HttpConnection(this, s, addr);
     conn->SetConnectedCallback(std::bind(&HttpServer::OnConnected, this, _1, _2));
     conn->Connected();
     _connections[s] = conn;
     return true;
 }
 
+void HttpServer::AddRoute(const std::string& path)
+{
+    std::unique_ptr<RouteStats>& route = _routes[path];
+    if(!route) route.reset(new RouteStats());
+}
+
+// Path is the url without query or fragment
+HttpServer::RouteStats* HttpServer::Route(const std::string& url)
+{
+    auto it = _routes.find(url.substr(0, url.find_first_of("?#")));
+    return it != _routes.end() ? it->second.get() : &_other;
+}
+
 // Connected status changed
 // Delete the connection if it is disconnected
 void HttpServer::OnConnected(AsyncTcpSocket* conn, bool connected)
@@ -93,6 +132,10 @@ void HttpServer::OnConnected(AsyncTcpSocket* conn, bool connected)
     assert(conn != nullptr);
     if(!connected)
     {
+        if(conn->GetError())
+        {
+            std::cout << "Connection closed: " << conn->GetError().Report() << "\n";
+        }
         auto it = _connections.find(conn->GetSocket());
         if(it != _connections.end())
         {
@@ -122,6 +165,7 @@ int main(const int argc, char* argv[])
     }
     netb::EventLoop loop; // running on current thread
     netb::HttpServer server(&loop, netb::SocketAddress(port));
+    server.AddRoute("/");
     server.Open();
     loop.Run();
     return 0;
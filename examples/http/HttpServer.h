@@ -21,19 +21,31 @@
 #include "AsyncTcpAcceptor.hpp"
 #include "AsyncTcpSocket.hpp"
 #include "HttpMessage.hpp"
+#include "SocketStats.hpp"
 #include <map>
+#include <memory>
 
 NETB_BEGIN
 
+class HttpServer;
+
 // HTTP connection receive request and return response
 class HttpConnection : public AsyncTcpSocket 
 {
 public:
-    HttpConnection(EventLoop* loop, SOCKET s, const SocketAddress* connected);
+    HttpConnection(HttpServer* server, SOCKET s, const SocketAddress* connected);
+
+    // Close keep-alive connection if no request in given time
+    static const int IDLE_TIMEOUT = 60000;
 
 private:
+    // Server owns this connection
+    HttpServer* _server;
+
     // Request message from this connection
     HttpRequest _request;
+    size_t _request_size;
+    int64_t _request_start; // microseconds when first bytes are received, 0 if none
 
     // TcpConnection::ReceivedCallback
     void OnReceived(AsyncTcpSocket* conn, StreamBuffer* buf);
@@ -42,7 +54,8 @@ private:
     void HandleRequest(AsyncTcpSocket* conn);
 
     // Send response message
-    void SendResponse(AsyncTcpSocket* conn, const HttpResponse& response);
+    // Return the size of the response
+    size_t SendResponse(AsyncTcpSocket* conn, const HttpResponse& response);
 };
 
 // HTTP server is a TCP acceptor
@@ -56,7 +69,32 @@ public:
     // Destructor, close all connections
     virtual ~HttpServer();
 
+    // Stats per route, requests are counted as receives and responses 
+    // as sends, with latency in microseconds from receiving the first
+    // bytes of a request to sending its response
+    struct RouteStats
+    {
+        Histogram latency;
+        SocketStats io;
+        RouteStats() : io(&latency) { }
+    };
+
+    // Register a route by path, e.g. "/index.html"
+    // Stats are kept for registered routes only, so clients can not
+    // grow them by varying urls
+    void AddRoute(const std::string& path);
+
+    // Stats of the route of given url, query is ignored, and urls of
+    // no route share the stats of other routes
+    // Only used in loop thread
+    RouteStats* Route(const std::string& url);
+    RouteStats* OtherRoute() { return &_other; }
+
 private:
+    // Stats by path, and of all other urls
+    std::map<std::string, std::unique_ptr<RouteStats>> _routes;
+    RouteStats _other;
+
     // Connections
     std::map<SOCKET, HttpConnection*> _connections;
 
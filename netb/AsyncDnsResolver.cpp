@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncDnsResolver.hpp"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <cerrno>
+#include <future>
+#include <cassert>
+
+NETB_BEGIN
+
+// std::placeholders::_1, _2, ...
+using namespace std::placeholders;
+
+AsyncDnsResolver::AsyncDnsResolver(EventLoop* loop, const SocketAddress& server) noexcept
+: _loop(loop)
+, _socket(loop, server.Family())
+, _timeout(DEFAULT_TIMEOUT)
+, _retries(DEFAULT_RETRIES)
+, _tcp_only(false)
+, _payload_size(DEFAULT_PAYLOAD_SIZE)
+, _cache(nullptr)
+, _ids_left(0)
+{
+    assert(_loop);
+    _servers.push_back(server);
+    _socket.SetReceivedCallback(std::bind(&AsyncDnsResolver::OnReceived, this, _1, _2, _3));
+}
+
+// Timers of pending queries are cancelled in loop thread
+AsyncDnsResolver::~AsyncDnsResolver() noexcept
+{
+    _socket.Close(); // block until isolated from loop
+    if(!_pending.empty() || !_connections.empty())
+    {
+        std::promise<void> done;
+        _loop->Invoke([this, &done]()
+        {
+            for(auto it = _pending.begin(); it != _pending.end(); ++it)
+            {
+                delete it->second;
+            }
+            _pending.clear();
+            for(auto it = _connections.begin(); it != _connections.end(); ++it)
+            {
+                delete *it;
+            }
+            _connections.clear();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+// Servers of other family are not reachable from the socket
+void AsyncDnsResolver::AddServer(const SocketAddress& server) noexcept
+{
+    assert(server.Family() == _servers[0].Family());
+    _servers.push_back(server);
+}
+
+// Larger responses would not fit in the receive buffer
+void AsyncDnsResolver::SetPayloadSize(unsigned short size) noexcept
+{
+    _payload_size = std::min<unsigned short>(size, RECEIVE_BUFFER_SIZE);
+}
+
+// Query is started in loop thread
+void AsyncDnsResolver::Resolve(const std::string& name, unsigned short qtype, const ResolvedCallback& cb) noexcept
+{
+    _loop->Invoke(std::bind(&AsyncDnsResolver::StartResolve, this, name, qtype, cb));
+}
+
+void AsyncDnsResolver::StartResolve(const std::string& name, unsigned short qtype, const ResolvedCallback& cb)
+{
+    Error e;
+    dns::DomainName dn;
+    if(!dn.FromString(name))
+    {
+        e.Set(LogicError(), "AsyncDnsResolver::Resolve : Invalid name [" + name + "].", ErrorCode::INVAL);
+        cb(this, nullptr, &e);
+        return;
+    }
+    if(_cache && ResolveCache(dn, qtype, cb))
+    {
+        return;
+    }
+    if(!StartQuery(dn, qtype, cb, &e))
+    {
+        cb(this, nullptr, &e);
+    }
+}
+
+// TTLs are reduced by the time the response stays in cache
+bool AsyncDnsResolver::ResolveCache(const dns::DomainName& name, unsigned short qtype, const ResolvedCallback& cb)
+{
+    std::string packet;
+    uint32_t age = 0;
+    bool prefetch = false;
+    if(!_cache->Get(name, qtype, &packet, &age, &prefetch))
+    {
+        return false;
+    }
+    StreamBuffer buf(packet.data(), packet.size());
+    dns::Response response;
+    if(!response.FromBuffer(&buf))
+    {
+        return false;
+    }
+    const std::vector<dns::ResourceRecord*>* sections[] = 
+        { &response.Answers(), &response.Authorities(), &response.Additionals() };
+    for(size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); ++i)
+    {
+        for(auto it = sections[i]->begin(); it != sections[i]->end(); ++it)
+        {
+            dns::ResourceRecord* rr = *it;
+            if(rr->Type() != (unsigned short)dns::RECORD_TYPE::OPT)
+            {
+                rr->TTL(rr->TTL() > age ? rr->TTL() - age : 0);
+            }
+        }
+    }
+    if(prefetch)
+    {
+        StartQuery(name, qtype, nullptr, nullptr); // refresh in background
+    }
+    cb(this, &response, nullptr);
+    return true;
+}
+
+// Encode once and keep for retransmission
+bool AsyncDnsResolver::StartQuery(const dns::DomainName& name, unsigned short qtype, const ResolvedCallback& cb, Error* e)
+{
+    std::string key = DnsCache::Key(name, qtype);
+    auto it = _pending_keys.find(key);
+    if(it != _pending_keys.end())
+    {
+        if(cb) it->second->callbacks.push_back(cb);
+        return true;
+    }
+    if(!_tcp_only && _socket.GetSocket() == INVALID_SOCKET && !_socket.Open(e))
+    {
+        return false;
+    }
+    if(_pending.size() >= 65536)
+    {
+        SET_RUNTIME_ERROR(e, "AsyncDnsResolver::Resolve : Too many pending queries.", ErrorCode::NOBUFS);
+        return false;
+    }
+    Query* q = new (std::nothrow) Query();
+    if(!q)
+    {
+        SET_RUNTIME_ERROR(e, "AsyncDnsResolver::Resolve : New query failed.", ErrorCode::NOMEM);
+        return false;
+    }
+    do
+    {
+        q->id = RandomId();
+    } while(_pending.find(q->id) != _pending.end());
+    q->key = key;
+    q->name = name;
+    q->type = qtype;
+    q->edns = _payload_size > 0;
+    if(!EncodeQuery(q))
+    {
+        delete q;
+        SET_LOGIC_ERROR(e, "AsyncDnsResolver::Resolve : Encoding query failed.", ErrorCode::INVAL);
+        return false;
+    }
+    q->server = 0;
+    q->tries = 0;
+    q->tcp = _tcp_only;
+    if(cb) q->callbacks.push_back(cb);
+    q->timer.SetExpiredCallback(std::bind(&AsyncDnsResolver::OnTimeout, this, q));
+    _pending[q->id] = q;
+    _pending_keys[key] = q;
+    SendQuery(q);
+    return true;
+}
+
+// Query IDs must be unpredictable to resist forged responses, so they
+// come from the system CSPRNG, with random_device if it is unavailable.
+// IDs are read in batches to save a system call per query.
+uint16_t AsyncDnsResolver::RandomId() noexcept
+{
+    if(_ids_left == 0)
+    {
+        uint8_t* p = (uint8_t*)_ids;
+        size_t n = sizeof(_ids);
+        size_t got = 0;
+        int fd = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+        if(fd >= 0)
+        {
+            while(got < n)
+            {
+                ssize_t r = ::read(fd, p + got, n - got);
+                if(r < 0 && errno == EINTR) continue;
+                if(r <= 0) break;
+                got += r;
+            }
+            ::close(fd);
+        }
+        if(got < n)
+        {
+            std::random_device random;
+            for(size_t i = 0; i < n; ++i)
+            {
+                p[i] = (uint8_t)random();
+            }
+        }
+        _ids_left = sizeof(_ids) / sizeof(_ids[0]);
+    }
+    return _ids[--_ids_left];
+}
+
+// OPT record advertises the payload size if EDNS is used
+bool AsyncDnsResolver::EncodeQuery(Query* q)
+{
+    dns::Query query(q->name, q->type);
+    query.GetHeader().Id(q->id);
+    if(q->edns && !query.EDNS(_payload_size))
+    {
+        return false;
+    }
+    q->packet.Clear();
+    return query.ToBuffer(&q->packet);
+}
+
+// Send to current server and wait for timeout
+void AsyncDnsResolver::SendQuery(Query* q)
+{
+    ++q->tries;
+    if(q->tcp)
+    {
+        SendTcp(q);
+    }
+    else
+    {
+        _socket.SendTo(q->packet.Read(), q->packet.Readable(), _servers[q->server]);
+    }
+    _loop->ScheduleTimerAfter(&q->timer, _timeout);
+}
+
+// Query is lost if connecting fails, and sent again on timeout
+void AsyncDnsResolver::SendTcp(Query* q)
+{
+    Connection* c = GetConnection(q->server);
+    if(!c)
+    {
+        return;
+    }
+    uint16_t len = htons((uint16_t)q->packet.Readable());
+    c->out.Write(&len, sizeof(len));
+    c->out.Write(q->packet.Read(), q->packet.Readable());
+    if(c->connected)
+    {
+        c->socket.Send(c->out.Read(), c->out.Readable());
+        c->out.Clear();
+    }
+}
+
+// Connected callback may be notified before connecting returns
+AsyncDnsResolver::Connection* AsyncDnsResolver::GetConnection(size_t server)
+{
+    if(_connections.size() < _servers.size())
+    {
+        _connections.resize(_servers.size(), nullptr);
+    }
+    if(_connections[server])
+    {
+        return _connections[server];
+    }
+    Connection* c = new (std::nothrow) Connection(_loop);
+    if(!c)
+    {
+        return nullptr;
+    }
+    c->socket.SetConnectedCallback(std::bind(&AsyncDnsResolver::OnTcpConnected, this, server, _1, _2));
+    c->socket.SetReceivedCallback(std::bind(&AsyncDnsResolver::OnTcpReceived, this, server, _1, _2));
+    c->socket.SetIdleTimeout(DEFAULT_TCP_IDLE_TIMEOUT);
+    _connections[server] = c;
+    if(!c->socket.Connect(_servers[server], _timeout, nullptr))
+    {
+        _connections[server] = nullptr;
+        delete c;
+        return nullptr;
+    }
+    return _connections[server];
+}
+
+void AsyncDnsResolver::Destroy(Connection* c) noexcept
+{
+    delete c;
+}
+
+// Closed connection is deleted later, out of its own callback
+void AsyncDnsResolver::OnTcpConnected(size_t server, AsyncTcpSocket* socket, bool connected)
+{
+    Connection* c = _connections[server];
+    if(!c || &c->socket != socket)
+    {
+        return;
+    }
+    if(connected)
+    {
+        c->connected = true;
+        if(!c->out.Empty())
+        {
+            c->socket.Send(c->out.Read(), c->out.Readable());
+            c->out.Clear();
+        }
+        return;
+    }
+    _connections[server] = nullptr;
+    _loop->InvokeLater(std::bind(&AsyncDnsResolver::Destroy, c));
+}
+
+// Each frame is a response with 2-byte length
+void AsyncDnsResolver::OnTcpReceived(size_t server, AsyncTcpSocket* socket, StreamBuffer* buf)
+{
+    while(buf->Readable() >= sizeof(uint16_t))
+    {
+        uint16_t len;
+        memcpy(&len, buf->Read(), sizeof(len));
+        len = ntohs(len);
+        if(buf->Readable() < sizeof(len) + len)
+        {
+            break;
+        }
+        StreamBuffer response((const char*)buf->Read() + sizeof(len), len);
+        buf->Read(sizeof(len) + len);
+        buf->Flush();
+        OnResponse(&response, nullptr, true);
+    }
+}
+
+void AsyncDnsResolver::FinishQuery(Query* q, const dns::Response* response, const Error* e)
+{
+    _pending.erase(q->id);
+    _pending_keys.erase(q->key);
+    q->timer.Cancel();
+    std::vector<ResolvedCallback> callbacks;
+    callbacks.swap(q->callbacks);
+    delete q;
+    for(auto it = callbacks.begin(); it != callbacks.end(); ++it)
+    {
+        (*it)(this, response, e);
+    }
+}
+
+// A single message in each datagram
+void AsyncDnsResolver::OnReceived(AsyncUdpSocket* socket, StreamBuffer* buf, const SocketAddress* addr)
+{
+    OnResponse(buf, addr, false);
+    buf->Clear();
+}
+
+// Matched by ID, source address and question
+// Others are ignored, the query still waits for the right response
+// Matching is done in place, so unwanted packets are dropped without decoding
+void AsyncDnsResolver::OnResponse(StreamBuffer* buf, const SocketAddress* addr, bool tcp)
+{
+    dns::MessageView view;
+    if(!view.ParseQuestions(buf->Read(), buf->Readable()) || view.Question())
+    {
+        return;
+    }
+    auto it = _pending.find(view.Id());
+    if(it == _pending.end())
+    {
+        return;
+    }
+    Query* q = it->second;
+    if(tcp ? !q->tcp : (addr == nullptr || std::find(_servers.begin(), _servers.end(), *addr) == _servers.end()))
+    {
+        return; // late response from previous server is good too
+    }
+    bool matched = view.QuestionCount() == 1 && view.GetQuestion(0).type == q->type && 
+                   view.NameEquals(view.GetQuestion(0).name, q->name.Wire().data(), q->name.Wire().length());
+    if(!matched)
+    {
+        return;
+    }
+    // Retry without EDNS once, only on FORMERR echoing the question, so a
+    // forged FORMERR must match like any response to force the downgrade
+    if(view.ResponseCode() == (unsigned char)dns::Header::RCODE::FORMAT_ERROR && q->edns)
+    {
+        q->edns = false; // server may not know EDNS (RFC 6891 7), never turned on again
+        if(EncodeQuery(q))
+        {
+            --q->tries; // not counted as a retry
+            SendQuery(q);
+        }
+        return;
+    }
+    if(view.Truncated() && !tcp)
+    {
+        q->tcp = true; // not counted as a retry
+        SendTcp(q);
+        _loop->ScheduleTimerAfter(&q->timer, _timeout);
+        return;
+    }
+    std::string packet;
+    if(_cache)
+    {
+        packet.assign((const char*)buf->Read(), buf->Readable()); // wire format for cache
+    }
+    dns::Response response;
+    if(!response.FromBuffer(buf))
+    {
+        return;
+    }
+    if(_cache)
+    {
+        _cache->Put(response, packet.data(), packet.size());
+    }
+    FinishQuery(q, &response, nullptr);
+}
+
+// Try next server, or fail if no more retries
+void AsyncDnsResolver::OnTimeout(Query* q)
+{
+    if(q->tries > _retries)
+    {
+        Error e;
+        e.Set(RuntimeError(), "AsyncDnsResolver::Resolve : Timeout [" + q->name.String() + "].", ErrorCode::TIMEDOUT);
+        FinishQuery(q, nullptr, &e);
+        return;
+    }
+    q->server = (q->server + 1) % _servers.size();
+    SendQuery(q);
+}
+
+NETB_END
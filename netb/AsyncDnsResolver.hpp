@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_ASYNC_DNS_RESOLVER_HPP
+#define NETB_ASYNC_DNS_RESOLVER_HPP
+
+#include "Uncopyable.hpp"
+#include "AsyncUdpSocket.hpp"
+#include "AsyncTcpSocket.hpp"
+#include "EventLoop.hpp"
+#include "DnsMessage.hpp"
+#include "DnsMessageView.hpp"
+#include "DnsCache.hpp"
+#include <functional>
+#include <map>
+
+NETB_BEGIN
+
+//
+// AsyncDnsResolver sends DNS queries over a single UDP socket and keeps
+// many of them in flight at the same time. Responses are matched up with
+// outstanding queries by 16-bit ID and the question, IDs are random and
+// the local port is picked by the system, so that forged responses are
+// hard to be accepted.
+//
+// A query is sent again on timeout, to next server if multiple servers
+// are given, and fails after given number of retries. Timeouts are
+// driven by timers of the event loop.
+//
+// Queries advertise a larger UDP payload size with EDNS(0), so most
+// responses fit in one datagram. Servers not knowing EDNS are queried
+// again without it.
+//
+// Truncated responses are queried again over TCP (RFC 7766), framed
+// with 2-byte length. Queries to a server share one connection and are
+// pipelined, responses are matched by ID in any order. Connections are
+// closed after idle for a while.
+//
+// Concurrent lookups of the same name and type share one query. With
+// a cache, responses are served from it until TTL expires, and popular
+// ones are refreshed in background shortly before that.
+//
+// Resolving may be started in any thread, the result is notified in
+// the loop thread. Pending queries are dropped without notification
+// when the resolver is destroyed.
+//
+class AsyncDnsResolver : private Uncopyable
+{
+public:
+    // Timeout of each try in milliseconds, and tries after the first one
+    static const int DEFAULT_TIMEOUT = 1000;
+    static const int DEFAULT_RETRIES = 2;
+
+    // Idle timeout of TCP connections in milliseconds
+    static const int DEFAULT_TCP_IDLE_TIMEOUT = 10000;
+
+    // UDP payload size advertised with EDNS(0), which avoids
+    // fragmentation on most paths (DNS flag day 2020)
+    static const unsigned short DEFAULT_PAYLOAD_SIZE = 1232;
+
+    // Given DNS server address
+    AsyncDnsResolver(EventLoop* loop, const SocketAddress& server) noexcept;
+    ~AsyncDnsResolver() noexcept;
+
+    // Event loop is exposed for external use
+    EventLoop* GetLoop() const noexcept { return _loop; }
+
+    // More servers in the same family, used in turn on retries
+    void AddServer(const SocketAddress& server) noexcept;
+
+    // Setup before resolving
+    void SetTimeout(int timeout) noexcept { _timeout = timeout; }
+    void SetRetries(int retries) noexcept { _retries = retries; }
+
+    // Send all queries over TCP, e.g. for large responses
+    void SetTcpOnly(bool tcp) noexcept { _tcp_only = tcp; }
+
+    // UDP payload size advertised in queries, 0 to disable EDNS(0)
+    void SetPayloadSize(unsigned short size) noexcept;
+
+    // Cache in front of network, not owned and may be shared
+    void SetCache(DnsCache* cache) noexcept { _cache = cache; }
+
+    // Notification of result
+    // Response is only valid in callback, and is null on failure with error
+    typedef std::function<void (AsyncDnsResolver*, const dns::Response*, const Error*)> ResolvedCallback;
+
+    // Start resolving a name, the result is always notified by callback
+    void Resolve(const std::string& name, unsigned short qtype, const ResolvedCallback& cb) noexcept;
+
+    // Number of queries in flight
+    size_t Pending() const noexcept { return _pending.size(); }
+
+private:
+    EventLoop* _loop;
+    AsyncUdpSocket _socket;
+    std::vector<SocketAddress> _servers;
+    int _timeout;
+    int _retries;
+    bool _tcp_only;
+    unsigned short _payload_size;
+    DnsCache* _cache;
+
+    // Random query IDs, read from the system CSPRNG in batches
+    uint16_t _ids[64];
+    size_t _ids_left;
+
+    // Outstanding query
+    struct Query
+    {
+        uint16_t id;
+        std::string key;
+        dns::DomainName name;
+        uint16_t type;
+        StreamBuffer packet; // encoded query for retransmission
+        size_t server; // index of current server
+        int tries;
+        bool tcp;
+        bool edns;
+        std::vector<ResolvedCallback> callbacks; // empty for prefetching
+        EventLoop::Timer timer;
+    };
+    std::map<uint16_t, Query*> _pending;
+    std::map<std::string, Query*> _pending_keys;
+
+    // Connection to a server, frames are held until it is established
+    struct Connection
+    {
+        Connection(EventLoop* loop) : socket(loop), connected(false) { }
+        AsyncTcpSocket socket;
+        bool connected;
+        StreamBuffer out;
+    };
+    std::vector<Connection*> _connections; // by server, null if none
+
+    // In loop thread
+    void StartResolve(const std::string& name, unsigned short qtype, const ResolvedCallback& cb);
+
+    // Serve from cache, and start prefetching if necessary
+    bool ResolveCache(const dns::DomainName& name, unsigned short qtype, const ResolvedCallback& cb);
+
+    // Join a pending query or start a new one
+    bool StartQuery(const dns::DomainName& name, unsigned short qtype, const ResolvedCallback& cb, Error* e);
+
+    // Next random query ID
+    uint16_t RandomId() noexcept;
+
+    // Encode into packet of the query
+    bool EncodeQuery(Query* q);
+
+    // Send or send again
+    void SendQuery(Query* q);
+    void SendTcp(Query* q);
+
+    // Connection to a server, connecting if necessary
+    Connection* GetConnection(size_t server);
+    static void Destroy(Connection* c) noexcept;
+
+    // Remove from pending and notify
+    void FinishQuery(Query* q, const dns::Response* response, const Error* e);
+
+    // A response over UDP or TCP
+    void OnResponse(StreamBuffer* buf, const SocketAddress* addr, bool tcp);
+
+    // AsyncUdpSocket::ReceivedCallback
+    void OnReceived(AsyncUdpSocket* socket, StreamBuffer* buf, const SocketAddress* addr);
+
+    // AsyncTcpSocket::ConnectedCallback and ReceivedCallback
+    void OnTcpConnected(size_t server, AsyncTcpSocket* socket, bool connected);
+    void OnTcpReceived(size_t server, AsyncTcpSocket* socket, StreamBuffer* buf);
+
+    // Timeout of a try
+    void OnTimeout(Query* q);
+};
+
+NETB_END
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncDnsServer.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+#include <future>
+#include <cassert>
+
+NETB_BEGIN
+
+// std::placeholders::_1, _2, ...
+using namespace std::placeholders;
+
+AsyncDnsServer::AsyncDnsServer(EventLoop* loop, const DnsZone* zone) noexcept
+: _loop(loop)
+, _zone(zone)
+, _socket(loop)
+, _acceptor(loop)
+, _queries(0)
+, _dropped(0)
+, _tcp_response(sizeof(uint16_t) + 65535)
+{
+    assert(_loop);
+    assert(_zone);
+    _socket.SetReceiveBatch(DEFAULT_RECEIVE_BATCH);
+    _socket.SetReceivedCallback(std::bind(&AsyncDnsServer::OnReceived, this, _1, _2, _3));
+    _acceptor.SetAcceptedCallback(std::bind(&AsyncDnsServer::OnAccepted, this, _1, _2, _3));
+}
+
+AsyncDnsServer::~AsyncDnsServer() noexcept
+{
+    Close();
+}
+
+void AsyncDnsServer::Open(const SocketAddress& addr)
+{
+    Error e;
+    if(!Open(addr, &e))
+    {
+        THROW_ERROR(e);
+    }
+}
+
+// Address and port may be shared by servers of other loops
+// TCP uses the same port, which is picked by UDP if not given
+bool AsyncDnsServer::Open(const SocketAddress& addr, Error* e) noexcept
+{
+    if(!_socket.Open(addr, true, true, e))
+    {
+        return false;
+    }
+    SocketAddress local = _socket.Address(e);
+    if(local.Empty() || !_acceptor.Open(local, true, true, e))
+    {
+        _socket.Close();
+        return false;
+    }
+    return true;
+}
+
+// Block until isolated from loop
+bool AsyncDnsServer::Close(Error* e) noexcept
+{
+    bool ret = _socket.Close(e);
+    _acceptor.Close();
+    if(_loop->IsInLoopThread())
+    {
+        CloseConnections();
+    }
+    else if(!_connections.empty())
+    {
+        std::promise<void> done;
+        _loop->Invoke([this, &done]()
+        {
+            CloseConnections();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+    return ret;
+}
+
+void AsyncDnsServer::CloseConnections()
+{
+    for(auto it = _connections.begin(); it != _connections.end(); ++it)
+    {
+        delete *it;
+    }
+    _connections.clear();
+}
+
+void AsyncDnsServer::Destroy(AsyncTcpSocket* conn) noexcept
+{
+    delete conn;
+}
+
+// Each datagram is a single query
+void AsyncDnsServer::OnReceived(AsyncUdpSocket* socket, StreamBuffer* buf, const SocketAddress* addr)
+{
+    ++_queries;
+    size_t n = 0;
+    if(addr)
+    {
+        n = _zone->Answer(buf->Read(), buf->Readable(), _response, sizeof(_response), true);
+    }
+    buf->Clear();
+    if(n == 0)
+    {
+        ++_dropped;
+        return;
+    }
+    _socket.SendTo(_response, n, *addr);
+}
+
+// Connection is owned by the server
+bool AsyncDnsServer::OnAccepted(AsyncTcpAcceptor* acceptor, SOCKET s, const SocketAddress* addr)
+{
+    AsyncTcpSocket* conn = new (std::nothrow) AsyncTcpSocket(_loop, s, addr);
+    if(!conn)
+    {
+        return false;
+    }
+    conn->SetConnectedCallback(std::bind(&AsyncDnsServer::OnTcpConnected, this, _1, _2));
+    conn->SetReceivedCallback(std::bind(&AsyncDnsServer::OnTcpReceived, this, _1, _2));
+    conn->SetIdleTimeout(DEFAULT_TCP_IDLE_TIMEOUT);
+    if(!conn->Connected(nullptr))
+    {
+        delete conn; // socket is closed with it
+        return true;
+    }
+    _connections.insert(conn);
+    return true;
+}
+
+// Closed connection is deleted later, out of its own callback
+void AsyncDnsServer::OnTcpConnected(AsyncTcpSocket* conn, bool connected)
+{
+    if(!connected && _connections.erase(conn) > 0)
+    {
+        _loop->InvokeLater(std::bind(&AsyncDnsServer::Destroy, conn));
+    }
+}
+
+// Each frame is a query with 2-byte length
+// Responses of pipelined queries are sent together after the callback
+void AsyncDnsServer::OnTcpReceived(AsyncTcpSocket* conn, StreamBuffer* buf)
+{
+    while(buf->Readable() >= sizeof(uint16_t))
+    {
+        uint16_t len;
+        memcpy(&len, buf->Read(), sizeof(len));
+        len = ntohs(len);
+        if(buf->Readable() < sizeof(len) + len)
+        {
+            break;
+        }
+        ++_queries;
+        size_t n = _zone->Answer((const char*)buf->Read() + sizeof(len), len, 
+                                 &_tcp_response[sizeof(len)], _tcp_response.size() - sizeof(len));
+        buf->Read(sizeof(len) + len);
+        buf->Flush();
+        if(n == 0)
+        {
+            ++_dropped;
+            continue;
+        }
+        len = htons((uint16_t)n);
+        memcpy(&_tcp_response[0], &len, sizeof(len));
+        conn->Send(&_tcp_response[0], sizeof(len) + n);
+    }
+}
+
+NETB_END
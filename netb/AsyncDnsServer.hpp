@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_ASYNC_DNS_SERVER_HPP
+#define NETB_ASYNC_DNS_SERVER_HPP
+
+#include "Uncopyable.hpp"
+#include "AsyncUdpSocket.hpp"
+#include "AsyncTcpAcceptor.hpp"
+#include "AsyncTcpSocket.hpp"
+#include "EventLoop.hpp"
+#include "DnsZone.hpp"
+#include <vector>
+#include <set>
+
+NETB_BEGIN
+
+//
+// AsyncDnsServer is an authoritative DNS server over UDP and TCP, 
+// answering queries from a zone.
+//
+// Queries are received in batches, and each one is answered into a
+// fixed buffer and sent at once, with no allocation on the way. To use
+// multiple cores, open a server on the same address in each event loop,
+// the kernel spreads queries among them (SO_REUSEPORT). The zone may be
+// shared by all servers.
+//
+// Responses too large for UDP are truncated, and clients query again
+// over TCP. Queries over TCP are framed with 2-byte length, and may be
+// pipelined on a connection (RFC 7766). Idle connections are closed.
+//
+class AsyncDnsServer : private Uncopyable
+{
+public:
+    // Datagrams received on each read event
+    static const size_t DEFAULT_RECEIVE_BATCH = 32;
+
+    // Largest response over UDP, larger ones are truncated
+    // Clients without EDNS(0) get at most 512 bytes
+    static const size_t MAX_UDP_RESPONSE = 1232;
+
+    // Idle timeout of TCP connections in milliseconds
+    static const int DEFAULT_TCP_IDLE_TIMEOUT = 10000;
+
+    // Zone is not owned, and must not be changed while serving
+    AsyncDnsServer(EventLoop* loop, const DnsZone* zone) noexcept;
+    ~AsyncDnsServer() noexcept;
+
+    // Event loop is exposed for external use
+    EventLoop* GetLoop() const noexcept { return _loop; }
+
+    // Setup before opening
+    void SetReceiveBatch(size_t n) noexcept { _socket.SetReceiveBatch(n); }
+
+    // Open to serve on given address, both UDP and TCP
+    void Open(const SocketAddress& addr); // throw on errors
+    bool Open(const SocketAddress& addr, Error* e) noexcept;
+
+    // Close, and drop all TCP connections
+    bool Close(Error* e = nullptr) noexcept;
+
+    // Local address
+    SocketAddress Address() const noexcept { return _socket.Address(); }
+
+    // Counters, only accurate in loop thread
+    uint64_t Queries() const noexcept { return _queries; }
+    uint64_t Dropped() const noexcept { return _dropped; }
+
+private:
+    EventLoop* _loop;
+    const DnsZone* _zone;
+    AsyncUdpSocket _socket;
+    AsyncTcpAcceptor _acceptor;
+    std::set<AsyncTcpSocket*> _connections;
+    uint64_t _queries;
+    uint64_t _dropped;
+
+    // Response being sent
+    unsigned char _response[MAX_UDP_RESPONSE];
+    std::vector<unsigned char> _tcp_response; // with length prefix
+
+    // AsyncUdpSocket::ReceivedCallback
+    void OnReceived(AsyncUdpSocket* socket, StreamBuffer* buf, const SocketAddress* addr);
+
+    // AsyncTcpAcceptor::AcceptedCallback
+    bool OnAccepted(AsyncTcpAcceptor* acceptor, SOCKET s, const SocketAddress* addr);
+
+    // AsyncTcpSocket::ConnectedCallback and ReceivedCallback
+    void OnTcpConnected(AsyncTcpSocket* conn, bool connected);
+    void OnTcpReceived(AsyncTcpSocket* conn, StreamBuffer* buf);
+
+    // Close connections in loop thread
+    void CloseConnections();
+    static void Destroy(AsyncTcpSocket* conn) noexcept;
+};
+
+NETB_END
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncStunServer.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+#include <cassert>
+
+NETB_BEGIN
+
+// std::placeholders::_1, _2, ...
+using namespace std::placeholders;
+
+using namespace stun;
+
+// Types of binding messages (6)
+static const uint16_t BINDING_REQUEST = 0x0001;
+static const uint16_t BINDING_SUCCESS = 0x0101;
+static const uint16_t BINDING_ERROR = 0x0111;
+
+static inline uint16_t Get16(const unsigned char* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void Put16(unsigned char* p, uint16_t v)
+{
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+static inline void Put32(unsigned char* p, uint32_t v)
+{
+    Put16(p, (uint16_t)(v >> 16));
+    Put16(p + 2, (uint16_t)v);
+}
+
+// Attributes of comprehension-required range that are known here
+static bool Known(uint16_t type)
+{
+    switch(type)
+    {
+        case (uint16_t)ATTRIBUTE::MAPPED_ADDRESS:
+        case (uint16_t)ATTRIBUTE::USERNAME:
+        case (uint16_t)ATTRIBUTE::MESSAGE_INTEGRITY:
+        case (uint16_t)ATTRIBUTE::ERROR_CODE:
+        case (uint16_t)ATTRIBUTE::UNKNOWN_ATTRIBUTES:
+        case (uint16_t)ATTRIBUTE::REALM:
+        case (uint16_t)ATTRIBUTE::NONCE:
+        case (uint16_t)ATTRIBUTE::XOR_MAPPED_ADDRESS:
+            return true;
+    }
+    return type >= 0x8000;
+}
+
+AsyncStunServer::AsyncStunServer(EventLoop* loop) noexcept
+: _loop(loop)
+, _socket(loop)
+, _requests(0)
+, _dropped(0)
+{
+    assert(_loop);
+    _socket.SetReceiveBatch(DEFAULT_RECEIVE_BATCH);
+    _socket.SetReceivedCallback(std::bind(&AsyncStunServer::OnReceived, this, _1, _2, _3));
+}
+
+AsyncStunServer::~AsyncStunServer() noexcept
+{
+    Close();
+}
+
+void AsyncStunServer::Open(const SocketAddress& addr)
+{
+    Error e;
+    if(!Open(addr, &e))
+    {
+        THROW_ERROR(e);
+    }
+}
+
+// Address and port may be shared by servers of other loops
+bool AsyncStunServer::Open(const SocketAddress& addr, Error* e) noexcept
+{
+    return _socket.Open(addr, true, true, e);
+}
+
+// Block until isolated from loop
+bool AsyncStunServer::Close(Error* e) noexcept
+{
+    return _socket.Close(e);
+}
+
+// Each datagram is a single request
+void AsyncStunServer::OnReceived(AsyncUdpSocket* socket, StreamBuffer* buf, const SocketAddress* addr)
+{
+    ++_requests;
+    size_t n = 0;
+    if(addr)
+    {
+        n = Answer((const unsigned char*)buf->Read(), buf->Readable(), *addr);
+    }
+    buf->Clear();
+    if(n == 0)
+    {
+        ++_dropped;
+        return;
+    }
+    _socket.SendTo(_response, n, *addr);
+}
+
+// Attributes are walked in place, the response is written from the
+// header of request, of which the transaction ID is kept
+size_t AsyncStunServer::Answer(const unsigned char* p, size_t n, const SocketAddress& addr) noexcept
+{
+    size_t size = Message::Probe(p, n);
+    if(size == 0 || (Get16(p) & 0x0110) != (uint16_t)CLASS::REQUEST)
+    {
+        return 0; // not a request
+    }
+    uint16_t unknowns[MAX_UNKNOWN_ATTRIBUTES];
+    size_t count = 0;
+    size_t offset = HEADER_SIZE;
+    while(offset < size)
+    {
+        if(offset + 4 > size)
+        {
+            return 0;
+        }
+        uint16_t type = Get16(p + offset);
+        size_t len = Get16(p + offset + 2);
+        size_t next = offset + 4 + ((len + 3) & ~(size_t)3);
+        if(next > size)
+        {
+            return 0;
+        }
+        if(type == (uint16_t)ATTRIBUTE::FINGERPRINT)
+        {
+            uint32_t crc;
+            memcpy(&crc, p + offset + 4, sizeof(crc));
+            if(len != FINGERPRINT_SIZE || ntohl(crc) != Message::Fingerprint(p, offset))
+            {
+                return 0;
+            }
+            break; // always the last
+        }
+        if(!Known(type) && count < MAX_UNKNOWN_ATTRIBUTES)
+        {
+            unknowns[count++] = type;
+        }
+        offset = next;
+    }
+
+    memcpy(_response, p, HEADER_SIZE);
+    unsigned char* q = _response + HEADER_SIZE;
+    if(Get16(p) != BINDING_REQUEST || count > 0)
+    {
+        Put16(_response, BINDING_ERROR);
+        int code = count > 0 ? 420 : 400;
+        const char* reason = count > 0 ? "Unknown Attribute" : "Bad Request";
+        size_t len = strlen(reason);
+        Put16(q, (uint16_t)ATTRIBUTE::ERROR_CODE);
+        Put16(q + 2, (uint16_t)(4 + len));
+        Put32(q + 4, ((code / 100) << 8) | (code % 100));
+        memcpy(q + 8, reason, len);
+        memset(q + 8 + len, 0, ((len + 3) & ~(size_t)3) - len);
+        q += 8 + ((len + 3) & ~(size_t)3);
+        if(count > 0)
+        {
+            Put16(q, (uint16_t)ATTRIBUTE::UNKNOWN_ATTRIBUTES);
+            Put16(q + 2, (uint16_t)(count * 2));
+            for(size_t i = 0; i < count; ++i)
+            {
+                Put16(q + 4 + i * 2, unknowns[i]);
+            }
+            if(count & 1)
+            {
+                Put16(q + 4 + count * 2, 0);
+            }
+            q += 4 + ((count * 2 + 3) & ~(size_t)3);
+        }
+    }
+    else
+    {
+        // XOR-MAPPED-ADDRESS, XOR'ed with magic cookie and transaction ID
+        Put16(_response, BINDING_SUCCESS);
+        const unsigned char* a;
+        size_t len;
+        if(addr.Family() == AF_INET)
+        {
+            a = (const unsigned char*)&((const sockaddr_in*)&addr)->sin_addr;
+            len = 4;
+        }
+        else if(addr.Family() == AF_INET6)
+        {
+            a = (const unsigned char*)&((const sockaddr_in6*)&addr)->sin6_addr;
+            len = 16;
+        }
+        else
+        {
+            return 0;
+        }
+        Put16(q, (uint16_t)ATTRIBUTE::XOR_MAPPED_ADDRESS);
+        Put16(q + 2, (uint16_t)(4 + len));
+        Put16(q + 4, len == 4 ? 0x01 : 0x02);
+        Put16(q + 6, addr.Port() ^ (uint16_t)(MAGIC_COOKIE >> 16));
+        const unsigned char* mask = p + 4; // magic cookie and transaction ID
+        for(size_t i = 0; i < len; ++i)
+        {
+            q[8 + i] = a[i] ^ mask[i];
+        }
+        q += 8 + len;
+    }
+
+    // FINGERPRINT covers the header with final length
+    Put16(_response + 2, (uint16_t)(q - _response - HEADER_SIZE + 4 + FINGERPRINT_SIZE));
+    uint32_t crc = Message::Fingerprint(_response, q - _response);
+    Put16(q, (uint16_t)ATTRIBUTE::FINGERPRINT);
+    Put16(q + 2, (uint16_t)FINGERPRINT_SIZE);
+    Put32(q + 4, crc);
+    q += 4 + FINGERPRINT_SIZE;
+    assert(q <= _response + sizeof(_response));
+    return q - _response;
+}
+
+NETB_END
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_ASYNC_STUN_SERVER_HPP
+#define NETB_ASYNC_STUN_SERVER_HPP
+
+#include "Uncopyable.hpp"
+#include "AsyncUdpSocket.hpp"
+#include "EventLoop.hpp"
+#include "StunMessage.hpp"
+
+NETB_BEGIN
+
+//
+// AsyncStunServer answers STUN binding requests over UDP with the
+// reflexive address of the client (RFC 5389), e.g. for NAT discovery
+// of ICE agents.
+//
+// Requests are received in batches, and checked and answered in place
+// into a fixed buffer, with no allocation on the way. Responses carry
+// XOR-MAPPED-ADDRESS and FINGERPRINT. Requests with unknown attributes
+// that must be understood are answered with error 420, and requests of
+// other methods with error 400. Anything else is dropped silently. No
+// credentials are checked, MESSAGE-INTEGRITY of requests is ignored.
+//
+// To use multiple cores, open a server on the same address in each
+// event loop, the kernel spreads requests among them (SO_REUSEPORT).
+//
+class AsyncStunServer : private Uncopyable
+{
+public:
+    // Datagrams received on each read event
+    static const size_t DEFAULT_RECEIVE_BATCH = 32;
+
+    // Unknown attributes listed in error 420, others are left out
+    static const size_t MAX_UNKNOWN_ATTRIBUTES = 16;
+
+    // Largest response, error 420 with all unknown attributes
+    static const size_t MAX_RESPONSE = 128;
+
+    AsyncStunServer(EventLoop* loop) noexcept;
+    ~AsyncStunServer() noexcept;
+
+    // Event loop is exposed for external use
+    EventLoop* GetLoop() const noexcept { return _loop; }
+
+    // Setup before opening
+    void SetReceiveBatch(size_t n) noexcept { _socket.SetReceiveBatch(n); }
+
+    // Open to serve on given address
+    void Open(const SocketAddress& addr); // throw on errors
+    bool Open(const SocketAddress& addr, Error* e) noexcept;
+
+    // Close
+    bool Close(Error* e = nullptr) noexcept;
+
+    // Local address
+    SocketAddress Address() const noexcept { return _socket.Address(); }
+
+    // Counters, only accurate in loop thread
+    uint64_t Requests() const noexcept { return _requests; }
+    uint64_t Dropped() const noexcept { return _dropped; }
+
+private:
+    EventLoop* _loop;
+    AsyncUdpSocket _socket;
+    uint64_t _requests;
+    uint64_t _dropped;
+
+    // Response being sent
+    unsigned char _response[MAX_RESPONSE];
+
+    // AsyncUdpSocket::ReceivedCallback
+    void OnReceived(AsyncUdpSocket* socket, StreamBuffer* buf, const SocketAddress* addr);
+
+    // Write response to a request into the buffer
+    // Return the size of response, or 0 if the request is dropped
+    size_t Answer(const unsigned char* p, size_t n, const SocketAddress& addr) noexcept;
+};
+
+NETB_END
+
+#endif
@@ -28,8 +28,26 @@ AsyncTcpSocket::AsyncTcpSocket(EventLoop* loop) noexcept
 : TcpSocket()
 , _loop(loop)
 , _handler(0)
+, _low_watermark(0)
+, _high_watermark(0)
+, _above_high_watermark(false)
+, _reading_paused(false)
+, _auto_cork(true)
+, _corked(false)
+, _idle_timeout(0)
+, _read_timeout(0)
+, _write_timeout(0)
+, _read_time(0)
+, _write_time(0)
+, _connecting(false)
+, _connect_next(0)
+, _connect_timeout(0)
+, _connect_deadline(-1)
+, _attempt_delay(DEFAULT_ATTEMPT_DELAY)
 {
     assert(_loop);
+    _timer.SetExpiredCallback(std::bind(&AsyncTcpSocket::OnTimer, this, _1));
+    _connect_timer.SetExpiredCallback(std::bind(&AsyncTcpSocket::OnConnectTimer, this, _1));
 }
 
 // Any local address of given family, only working in given family
@@ -37,8 +55,26 @@ AsyncTcpSocket::AsyncTcpSocket(EventLoop* loop, sa_family_t family) noexcept
 : TcpSocket(family)
 , _loop(loop)
 , _handler(0)
+, _low_watermark(0)
+, _high_watermark(0)
+, _above_high_watermark(false)
+, _reading_paused(false)
+, _auto_cork(true)
+, _corked(false)
+, _idle_timeout(0)
+, _read_timeout(0)
+, _write_timeout(0)
+, _read_time(0)
+, _write_time(0)
+, _connecting(false)
+, _connect_next(0)
+, _connect_timeout(0)
+, _connect_deadline(-1)
+, _attempt_delay(DEFAULT_ATTEMPT_DELAY)
 {
     assert(_loop);
+    _timer.SetExpiredCallback(std::bind(&AsyncTcpSocket::OnTimer, this, _1));
+    _connect_timer.SetExpiredCallback(std::bind(&AsyncTcpSocket::OnConnectTimer, this, _1));
 }
 
 
@@ -47,8 +83,26 @@ AsyncTcpSocket::AsyncTcpSocket(EventLoop* loop, const SocketAddress& addr, bool
 : TcpSocket(addr, reuse_addr, reuse_port)
 , _loop(loop)
 , _handler(0)
+, _low_watermark(0)
+, _high_watermark(0)
+, _above_high_watermark(false)
+, _reading_paused(false)
+, _auto_cork(true)
+, _corked(false)
+, _idle_timeout(0)
+, _read_timeout(0)
+, _write_timeout(0)
+, _read_time(0)
+, _write_time(0)
+, _connecting(false)
+, _connect_next(0)
+, _connect_timeout(0)
+, _connect_deadline(-1)
+, _attempt_delay(DEFAULT_ATTEMPT_DELAY)
 {
     assert(_loop);
+    _timer.SetExpiredCallback(std::bind(&AsyncTcpSocket::OnTimer, this, _1));
+    _connect_timer.SetExpiredCallback(std::bind(&AsyncTcpSocket::OnConnectTimer, this, _1));
 }
 
 // Externally established connection with connected address
@@ -56,16 +110,36 @@ AsyncTcpSocket::AsyncTcpSocket(EventLoop* loop, SOCKET s, const SocketAddress* a
 : TcpSocket(s, addr)
 , _loop(loop)
 , _handler(0)
+, _low_watermark(0)
+, _high_watermark(0)
+, _above_high_watermark(false)
+, _reading_paused(false)
+, _auto_cork(true)
+, _corked(false)
+, _idle_timeout(0)
+, _read_timeout(0)
+, _write_timeout(0)
+, _read_time(0)
+, _write_time(0)
+, _connecting(false)
+, _connect_next(0)
+, _connect_timeout(0)
+, _connect_deadline(-1)
+, _attempt_delay(DEFAULT_ATTEMPT_DELAY)
 {
     assert(_loop);
+    _timer.SetExpiredCallback(std::bind(&AsyncTcpSocket::OnTimer, this, _1));
+    _connect_timer.SetExpiredCallback(std::bind(&AsyncTcpSocket::OnConnectTimer, this, _1));
 }
 
 // Destructor
 AsyncTcpSocket::~AsyncTcpSocket() noexcept
 {
     // Isolate from event loop
+    StopConnecting();
     if(_handler)
     {
+        StopTimer();
         _handler->Detach(); // block until done
         delete _handler;
         _handler = 0;
@@ -129,7 +203,12 @@ bool AsyncTcpSocket::EnableWriting(Error* e)
 // Enable async facility on success
 bool AsyncTcpSocket::Connected(Error* e) noexcept 
 {
-    return TcpSocket::Connected(e) && EnableReading(e);
+    if(!TcpSocket::Connected(e) || !EnableReading(e))
+    {
+        return false;
+    }
+    _loop->Invoke(std::bind(&AsyncTcpSocket::StartTimer, this));
+    return true;
 }
 
 // Actively connect to remote address, in block mode
@@ -141,34 +220,265 @@ bool AsyncTcpSocket::Connect(const SocketAddress& addr, Error* e) noexcept
         Close(); // clean on failure
         return false;
     }
+    _loop->Invoke(std::bind(&AsyncTcpSocket::StartTimer, this));
     return true;
 }
 
-// Actively connect to remote address, in non-block mode with timeout
-// timeout of -1 for async mode
-// Enable async facility on success
-// Todo: async mode, enable async waiting for connected events and notify
+// Actively connect to remote address, in async mode with timeout
+// timeout of -1 for block mode, 0 for no timeout
+// The result is notified by connected callback
 bool AsyncTcpSocket::Connect(const SocketAddress& addr, int timeout, Error* e) noexcept
 {
     if(timeout < 0)
     {
         return Connect(addr, e);
     }
-    if(!TcpSocket::Connect(addr, timeout, e) || !EnableReading(e))
+    return Connect(std::vector<SocketAddress>(1, addr), timeout, e);
+}
+
+// Actively connect to one of given addresses, in async mode with timeout
+// Addresses are interleaved by family, starting with the family of first one
+bool AsyncTcpSocket::Connect(const std::vector<SocketAddress>& addrs, int timeout, Error* e) noexcept
+{
+    if(Socket::Valid() || _connecting)
     {
-        Close(); // Clean on failure
+        SET_LOGIC_ERROR(e, "AsyncTcpSocket::Connect : Socket is connected or connecting.", ErrorCode::INVAL);
         return false;
     }
+    std::vector<SocketAddress> primary;
+    std::vector<SocketAddress> secondary;
+    for(auto it = addrs.begin(); it != addrs.end(); ++it)
+    {
+        if(!_address.Empty() && it->Family() != _address.Family())
+        {
+            continue; // only working in the family of local address
+        }
+        if(primary.empty() || it->Family() == primary.front().Family())
+        {
+            primary.push_back(*it);
+        }
+        else
+        {
+            secondary.push_back(*it);
+        }
+    }
+    if(primary.empty())
+    {
+        SET_LOGIC_ERROR(e, "AsyncTcpSocket::Connect : No address to connect.", ErrorCode::INVAL);
+        return false;
+    }
+    _connect_addresses.clear();
+    for(size_t i = 0; i < primary.size() || i < secondary.size(); ++i)
+    {
+        if(i < primary.size()) _connect_addresses.push_back(primary[i]);
+        if(i < secondary.size()) _connect_addresses.push_back(secondary[i]);
+    }
+    _connecting = true;
+    _connect_timeout = timeout;
+    _loop->Invoke(std::bind(&AsyncTcpSocket::StartConnecting, this));
     return true;
 }
 
+// Connecting deadline counts from now
+void AsyncTcpSocket::StartConnecting()
+{
+    _loop->AssertInLoopThread();
+    _error.Reset();
+    _connect_next = 0;
+    _connect_deadline = _connect_timeout > 0 ? _loop->Now() + _connect_timeout : -1;
+    StartAttempt();
+}
+
+// Start an attempt on next address
+// Failed immediately, try next address at once
+void AsyncTcpSocket::StartAttempt()
+{
+    while(_connect_next < _connect_addresses.size())
+    {
+        Attempt* a = new (std::nothrow) Attempt(_connect_addresses[_connect_next++]);
+        if(!a)
+        {
+            _error.Set(RuntimeError(), "AsyncTcpSocket::StartAttempt : New attempt failed.", ErrorCode::NOMEM);
+            break;
+        }
+        if(a->socket.Create(a->address.Family(), SOCK_STREAM, IPPROTO_TCP, &_error) && 
+           _options.Apply(a->socket.Descriptor(), &_error) && 
+           (_address.Empty() || _address.Any() || a->socket.Bind(_address, &_error)) && 
+           a->socket.Block(false, &_error))
+        {
+            if(a->socket.Connect(a->address, &_error))
+            {
+                ConnectDone(a); // established immediately
+                return;
+            }
+            if(SocketError::InProgress(_error.Code()))
+            {
+                _error.Reset();
+                a->handler = new (std::nothrow) EventHandler(_loop, a->socket.Descriptor());
+                if(a->handler)
+                {
+                    a->handler->SetWriteCallback(std::bind(&AsyncTcpSocket::OnAttemptWrite, this, _1));
+                    a->handler->EnableWriting();
+                    _attempts.push_back(a);
+                    break;
+                }
+                _error.Set(RuntimeError(), "AsyncTcpSocket::StartAttempt : New event handler failed.", ErrorCode::NOMEM);
+            }
+        }
+        delete a;
+    }
+    if(_attempts.empty())
+    {
+        ConnectDone(nullptr); // all failed
+        return;
+    }
+    ScheduleConnectTimer();
+}
+
+// Timer on next attempt or connecting deadline, whichever is earlier
+void AsyncTcpSocket::ScheduleConnectTimer()
+{
+    int64_t deadline = _connect_deadline;
+    if(_connect_next < _connect_addresses.size())
+    {
+        int64_t t = _loop->Now() + _attempt_delay;
+        if(deadline < 0 || t < deadline) deadline = t;
+    }
+    if(deadline < 0)
+    {
+        _connect_timer.Cancel();
+        return;
+    }
+    _loop->ScheduleTimer(&_connect_timer, deadline);
+}
+
+// Socket of winner attempt is taken over, others are abandoned
+void AsyncTcpSocket::ConnectDone(Attempt* winner)
+{
+    _connect_timer.Cancel();
+    for(auto it = _attempts.begin(); it != _attempts.end(); ++it)
+    {
+        if(*it != winner) FinishAttempt(*it);
+    }
+    _attempts.clear();
+    _connect_addresses.clear();
+    _connecting = false;
+    if(winner != nullptr)
+    {
+        SocketAddress addr = winner->address;
+        if(winner->handler) winner->handler->Detach();
+        SOCKET s = winner->socket.Detach();
+        FinishAttempt(winner);
+        if(TcpSocket::Connected(s, &addr, &_error))
+        {
+            _error.Reset();
+            if(_connected_callback)
+            {
+                _connected_callback(this, true);
+            }
+            return;
+        }
+        Close(); // clean on failure
+    }
+    if(_connected_callback)
+    {
+        _connected_callback(this, false);
+    }
+}
+
+// Handler may be in its callback, so destroy it later
+void AsyncTcpSocket::FinishAttempt(Attempt* a)
+{
+    if(a->handler) a->handler->Detach();
+    _loop->InvokeLater(std::bind(&AsyncTcpSocket::DestroyAttempt, a));
+}
+
+void AsyncTcpSocket::DestroyAttempt(Attempt* a)
+{
+    delete a->handler;
+    delete a; // close socket
+}
+
+// Abandon connecting attempts
+void AsyncTcpSocket::StopConnecting()
+{
+    if(!_connecting)
+    {
+        return;
+    }
+    if(_loop->IsInLoopThread())
+    {
+        StopConnectingInLoop(nullptr);
+        return;
+    }
+    std::promise<void> done;
+    _loop->Invoke(std::bind(&AsyncTcpSocket::StopConnectingInLoop, this, &done));
+    done.get_future().wait();
+}
+
+void AsyncTcpSocket::StopConnectingInLoop(std::promise<void>* done)
+{
+    _connect_timer.Cancel();
+    for(auto it = _attempts.begin(); it != _attempts.end(); ++it)
+    {
+        FinishAttempt(*it);
+    }
+    _attempts.clear();
+    _connect_addresses.clear();
+    _connect_next = 0;
+    _connecting = false;
+    if(done) done->set_value();
+}
+
+// Attempt is ready to write, connection is established or failed
+void AsyncTcpSocket::OnAttemptWrite(SOCKET s)
+{
+    auto it = _attempts.begin();
+    while(it != _attempts.end() && (*it)->socket.Descriptor() != s) ++it;
+    if(it == _attempts.end())
+    {
+        return;
+    }
+    Attempt* a = *it;
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if(a->socket.GetOption(SOL_SOCKET, SO_ERROR, &err, &len, &_error) && err == 0)
+    {
+        ConnectDone(a);
+        return;
+    }
+    if(err != 0)
+    {
+        SocketError::Connect::SetError(&_error, (Error::MessageStream() << "AsyncTcpSocket::OnAttemptWrite [" 
+                                       << s << "][" << a->address.String() << "]"), err);
+    }
+    _attempts.erase(it);
+    FinishAttempt(a);
+    StartAttempt(); // next one at once
+}
+
+// Next attempt is due, or connecting is timeout
+void AsyncTcpSocket::OnConnectTimer(EventLoop::Timer* timer)
+{
+    assert(timer == &_connect_timer);
+    if(_connect_deadline >= 0 && _loop->Now() >= _connect_deadline)
+    {
+        _error.Set(RuntimeError(), "AsyncTcpSocket::OnConnectTimer : Connect timeout.", ErrorCode::TIMEDOUT);
+        ConnectDone(nullptr);
+        return;
+    }
+    StartAttempt();
+}
+
 // Close the connection
 // Clean async facility
 bool AsyncTcpSocket::Close(Error* e) noexcept
 {
     // Isolate from event loop first
+    StopConnecting();
     if(_handler != nullptr)
     {
+        StopTimer();
         _handler->Detach(); // block until done
         delete _handler;
         _handler = nullptr;
@@ -187,34 +497,80 @@ ssize_t AsyncTcpSocket::Send(const void* p, size_t n, Error* e) noexcept
     assert(_loop != nullptr);
     if(_loop->IsInLoopThread())
     {
+        if(_corked && _out_buffer.Readable() + n > AUTO_CORK_LIMIT)
+        {
+            _corked = false; // too large to hold, held data goes first
+            SendHeld();
+        }
         ssize_t sent = 0;
-        if(_out_buffer.Empty())
+        bool empty = _out_buffer.Empty();
+        if(empty && !_corked)
         {
             sent = TcpSocket::Send(p, n, 0, e); // non-block send
+            if(sent > 0) _write_time = _loop->Now();
+            RecordSent(sent, n);
         }
-        if(sent < n) // buffered left data
+        if(sent < (ssize_t)n) // buffered left data
         {
             size_t off = sent < 0 ? 0 : sent;
             if(_out_buffer.Write((char*)p + off, n - off))
             {
                 sent = n;
             }
+            else
+            {
+                SET_RUNTIME_ERROR(e, "AsyncTcpSocket::Send : Sending buffer is full.", ErrorCode::NOBUFS);
+            }
         }
         if(!_out_buffer.Empty())
         {
+            RecordBuffered(_out_buffer.Readable());
+            if(empty)
+            {
+                OnBuffered();
+            }
+            CheckWatermarks();
             EnableWriting();
         }
         return sent;
     }
     std::unique_lock<std::mutex> lock(_out_buffer_mutex);
+    bool empty = _out_buffer.Empty();
     if(!_out_buffer.Write((char*)p, n))
     {
+        SET_RUNTIME_ERROR(e, "AsyncTcpSocket::Send : Sending buffer is full.", ErrorCode::NOBUFS);
         return 0;
     }
+    if(empty && _write_timeout > 0)
+    {
+        _loop->InvokeLater(std::bind(&AsyncTcpSocket::OnBuffered, this));
+    }
+    if(_high_watermark > 0 && _out_buffer.Readable() >= _high_watermark)
+    {
+        _loop->InvokeLater(std::bind(&AsyncTcpSocket::CheckWatermarks, this));
+    }
     EnableWriting();
     return n;
 }
 
+// Send out held data in non-block mode, the rest stays buffered
+void AsyncTcpSocket::SendHeld()
+{
+    size_t held = _out_buffer.Readable();
+    if(held == 0)
+    {
+        return;
+    }
+    ssize_t sent = Socket::Send(_out_buffer.Read(), held);
+    RecordSent(sent, held);
+    if(sent > 0)
+    {
+        _write_time = _loop->Now();
+        _out_buffer.Read(sent);
+        _out_buffer.Flush(); // release sent data
+    }
+}
+
 // Overloading this function for send out the data from received callback
 ssize_t AsyncTcpSocket::Send(StreamBuffer* buf, Error* e) noexcept
 {
@@ -226,22 +582,44 @@ ssize_t AsyncTcpSocket::Send(StreamBuffer* buf, Error* e) noexcept
 void AsyncTcpSocket::OnRead(SOCKET s)
 {
     ssize_t n = 0;
+    _error.Reset();
     if(_in_buffer.Writable(2048))
     {
-        n = Socket::Receive(_in_buffer.Write(), _in_buffer.Writable());
+        n = Socket::Receive(_in_buffer.Write(), _in_buffer.Writable(), 0, &_error);
+        RecordReceived(n);
+    }
+    else
+    {
+        n = -1;
+        _error.Set(RuntimeError(), "AsyncTcpSocket::OnRead : Receiving buffer is full.", ErrorCode::NOBUFS);
     }
     if(n > 0)
     {
+        _read_time = _loop->Now();
         _in_buffer.Write(n);
         if(_received_callback)
         {
+            // Hold sending only if nothing is pending, otherwise the held
+            // data is sent on ready to write anyway
+            // The connection must not be deleted in received callback
+            _corked = _auto_cork && _out_buffer.Empty();
+            RecordLatency();
             _received_callback(this, &_in_buffer);
+            if(_corked)
+            {
+                _corked = false;
+                if(!_out_buffer.Empty())
+                {
+                    OnWrite(GetSocket()); // send out held data
+                }
+            }
         }
     }
     else // Error
     {
         assert(_handler);
         _handler->DisableReading();
+        _timer.Cancel();
         if(_connected_callback)
         {
             _connected_callback(this, false);
@@ -255,14 +633,266 @@ void AsyncTcpSocket::OnWrite(SOCKET s)
 {
     if(_out_buffer.Readable() > 0)
     {
-        ssize_t sent = Socket::Send(_out_buffer.Read(), _out_buffer.Readable());
-        if(sent > 0) _out_buffer.Read(sent);
+        size_t buffered = _out_buffer.Readable();
+        RecordBuffered(buffered);
+        ssize_t sent = Socket::Send(_out_buffer.Read(), buffered);
+        RecordSent(sent, buffered);
+        if(sent > 0)
+        {
+            _out_buffer.Read(sent);
+            _out_buffer.Flush(); // release sent data
+            _write_time = _loop->Now();
+        }
     }
     if(_out_buffer.Readable() == 0)
     {
         assert(_handler != nullptr);
         _handler->DisableWriting();
     }
+    CheckWatermarks();
+}
+
+// Watermarks may be set at any time, checked on next I/O
+void AsyncTcpSocket::SetWatermarks(size_t low, size_t high) noexcept
+{
+    assert(low <= high);
+    _low_watermark = low;
+    _high_watermark = high;
+}
+
+// Rising to high watermark and draining to low watermark are notified 
+// once in turn, the callback may send or close freely
+void AsyncTcpSocket::CheckWatermarks()
+{
+    if(_high_watermark == 0)
+    {
+        return;
+    }
+    size_t buffered = _out_buffer.Readable();
+    if(!_above_high_watermark && buffered >= _high_watermark)
+    {
+        _above_high_watermark = true;
+        if(_high_watermark_callback)
+        {
+            _high_watermark_callback(this, buffered);
+        }
+    }
+    else if(_above_high_watermark && buffered <= _low_watermark)
+    {
+        _above_high_watermark = false;
+        if(_low_watermark_callback)
+        {
+            _low_watermark_callback(this, buffered);
+        }
+    }
+}
+
+// Stop reading from peer
+bool AsyncTcpSocket::PauseReading(Error* e) noexcept
+{
+    if(_handler == nullptr)
+    {
+        SET_LOGIC_ERROR(e, "AsyncTcpSocket::PauseReading : Connection is not established.", ErrorCode::BADF);
+        return false;
+    }
+    _reading_paused = true;
+    _handler->DisableReading();
+    return true;
+}
+
+// Restart reading from peer
+bool AsyncTcpSocket::ResumeReading(Error* e) noexcept
+{
+    if(_handler == nullptr)
+    {
+        SET_LOGIC_ERROR(e, "AsyncTcpSocket::ResumeReading : Connection is not established.", ErrorCode::BADF);
+        return false;
+    }
+    if(!EnableReading(e))
+    {
+        return false;
+    }
+    if(_reading_paused)
+    {
+        _reading_paused = false;
+        _loop->Invoke(std::bind(&AsyncTcpSocket::OnResumed, this));
+    }
+    return true;
+}
+
+// Reading is restarted, read deadline counts from now
+void AsyncTcpSocket::OnResumed()
+{
+    _read_time = _loop->Now();
+    UpdateTimer();
+}
+
+// Deadlines may be set at any time
+// the timer is updated in loop if async facility is enabled
+void AsyncTcpSocket::SetIdleTimeout(int timeout) noexcept
+{
+    _idle_timeout = timeout > 0 ? timeout : 0;
+    if(_handler != nullptr)
+    {
+        _loop->Invoke(std::bind(&AsyncTcpSocket::UpdateTimer, this));
+    }
+}
+
+void AsyncTcpSocket::SetReadTimeout(int timeout) noexcept
+{
+    _read_timeout = timeout > 0 ? timeout : 0;
+    if(_handler != nullptr)
+    {
+        _loop->Invoke(std::bind(&AsyncTcpSocket::UpdateTimer, this));
+    }
+}
+
+void AsyncTcpSocket::SetWriteTimeout(int timeout) noexcept
+{
+    _write_timeout = timeout > 0 ? timeout : 0;
+    if(_handler != nullptr)
+    {
+        _loop->Invoke(std::bind(&AsyncTcpSocket::UpdateTimer, this));
+    }
+}
+
+// Connection is established, all deadlines count from now
+void AsyncTcpSocket::StartTimer()
+{
+    _loop->AssertInLoopThread();
+    _read_time = _write_time = _loop->Now();
+    UpdateTimer();
+}
+
+// Schedule the timer on earliest deadline
+// Moving to a later deadline is cheap in timing wheel
+void AsyncTcpSocket::UpdateTimer()
+{
+    _loop->AssertInLoopThread();
+    int64_t deadline = -1;
+    if(_idle_timeout > 0)
+    {
+        deadline = std::max(_read_time, _write_time) + _idle_timeout;
+    }
+    if(_read_timeout > 0 && !_reading_paused)
+    {
+        int64_t t = _read_time + _read_timeout;
+        if(deadline < 0 || t < deadline) deadline = t;
+    }
+    if(_write_timeout > 0 && !_out_buffer.Empty())
+    {
+        int64_t t = _write_time + _write_timeout;
+        if(deadline < 0 || t < deadline) deadline = t;
+    }
+    if(deadline < 0)
+    {
+        _timer.Cancel();
+        return;
+    }
+    _loop->ScheduleTimer(&_timer, deadline);
+}
+
+// Timer must be removed in loop thread
+// out of loop it is queued ahead of detaching handler, which blocks until done
+void AsyncTcpSocket::StopTimer()
+{
+    if(_loop->IsInLoopThread())
+    {
+        _timer.Cancel();
+    }
+    else
+    {
+        _loop->Invoke(std::bind(&EventLoop::Timer::Cancel, &_timer));
+    }
+}
+
+// Sending starts to wait from now
+void AsyncTcpSocket::OnBuffered()
+{
+    _write_time = _loop->Now();
+    if(_write_timeout > 0)
+    {
+        UpdateTimer();
+    }
+}
+
+// Timer expired on the earliest deadline it was scheduled
+// deadlines may be refreshed by I/O since then, check again 
+void AsyncTcpSocket::OnTimer(EventLoop::Timer* timer)
+{
+    assert(timer == &_timer);
+    int64_t now = _loop->Now();
+    const char* reason = nullptr;
+    if(_write_timeout > 0 && !_out_buffer.Empty() && _write_time + _write_timeout <= now)
+    {
+        reason = "Write timeout.";
+    }
+    else if(_read_timeout > 0 && !_reading_paused && _read_time + _read_timeout <= now)
+    {
+        reason = "Read timeout.";
+    }
+    else if(_idle_timeout > 0 && std::max(_read_time, _write_time) + _idle_timeout <= now)
+    {
+        reason = "Idle timeout.";
+    }
+    if(reason == nullptr)
+    {
+        UpdateTimer();
+        return;
+    }
+    _error.Set(RuntimeError(), std::string("AsyncTcpSocket::OnTimer : ") + reason, ErrorCode::TIMEDOUT);
+    assert(_handler != nullptr);
+    _handler->DisableReading();
+    _handler->DisableWriting();
+    if(_connected_callback)
+    {
+        _connected_callback(this, false); // may be deleted
+    }
+    else
+    {
+        Close(); // release descriptor if no one takes care
+    }
+}
+
+void AsyncTcpSocket::EnableStats(Histogram* latency)
+{
+    if(!_stats) _stats.reset(new SocketStats(latency));
+}
+
+// Stats of the socket and the loop are both optional
+void AsyncTcpSocket::RecordReceived(ssize_t n) noexcept
+{
+    if(_stats) _stats->OnReceived(n);
+    SocketStats* totals = _loop->SocketTotals();
+    if(totals) totals->OnReceived(n);
+}
+
+void AsyncTcpSocket::RecordSent(ssize_t n, size_t requested) noexcept
+{
+    if(_stats) _stats->OnSent(n, requested);
+    SocketStats* totals = _loop->SocketTotals();
+    if(totals) totals->OnSent(n, requested);
+}
+
+void AsyncTcpSocket::RecordBuffered(size_t n) noexcept
+{
+    if(_stats) _stats->OnBuffered(n);
+    SocketStats* totals = _loop->SocketTotals();
+    if(totals) totals->OnBuffered(n);
+}
+
+// Latency is the time the loop has been busy since waking up, which is
+// known only if stats of the loop are enabled
+void AsyncTcpSocket::RecordLatency() noexcept
+{
+    const EventLoopStats* stats = _loop->Stats();
+    if(stats)
+    {
+        int64_t us = stats->Busy();
+        SocketStats* totals = _loop->SocketTotals();
+        if(totals) totals->OnLatency(us);
+        if(_stats) _stats->OnLatency(us);
+    }
 }
 
 NETB_END
@@ -22,13 +22,30 @@
 #include "EventLoop.hpp"
 #include "EventHandler.hpp"
 #include "StreamBuffer.hpp"
+#include "SocketStats.hpp"
 #include <functional>
+#include <future>
 
 NETB_BEGIN
 
 //
 // AsynTcpSocket is a wrapper class of TCP socket that works in async mode. 
 //
+// Optional idle, read and write deadlines bound the lifetime of dead or 
+// slow peers. They are checked by a timer in the timing wheel of event 
+// loop, and refreshed on each I/O by recording the time of the loop only. 
+// On expiry connected callback is notified with false, and the reason is 
+// given by GetError() with ErrorCode::TIMEDOUT. 
+//
+// Sending buffer may have high and low watermarks for backpressure. 
+// HighWatermarkCallback is notified when buffered data rises to the high 
+// watermark, and LowWatermarkCallback when it drains to the low watermark. 
+// A proxy pauses reading from the upstream peer on the former and resumes 
+// on the latter, so that memory is bounded and no bytes are dropped: 
+//
+//     down->SetHighWatermarkCallback([up](AsyncTcpSocket*, size_t) { up->PauseReading(); });
+//     down->SetLowWatermarkCallback([up](AsyncTcpSocket*, size_t) { up->ResumeReading(); });
+//
 class AsyncTcpSocket : public TcpSocket
 {
 public:
@@ -60,11 +77,26 @@ public:
     using TcpSocket::Connect;
     virtual bool Connect(const SocketAddress& addr, Error* e) noexcept;
 
-    // Actively connect to remote address, in non-block mode with timeout
-    // timeout of -1 for block mode
+    // Actively connect to remote address, in async mode with timeout
+    // timeout of -1 for block mode, 0 for no timeout
+    // Return true if connecting is started, the result is notified by 
+    // ConnectedCallback, and the reason of failure is given by GetError()
     // Enable async facility on success
     virtual bool Connect(const SocketAddress& addr, int timeout, Error* e) noexcept;
 
+    // Actively connect to one of remote addresses, in async mode with timeout
+    // Addresses are raced as Happy Eyeballs (RFC 8305): families are 
+    // interleaved, next attempt is started if former ones are not done 
+    // in attempt delay, and the first established one wins
+    bool Connect(const std::vector<SocketAddress>& addrs, int timeout, Error* e = nullptr) noexcept;
+
+    // Delay in milliseconds to start next connecting attempt
+    static const int DEFAULT_ATTEMPT_DELAY = 250;
+    void SetAttemptDelay(int delay) noexcept { _attempt_delay = delay; }
+
+    // Async connecting is in progress
+    bool Connecting() const noexcept { return _connecting; }
+
     // Close the connection
     // Clean asycn facility
     virtual bool Close(Error* e = nullptr) noexcept;
@@ -77,6 +109,53 @@ public:
     // Overloading for send data from received callback
     virtual ssize_t Send(StreamBuffer* buf, Error* e = nullptr) noexcept;
 
+    // Deadlines in milliseconds, 0 to disable (default)
+    // Idle: neither received nor sent any data in given time
+    // Read: not received any data in given time
+    // Write: buffered data is not sent out in given time
+    void SetIdleTimeout(int timeout) noexcept;
+    void SetReadTimeout(int timeout) noexcept;
+    void SetWriteTimeout(int timeout) noexcept;
+
+    // Watermarks of sending buffer in bytes, high of 0 to disable (default)
+    void SetWatermarks(size_t low, size_t high) noexcept;
+
+    // Notification of buffered data crossing watermarks, with buffered size
+    typedef std::function<void (AsyncTcpSocket*, size_t)> WatermarkCallback;
+    void SetHighWatermarkCallback(const WatermarkCallback& cb) noexcept { _high_watermark_callback = cb; }
+    void SetLowWatermarkCallback(const WatermarkCallback& cb) noexcept { _low_watermark_callback = cb; }
+
+    // Number of bytes waiting in sending buffer
+    size_t Buffered() const noexcept { return _out_buffer.Readable(); }
+
+    // Stop and restart reading from peer, received data stays in kernel 
+    // and TCP flow control slows down the peer
+    bool PauseReading(Error* e = nullptr) noexcept;
+    bool ResumeReading(Error* e = nullptr) noexcept;
+    bool ReadingPaused() const noexcept { return _reading_paused; }
+
+    // Data sent in received callback is held and sent out together
+    // after the callback, so that a response written in pieces leaves
+    // in full segments. Enabled by default. Once held data would exceed
+    // AUTO_CORK_LIMIT, it is sent out at once and the rest is written
+    // through as usual, so large responses are not limited by the
+    // sending buffer.
+    static const size_t AUTO_CORK_LIMIT = 16 * 1024;
+    void SetAutoCork(bool cork) noexcept { _auto_cork = cork; }
+
+    // Per-socket I/O stats, off by default. I/O is also counted in the
+    // stats of the loop if enabled. Latency of received callback is 
+    // recorded to given histogram, which may be shared, e.g. per route.
+    // It is timed from the loop waking up, so only recorded if stats of
+    // the loop are enabled too.
+    // Must called in loop thread or before connected
+    void EnableStats(Histogram* latency = nullptr);
+    const SocketStats* Stats() const noexcept { return _stats.get(); }
+
+    // Reason of last notification of disconnected status
+    // Empty if the connection is closed by peer
+    const Error& GetError() const noexcept { return _error; }
+
     // Notification of connected status
     typedef std::function<void (AsyncTcpSocket*, bool)> ConnectedCallback;
     void SetConnectedCallback(const ConnectedCallback& cb) noexcept { _connected_callback = cb; }
@@ -145,6 +224,89 @@ private:
     StreamBuffer _out_buffer;
     std::mutex _out_buffer_mutex;
 
+    // Backpressure, only used in loop thread
+    size_t _low_watermark;
+    size_t _high_watermark;
+    bool _above_high_watermark;
+    bool _reading_paused;
+    WatermarkCallback _high_watermark_callback;
+    WatermarkCallback _low_watermark_callback;
+
+    // Sending is held in received callback, only used in loop thread
+    bool _auto_cork;
+    bool _corked;
+
+    // Notify if buffered data crossed watermarks
+    void CheckWatermarks();
+
+    // Optional stats, only updated in loop thread
+    std::unique_ptr<SocketStats> _stats;
+    void RecordReceived(ssize_t n) noexcept;
+    void RecordSent(ssize_t n, size_t requested) noexcept;
+    void RecordBuffered(size_t n) noexcept;
+    void RecordLatency() noexcept;
+
+    // Deadlines, only used in loop thread
+    EventLoop::Timer _timer;
+    int _idle_timeout;
+    int _read_timeout;
+    int _write_timeout;
+    int64_t _read_time; // last time of receiving data
+    int64_t _write_time; // last time of sending progress
+    Error _error;
+
+    // Start, update and stop the timer with earliest deadline
+    void StartTimer();
+    void UpdateTimer();
+    void StopTimer();
+
+    // EventLoop::Timer::ExpiredCallback
+    void OnTimer(EventLoop::Timer* timer);
+
+    // Sending buffer turns to be non-empty
+    void OnBuffered();
+
+    // Reading is resumed after paused
+    void OnResumed();
+
+    // Async connecting, each attempt with its own socket and handler
+    struct Attempt
+    {
+        Socket socket;
+        EventHandler* handler;
+        SocketAddress address;
+
+        explicit Attempt(const SocketAddress& addr) : handler(nullptr), address(addr) { }
+    };
+    bool _connecting;
+    std::vector<SocketAddress> _connect_addresses; // in order of attempts
+    size_t _connect_next;
+    int _connect_timeout;
+    int64_t _connect_deadline;
+    int _attempt_delay;
+    std::vector<Attempt*> _attempts; // in progress
+    EventLoop::Timer _connect_timer;
+
+    // Start connecting and next attempt in loop
+    void StartConnecting();
+    void StartAttempt();
+    void ScheduleConnectTimer();
+
+    // Winner is taken over, or all failed if it is null
+    void ConnectDone(Attempt* winner);
+
+    // Remove attempt from loop, destroyed later out of its callback
+    void FinishAttempt(Attempt* a);
+    static void DestroyAttempt(Attempt* a);
+
+    // Abandon connecting, block until done if out of loop
+    void StopConnecting();
+    void StopConnectingInLoop(std::promise<void>* done);
+
+    // Connecting events
+    void OnAttemptWrite(SOCKET s);
+    void OnConnectTimer(EventLoop::Timer* timer);
+
     // Register I/O events to enable reading and writing
     bool InitHandler(Error* = nullptr);
     bool EnableReading(Error* e = nullptr);
@@ -154,6 +316,9 @@ private:
     // I/O event is ready
     void OnRead(SOCKET s);
     void OnWrite(SOCKET s);
+
+    // Send out data held by auto cork
+    void SendHeld();
 };
 
 NETB_END
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncTcpSocketPool.hpp"
+#include "SocketError.hpp"
+#include <algorithm>
+#include <cassert>
+
+NETB_BEGIN
+
+// std::placeholders::_1, _2, ...
+using namespace std::placeholders;
+
+AsyncTcpSocketPool::AsyncTcpSocketPool(EventLoop* loop, size_t max_per_host, int idle_timeout, int connect_timeout) noexcept
+: _loop(loop)
+, _max_per_host(max_per_host)
+, _idle_timeout(idle_timeout)
+, _connect_timeout(connect_timeout)
+{
+    assert(_loop);
+    assert(_max_per_host > 0);
+}
+
+// All connections are closed, including checked out ones
+AsyncTcpSocketPool::~AsyncTcpSocketPool() noexcept
+{
+    for(auto it = _sockets.begin(); it != _sockets.end(); ++it)
+    {
+        delete it->first;
+    }
+}
+
+// Idle connection is passed at once, otherwise connect a new one
+// if the host is not full, or wait for a returned one
+void AsyncTcpSocketPool::Checkout(const SocketAddress& addr, const CheckoutCallback& cb) noexcept
+{
+    _loop->AssertInLoopThread();
+    AsyncTcpSocket* conn = TryCheckout(addr);
+    if(conn != nullptr)
+    {
+        cb(conn);
+        return;
+    }
+    Host& host = _hosts[addr];
+    Wait(addr, host, cb); // served on connected, returned or discarded
+    if(host.size >= _max_per_host)
+    {
+        return;
+    }
+    if(!Connect(addr, host))
+    {
+        host.waiters.pop_back();
+        cb(nullptr);
+    }
+}
+
+// Most recently used idle connection, which is the warmest one
+AsyncTcpSocket* AsyncTcpSocketPool::TryCheckout(const SocketAddress& addr) noexcept
+{
+    _loop->AssertInLoopThread();
+    auto it = _hosts.find(addr);
+    if(it == _hosts.end())
+    {
+        return nullptr;
+    }
+    Host& host = it->second;
+    while(!host.idle.empty())
+    {
+        AsyncTcpSocket* conn = host.idle.back();
+        host.idle.pop_back();
+        if(Healthy(conn))
+        {
+            conn->SetConnectedCallback(nullptr);
+            conn->SetReceivedCallback(nullptr);
+            conn->SetIdleTimeout(0);
+            return conn;
+        }
+        Discard(conn);
+    }
+    return nullptr;
+}
+
+// Reusable connection is passed to a waiter or kept as idle
+void AsyncTcpSocketPool::Return(AsyncTcpSocket* conn, bool reusable) noexcept
+{
+    _loop->AssertInLoopThread();
+    auto it = _sockets.find(conn);
+    if(it == _sockets.end())
+    {
+        assert(false); // not from this pool
+        return;
+    }
+    if(!reusable || conn->Buffered() > 0 || !Healthy(conn))
+    {
+        Discard(conn);
+        return;
+    }
+    Host& host = _hosts[it->second];
+    if(!host.waiters.empty())
+    {
+        Handover(conn, Serve(host));
+        return;
+    }
+    Idle(conn, host);
+}
+
+// Connecting ones are counted
+// Connecting may fail at once, so attempts are limited
+void AsyncTcpSocketPool::WarmUp(const SocketAddress& addr, size_t n) noexcept
+{
+    _loop->AssertInLoopThread();
+    Host& host = _hosts[addr];
+    for(size_t i = host.size; i < n && i < _max_per_host; ++i)
+    {
+        if(!Connect(addr, host))
+        {
+            break;
+        }
+    }
+}
+
+size_t AsyncTcpSocketPool::Idle(const SocketAddress& addr) const noexcept
+{
+    auto it = _hosts.find(addr);
+    return it == _hosts.end() ? 0 : it->second.idle.size();
+}
+
+size_t AsyncTcpSocketPool::Size(const SocketAddress& addr) const noexcept
+{
+    auto it = _hosts.find(addr);
+    return it == _hosts.end() ? 0 : it->second.size;
+}
+
+// Connecting in async mode, result is notified by OnConnected
+// Connecting starts at once in loop thread, and may be done before
+// returning, so the connection is tracked ahead
+bool AsyncTcpSocketPool::Connect(const SocketAddress& addr, Host& host) noexcept
+{
+    AsyncTcpSocket* conn = new (std::nothrow) AsyncTcpSocket(_loop);
+    if(!conn)
+    {
+        return false;
+    }
+    conn->SetConnectedCallback(std::bind(&AsyncTcpSocketPool::OnConnected, this, _1, _2));
+    _sockets[conn] = addr;
+    ++host.size;
+    if(!conn->Connect(addr, _connect_timeout, nullptr))
+    {
+        _sockets.erase(conn);
+        --host.size;
+        delete conn;
+        return false;
+    }
+    return true;
+}
+
+// Waiters share the connect timeout, so the first one expires first
+void AsyncTcpSocketPool::Wait(const SocketAddress& addr, Host& host, const CheckoutCallback& cb) noexcept
+{
+    Waiter w;
+    w.cb = cb;
+    w.deadline = _connect_timeout > 0 ? _loop->Now() + _connect_timeout : -1;
+    host.waiters.push_back(w);
+    if(w.deadline >= 0 && !host.timer.Active())
+    {
+        host.timer.SetExpiredCallback(std::bind(&AsyncTcpSocketPool::OnWaitTimeout, this, addr));
+        _loop->ScheduleTimer(&host.timer, w.deadline);
+    }
+}
+
+AsyncTcpSocketPool::CheckoutCallback AsyncTcpSocketPool::Serve(Host& host) noexcept
+{
+    assert(!host.waiters.empty());
+    CheckoutCallback cb = host.waiters.front().cb;
+    host.waiters.pop_front();
+    if(host.waiters.empty())
+    {
+        host.timer.Cancel();
+    }
+    return cb;
+}
+
+// User takes care of callbacks and deadlines
+void AsyncTcpSocketPool::Handover(AsyncTcpSocket* conn, const CheckoutCallback& cb) noexcept
+{
+    conn->SetConnectedCallback(nullptr);
+    conn->SetReceivedCallback(nullptr);
+    conn->SetIdleTimeout(0);
+    cb(conn);
+}
+
+// Idle connection keeps reading to find closed or misbehaved one
+void AsyncTcpSocketPool::Idle(AsyncTcpSocket* conn, Host& host) noexcept
+{
+    conn->SetConnectedCallback(std::bind(&AsyncTcpSocketPool::OnConnected, this, _1, _2));
+    conn->SetReceivedCallback(std::bind(&AsyncTcpSocketPool::OnReceived, this, _1, _2));
+    conn->SetIdleTimeout(_idle_timeout);
+    host.idle.push_back(conn);
+}
+
+// Remove from pool, a waiter gets the free slot
+void AsyncTcpSocketPool::Discard(AsyncTcpSocket* conn) noexcept
+{
+    auto it = _sockets.find(conn);
+    assert(it != _sockets.end());
+    SocketAddress addr = it->second;
+    _sockets.erase(it);
+    Host& host = _hosts[addr];
+    auto idle = std::find(host.idle.begin(), host.idle.end(), conn);
+    if(idle != host.idle.end())
+    {
+        host.idle.erase(idle);
+    }
+    assert(host.size > 0);
+    --host.size;
+    conn->SetConnectedCallback(nullptr);
+    conn->SetReceivedCallback(nullptr);
+    _loop->InvokeLater(std::bind(&AsyncTcpSocketPool::Destroy, conn));
+    if(!host.waiters.empty() && host.size < _max_per_host)
+    {
+        if(!Connect(addr, host))
+        {
+            Serve(host)(nullptr);
+        }
+    }
+}
+
+// Peek without consuming data
+bool AsyncTcpSocketPool::Healthy(AsyncTcpSocket* conn) noexcept
+{
+    if(conn->GetSocket() == INVALID_SOCKET)
+    {
+        return false;
+    }
+    char c;
+    ssize_t n = ::recv(conn->GetSocket(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && SocketError::WouldBlock();
+}
+
+void AsyncTcpSocketPool::Destroy(AsyncTcpSocket* conn) noexcept
+{
+    delete conn;
+}
+
+// Connecting is done, or idle connection is closed or timeout
+void AsyncTcpSocketPool::OnConnected(AsyncTcpSocket* conn, bool connected)
+{
+    auto it = _sockets.find(conn);
+    assert(it != _sockets.end());
+    Host& host = _hosts[it->second];
+    if(!connected)
+    {
+        // Failed connecting, a waiter fails instead of retrying
+        CheckoutCallback cb;
+        bool idle = std::find(host.idle.begin(), host.idle.end(), conn) != host.idle.end();
+        if(!idle && !host.waiters.empty())
+        {
+            cb = Serve(host);
+        }
+        Discard(conn);
+        if(cb)
+        {
+            cb(nullptr);
+        }
+        return;
+    }
+    if(!host.waiters.empty())
+    {
+        Handover(conn, Serve(host));
+        return;
+    }
+    Idle(conn, host);
+}
+
+// Idle connection is not expected to receive any data
+void AsyncTcpSocketPool::OnReceived(AsyncTcpSocket* conn, StreamBuffer* buf)
+{
+    Discard(conn);
+}
+
+// Expired waiters are removed before notified, as callbacks may
+// check out again
+void AsyncTcpSocketPool::OnWaitTimeout(const SocketAddress& addr)
+{
+    Host& host = _hosts[addr];
+    std::vector<CheckoutCallback> expired;
+    while(!host.waiters.empty() && host.waiters.front().deadline <= _loop->Now())
+    {
+        expired.push_back(host.waiters.front().cb);
+        host.waiters.pop_front();
+    }
+    if(!host.waiters.empty())
+    {
+        _loop->ScheduleTimer(&host.timer, host.waiters.front().deadline);
+    }
+    for(size_t i = 0; i < expired.size(); ++i)
+    {
+        expired[i](nullptr);
+    }
+}
+
+NETB_END
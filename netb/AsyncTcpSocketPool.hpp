@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_ASYNC_TCP_SOCKET_POOL_HPP
+#define NETB_ASYNC_TCP_SOCKET_POOL_HPP
+
+#include "Uncopyable.hpp"
+#include "AsyncTcpSocket.hpp"
+#include "SocketAddress.hpp"
+#include <functional>
+#include <deque>
+#include <map>
+
+NETB_BEGIN
+
+//
+// AsyncTcpSocketPool keeps established outbound connections for reuse,
+// keyed by remote address, so that requests to the same backends do not
+// pay a handshake and TIME_WAIT each time.
+//
+// A pool is bound to an event loop and is only used in the loop thread,
+// so checkout and return need no locking. An application with multiple
+// loops keeps a pool per loop.
+//
+// Number of connections to a host, including idle, checked out and
+// connecting ones, is limited. Checkout waits in FIFO order if the limit
+// is reached, and fails if not served within the connect timeout. Idle
+// connections keep reading, so that closed or misbehaved ones are
+// dropped at once, and are checked again before checkout. They are
+// closed after idle timeout of AsyncTcpSocket.
+//
+// Checked out connection belongs to user until it is returned, user sets
+// its own callbacks on it. Connections are owned by the pool, they are
+// all closed when the pool is destroyed.
+//
+class AsyncTcpSocketPool : private Uncopyable
+{
+public:
+    // Limits of connections, timeouts in milliseconds
+    static const size_t DEFAULT_MAX_PER_HOST = 8;
+    static const int DEFAULT_IDLE_TIMEOUT = 60000;
+    static const int DEFAULT_CONNECT_TIMEOUT = 3000;
+
+    AsyncTcpSocketPool(EventLoop* loop,
+                       size_t max_per_host = DEFAULT_MAX_PER_HOST,
+                       int idle_timeout = DEFAULT_IDLE_TIMEOUT,
+                       int connect_timeout = DEFAULT_CONNECT_TIMEOUT) noexcept;
+    ~AsyncTcpSocketPool() noexcept;
+
+    // Event loop is exposed for external use
+    EventLoop* GetLoop() const noexcept { return _loop; }
+
+    // Notification of checkout, connection is null on failure
+    typedef std::function<void (AsyncTcpSocket*)> CheckoutCallback;
+
+    // Get an established connection to the address
+    // Notified at once if an idle one is available, otherwise
+    // after connecting or waiting for returned one
+    void Checkout(const SocketAddress& addr, const CheckoutCallback& cb) noexcept;
+
+    // Get an idle connection to the address, null if not available
+    AsyncTcpSocket* TryCheckout(const SocketAddress& addr) noexcept;
+
+    // Give back a checked out connection
+    // It is closed if not reusable, e.g. the protocol state is unknown
+    void Return(AsyncTcpSocket* conn, bool reusable = true) noexcept;
+
+    // Establish connections to the address ahead of use
+    // up to given number of connections in total
+    void WarmUp(const SocketAddress& addr, size_t n) noexcept;
+
+    // Number of idle connections and all connections to the address
+    size_t Idle(const SocketAddress& addr) const noexcept;
+    size_t Size(const SocketAddress& addr) const noexcept;
+
+private:
+    EventLoop* _loop;
+    size_t _max_per_host;
+    int _idle_timeout;
+    int _connect_timeout;
+
+    // Checkout waiting for a connection
+    struct Waiter
+    {
+        CheckoutCallback cb;
+        int64_t deadline;
+    };
+
+    // Connections to a host
+    struct Host
+    {
+        std::vector<AsyncTcpSocket*> idle; // most recently used at back
+        std::deque<Waiter> waiters; // deadlines in ascending order
+        EventLoop::Timer timer; // on deadline of the first waiter
+        size_t size; // idle, checked out and connecting
+
+        Host() : size(0) { }
+    };
+    std::map<SocketAddress, Host> _hosts;
+
+    // All connections and their remote addresses
+    std::map<AsyncTcpSocket*, SocketAddress> _sockets;
+
+    // Start a new connection to the host
+    bool Connect(const SocketAddress& addr, Host& host) noexcept;
+
+    // Queue a checkout, or take the first one
+    void Wait(const SocketAddress& addr, Host& host, const CheckoutCallback& cb) noexcept;
+    CheckoutCallback Serve(Host& host) noexcept;
+
+    // Pass to user, or keep as idle
+    void Handover(AsyncTcpSocket* conn, const CheckoutCallback& cb) noexcept;
+    void Idle(AsyncTcpSocket* conn, Host& host) noexcept;
+
+    // Close a connection and serve a waiter with a new one
+    void Discard(AsyncTcpSocket* conn) noexcept;
+
+    // Not closed by peer and no unexpected data
+    static bool Healthy(AsyncTcpSocket* conn) noexcept;
+
+    // Deleted later, out of callbacks of the connection
+    static void Destroy(AsyncTcpSocket* conn) noexcept;
+
+    // AsyncTcpSocket callbacks on connecting and idle connections
+    void OnConnected(AsyncTcpSocket* conn, bool connected);
+    void OnReceived(AsyncTcpSocket* conn, StreamBuffer* buf);
+
+    // Fail waiters that are not served in time
+    void OnWaitTimeout(const SocketAddress& addr);
+};
+
+NETB_END
+
+#endif
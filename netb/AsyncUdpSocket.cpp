@@ -16,6 +16,7 @@
  */
 
 #include "AsyncUdpSocket.hpp"
+#include <cstring>
 #include <cassert>
 
 NETB_BEGIN
@@ -28,6 +29,7 @@ AsyncUdpSocket::AsyncUdpSocket(EventLoop* loop) noexcept
 : UdpSocket()
 , _loop(loop)
 , _handler(nullptr)
+, _receive_batch(1)
 {
     assert(_loop);
 }
@@ -37,6 +39,7 @@ AsyncUdpSocket::AsyncUdpSocket(EventLoop* loop, sa_family_t family) noexcept
 : UdpSocket(family)
 , _loop(loop)
 , _handler(nullptr)
+, _receive_batch(1)
 {
     assert(_loop);
 }
@@ -46,6 +49,7 @@ AsyncUdpSocket::AsyncUdpSocket(EventLoop* loop, const SocketAddress& addr) noexc
 : UdpSocket(addr)
 , _loop(loop)
 , _handler(nullptr)
+, _receive_batch(1)
 {
     assert(_loop);
 }
@@ -161,6 +165,7 @@ ssize_t AsyncUdpSocket::SendTo(const void* p, size_t n, const SocketAddress& add
     if(_out_buffers.empty())
     {
         sent = Socket::SendTo(p, n, addr, 0, e);
+        RecordSent(sent, n);
     }
     if(sent < n)
     {
@@ -197,6 +202,7 @@ ssize_t AsyncUdpSocket::Send(const void* p, size_t n, Error* e) noexcept
     if(_out_buffers.empty())
     {
         sent = Socket::Send(p, n, 0, e);
+        RecordSent(sent, n);
     }
     if(sent < n)
     {
@@ -213,22 +219,38 @@ ssize_t AsyncUdpSocket::Send(StreamBuffer* buf, Error* e) noexcept
     return Send(*buf, e);
 }
 
+// Buffers are prepared at once, and reused for all read events
+void AsyncUdpSocket::SetReceiveBatch(size_t n) noexcept
+{
+    assert(n > 0 && n <= MAX_RECEIVE_BATCH);
+    _receive_batch = n;
+    _batch_buffers.resize(n > 1 ? n : 0);
+    _batch_addrs.resize(n > 1 ? n : 0);
+}
+
 // EventHandler::EventCallback
 // Read is ready
 void AsyncUdpSocket::OnRead(SOCKET s)
 {
     assert(s == GetSocket());
+    if(_receive_batch > 1)
+    {
+        OnReadBatch(s);
+        return;
+    }
     ssize_t n = 0;
     SocketAddress addr;
     if(_in_buffer.Writable(RECEIVE_BUFFER_SIZE))
     {
         n = Socket::ReceiveFrom(_in_buffer.Write(), _in_buffer.Writable(), &addr);
+        RecordReceived(n);
     }
     if(n > 0)
     {
         _in_buffer.Write(n);
         if(_received_callback)
         {
+            RecordLatency();
             _received_callback(this, &_in_buffer, &addr);
         }
     }
@@ -238,6 +260,80 @@ void AsyncUdpSocket::OnRead(SOCKET s)
     }
 }
 
+// Receive multiple datagrams without blocking
+// Stop if the socket is closed in callback
+void AsyncUdpSocket::OnReadBatch(SOCKET s)
+{
+    size_t count = 0;
+#ifdef __linux__
+    struct mmsghdr msgs[MAX_RECEIVE_BATCH];
+    struct iovec iovs[MAX_RECEIVE_BATCH];
+    for(size_t i = 0; i < _receive_batch; ++i)
+    {
+        StreamBuffer& buf = _batch_buffers[i];
+        if(!buf.Writable(RECEIVE_BUFFER_SIZE))
+        {
+            return;
+        }
+        iovs[i].iov_base = buf.Write();
+        iovs[i].iov_len = buf.Writable();
+        memset(&msgs[i], 0, sizeof(struct mmsghdr));
+        msgs[i].msg_hdr.msg_name = _batch_addrs[i].Reset().Addr();
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int ret;
+    while((ret = ::recvmmsg(s, msgs, _receive_batch, MSG_DONTWAIT, nullptr)) == SOCKET_ERROR)
+    {
+        if(!SocketError::Interrupted())
+        {
+            RecordReceived(-1);
+            return; // nothing to read, or error is reported by next reading
+        }
+    }
+    size_t bytes = 0;
+    for(int i = 0; i < ret; ++i)
+    {
+        _batch_buffers[i].Write(msgs[i].msg_len);
+        bytes += msgs[i].msg_len;
+    }
+    RecordReceived(bytes);
+    count = ret;
+#else
+    while(count < _receive_batch)
+    {
+        StreamBuffer& buf = _batch_buffers[count];
+        SocketAddress& addr = _batch_addrs[count];
+        socklen_t addrlen = sizeof(struct sockaddr_storage);
+        if(!buf.Writable(RECEIVE_BUFFER_SIZE))
+        {
+            break;
+        }
+        ssize_t n = ::recvfrom(s, buf.Write(), buf.Writable(), MSG_DONTWAIT, addr.Reset().Addr(), &addrlen);
+        RecordReceived(n);
+        if(n == SOCKET_ERROR && SocketError::Interrupted())
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            break;
+        }
+        buf.Write(n);
+        ++count;
+    }
+#endif
+    for(size_t i = 0; i < count && GetSocket() == s; ++i)
+    {
+        if(_received_callback)
+        {
+            RecordLatency();
+            _received_callback(this, &_batch_buffers[i], &_batch_addrs[i]);
+        }
+    }
+}
+
 // EventHandler::EventCallback
 // Write is ready
 void AsyncUdpSocket::OnWrite(SOCKET s)
@@ -252,6 +348,7 @@ void AsyncUdpSocket::OnWrite(SOCKET s)
             ret = Socket::Send(ba.buf->Read(), ba.buf->Readable());
         else
             ret = Socket::SendTo(ba.buf->Read(), ba.buf->Readable(), ba.addr);
+        RecordSent(ret, ba.buf->Readable());
         if(ret <= 0) // Suppose either 0 or all data is sent
         {
             break;
@@ -266,4 +363,38 @@ void AsyncUdpSocket::OnWrite(SOCKET s)
     }
 }
 
+void AsyncUdpSocket::EnableStats(Histogram* latency)
+{
+    if(!_stats) _stats.reset(new SocketStats(latency));
+}
+
+// Stats of the socket and the loop are both optional
+void AsyncUdpSocket::RecordReceived(ssize_t n) noexcept
+{
+    if(_stats) _stats->OnReceived(n);
+    SocketStats* totals = _loop->SocketTotals();
+    if(totals) totals->OnReceived(n);
+}
+
+void AsyncUdpSocket::RecordSent(ssize_t n, size_t requested) noexcept
+{
+    if(_stats) _stats->OnSent(n, requested);
+    SocketStats* totals = _loop->SocketTotals();
+    if(totals) totals->OnSent(n, requested);
+}
+
+// Latency is the time the loop has been busy since waking up, which is
+// known only if stats of the loop are enabled
+void AsyncUdpSocket::RecordLatency() noexcept
+{
+    const EventLoopStats* stats = _loop->Stats();
+    if(stats)
+    {
+        int64_t us = stats->Busy();
+        SocketStats* totals = _loop->SocketTotals();
+        if(totals) totals->OnLatency(us);
+        if(_stats) _stats->OnLatency(us);
+    }
+}
+
 NETB_END 
@@ -21,7 +21,9 @@
 #include "UdpSocket.hpp"
 #include "EventLoop.hpp"
 #include "EventHandler.hpp"
+#include "SocketStats.hpp"
 #include <queue>
+#include <vector>
 
 NETB_BEGIN
 
@@ -81,6 +83,21 @@ public:
     typedef std::function<void (AsyncUdpSocket*, StreamBuffer*, const SocketAddress*)> ReceivedCallback;
     void SetReceivedCallback(const ReceivedCallback& cb) noexcept { _received_callback = cb; };
 
+    // Receive up to given number of datagrams on each read event, with a 
+    // single system call where recvmmsg is available. Each datagram is 
+    // notified in its own buffer. Set before opening, 1 by default.
+    static const size_t MAX_RECEIVE_BATCH = 64;
+    void SetReceiveBatch(size_t n) noexcept;
+
+    // Per-socket I/O stats, off by default. I/O is also counted in the
+    // stats of the loop if enabled. Latency of received callback is 
+    // recorded to given histogram, which may be shared. It is timed from
+    // the loop waking up, so only recorded if stats of the loop are
+    // enabled too.
+    // Must called in loop thread or before opening
+    void EnableStats(Histogram* latency = nullptr);
+    const SocketStats* Stats() const noexcept { return _stats.get(); }
+
 public:
     // In async mode, send data with timeout is not necessary, data may be buffered for sending
     // to given address
@@ -151,6 +168,11 @@ private:
     // for a single single message
     StreamBuffer _in_buffer;
 
+    // Receiving buffers for batched messages
+    size_t _receive_batch;
+    std::vector<StreamBuffer> _batch_buffers;
+    std::vector<SocketAddress> _batch_addrs;
+
     // Sending buffer
     // message and peer address
     struct BufferAddress
@@ -165,6 +187,12 @@ private:
     std::queue<BufferAddress> _out_buffers;
     std::mutex _out_buffers_mutex;
 
+    // Optional stats, only updated in loop thread
+    std::unique_ptr<SocketStats> _stats;
+    void RecordReceived(ssize_t n) noexcept;
+    void RecordSent(ssize_t n, size_t requested) noexcept;
+    void RecordLatency() noexcept;
+
     // Enable reading and writing
     bool InitHandler(Error* e = nullptr);
     bool EnableReading(Error* e = nullptr);
@@ -173,6 +201,7 @@ private:
     // EventHandler::EventCallback;
     // On I/O ready events
     void OnRead(const SOCKET s);
+    void OnReadBatch(const SOCKET s);
     void OnWrite(const SOCKET s);
 };
 
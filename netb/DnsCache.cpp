@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DnsCache.hpp"
+#include "TimingWheel.hpp"
+#include <algorithm>
+#include <functional>
+#include <cassert>
+
+NETB_BEGIN
+
+DnsCache::DnsCache(size_t capacity, size_t shards) noexcept
+: _max_ttl(DEFAULT_MAX_TTL)
+, _max_negative_ttl(DEFAULT_MAX_NEGATIVE_TTL)
+, _shard_capacity((capacity + shards - 1) / shards)
+{
+    assert(shards > 0);
+    for(size_t i = 0; i < shards; ++i)
+    {
+        _shards.push_back(new Shard());
+    }
+}
+
+DnsCache::~DnsCache() noexcept
+{
+    for(auto it = _shards.begin(); it != _shards.end(); ++it)
+    {
+        delete *it;
+    }
+}
+
+// Names are compared in case-insensitive manner
+// Lowercased wire format is followed by the type, no formatting at all
+std::string DnsCache::Key(const dns::DomainName& name, unsigned short type)
+{
+    std::string key = name.Wire();
+    std::transform(key.begin(), key.end(), key.begin(), [](char c) { return (char)::tolower((unsigned char)c); });
+    key += (char)(type >> 8);
+    key += (char)(type & 0xff);
+    return key;
+}
+
+DnsCache::Shard* DnsCache::GetShard(const std::string& key) const noexcept
+{
+    return _shards[std::hash<std::string>()(key) % _shards.size()];
+}
+
+// Positive TTL is the smallest one of answers
+// Negative TTL is the smaller one of SOA TTL and MINIMUM (RFC 2308)
+uint32_t DnsCache::Ttl(const dns::Response& response) const noexcept
+{
+    const dns::Header& header = response.GetHeader();
+    if(header.Truncated())
+    {
+        return 0;
+    }
+    const std::vector<dns::ResourceRecord*>& answers = response.Answers();
+    unsigned char rcode = header.ResponseCode();
+    if(rcode == (unsigned char)dns::Header::RCODE::NO_ERROR && !answers.empty())
+    {
+        uint32_t ttl = _max_ttl;
+        for(auto it = answers.begin(); it != answers.end(); ++it)
+        {
+            ttl = std::min(ttl, (*it)->TTL());
+        }
+        return ttl;
+    }
+    if(rcode == (unsigned char)dns::Header::RCODE::NO_ERROR ||
+       rcode == (unsigned char)dns::Header::RCODE::NAME_ERROR)
+    {
+        const std::vector<dns::ResourceRecord*>& authorities = response.Authorities();
+        for(auto it = authorities.begin(); it != authorities.end(); ++it)
+        {
+            dns::ResourceRecord* rr = *it;
+            if(rr->Type() == (unsigned short)dns::RECORD_TYPE::SOA && rr->Data())
+            {
+                const dns::SOARecordData* soa = static_cast<const dns::SOARecordData*>(rr->Data());
+                return std::min(std::min(rr->TTL(), soa->Minimum()), _max_negative_ttl);
+            }
+        }
+    }
+    return 0; // failures and negative ones without SOA
+}
+
+// Replace existing entry, evict least recently used one if full
+bool DnsCache::Put(const dns::Response& response, const void* p, size_t n) noexcept
+{
+    if(response.Questions().size() != 1)
+    {
+        return false;
+    }
+    uint32_t ttl = Ttl(response);
+    if(ttl == 0)
+    {
+        return false;
+    }
+    const dns::Question* q = response.Questions()[0];
+    std::string key = Key(q->Name(), q->Type());
+    int64_t now = TimingWheel::Now();
+    Shard* shard = GetShard(key);
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    auto it = shard->index.find(key);
+    if(it != shard->index.end())
+    {
+        shard->entries.erase(it->second);
+        shard->index.erase(it);
+    }
+    while(!shard->entries.empty() && shard->entries.size() >= _shard_capacity)
+    {
+        shard->index.erase(shard->entries.back().key);
+        shard->entries.pop_back();
+    }
+    Entry entry;
+    entry.key = key;
+    entry.packet.assign((const char*)p, n);
+    entry.stored = now;
+    entry.expires = now + (int64_t)ttl * 1000;
+    entry.hits = 0;
+    entry.prefetching = false;
+    shard->entries.push_front(entry);
+    shard->index[key] = shard->entries.begin();
+    return true;
+}
+
+// Expired entry is removed on lookup
+bool DnsCache::Get(const dns::DomainName& name, unsigned short type,
+                   std::string* packet, uint32_t* age, bool* prefetch) noexcept
+{
+    assert(packet);
+    std::string key = Key(name, type);
+    int64_t now = TimingWheel::Now();
+    Shard* shard = GetShard(key);
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    auto it = shard->index.find(key);
+    if(it == shard->index.end())
+    {
+        return false;
+    }
+    auto entry = it->second;
+    if(entry->expires <= now)
+    {
+        shard->entries.erase(entry);
+        shard->index.erase(it);
+        return false;
+    }
+    shard->entries.splice(shard->entries.begin(), shard->entries, entry);
+    ++entry->hits;
+    *packet = entry->packet;
+    if(age)
+    {
+        *age = (uint32_t)((now - entry->stored) / 1000);
+    }
+    if(prefetch)
+    {
+        int64_t ttl = entry->expires - entry->stored;
+        *prefetch = !entry->prefetching && entry->hits >= PREFETCH_HITS &&
+                    (entry->expires - now) * 100 <= ttl * PREFETCH_PERCENT;
+        if(*prefetch)
+        {
+            entry->prefetching = true; // only once, reset by new response
+        }
+    }
+    return true;
+}
+
+size_t DnsCache::Size() const noexcept
+{
+    size_t n = 0;
+    for(auto it = _shards.begin(); it != _shards.end(); ++it)
+    {
+        std::unique_lock<std::mutex> lock((*it)->mutex);
+        n += (*it)->entries.size();
+    }
+    return n;
+}
+
+void DnsCache::Clear() noexcept
+{
+    for(auto it = _shards.begin(); it != _shards.end(); ++it)
+    {
+        std::unique_lock<std::mutex> lock((*it)->mutex);
+        (*it)->entries.clear();
+        (*it)->index.clear();
+    }
+}
+
+NETB_END
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_DNS_CACHE_HPP
+#define NETB_DNS_CACHE_HPP
+
+#include "Config.hpp"
+#include "Uncopyable.hpp"
+#include "DnsMessage.hpp"
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <list>
+
+NETB_BEGIN
+
+//
+// DnsCache keeps DNS responses by question name and type, as long as
+// the smallest TTL of the answers allows.
+//
+// Negative responses, name error (NXDOMAIN) and no data (NODATA), are
+// cached as RFC 2308, with TTL of the SOA record in authority section,
+// limited by its MINIMUM field. Those without SOA are not cached.
+//
+// Responses are kept in wire format and decoded on hit, the caller
+// adjusts TTLs with the age of the entry. A popular entry close to its
+// expiry is reported once for prefetching, so that it can be refreshed
+// before any lookup misses it.
+//
+// The cache is thread safe and may be shared by resolvers of multiple
+// event loops. Entries are spread in shards with their own locks and
+// LRU lists, so lookups of different names rarely contend.
+//
+class DnsCache : private Uncopyable
+{
+public:
+    // Maximum number of entries and number of shards
+    static const size_t DEFAULT_CAPACITY = 10000;
+    static const size_t DEFAULT_SHARDS = 16;
+
+    // Upper limits of TTL in seconds
+    static const uint32_t DEFAULT_MAX_TTL = 86400;
+    static const uint32_t DEFAULT_MAX_NEGATIVE_TTL = 900;
+
+    // Prefetch in last percentage of TTL, after given hits
+    static const int PREFETCH_PERCENT = 10;
+    static const int PREFETCH_HITS = 3;
+
+    explicit DnsCache(size_t capacity = DEFAULT_CAPACITY, size_t shards = DEFAULT_SHARDS) noexcept;
+    ~DnsCache() noexcept;
+
+    // Setup before use
+    void SetMaxTtl(uint32_t ttl) noexcept { _max_ttl = ttl; }
+    void SetMaxNegativeTtl(uint32_t ttl) noexcept { _max_negative_ttl = ttl; }
+
+    // Keep a response with its wire format data
+    // Return false if the response is not cacheable
+    bool Put(const dns::Response& response, const void* p, size_t n) noexcept;
+
+    // Look up a response in wire format, with its age in seconds
+    // prefetch is set if the caller should refresh it in background
+    bool Get(const dns::DomainName& name, unsigned short type,
+             std::string* packet, uint32_t* age, bool* prefetch = nullptr) noexcept;
+
+    // Number of entries, including expired ones not removed yet
+    size_t Size() const noexcept;
+
+    // Remove all entries
+    void Clear() noexcept;
+
+    // Key of a question
+    static std::string Key(const dns::DomainName& name, unsigned short type);
+
+private:
+    uint32_t _max_ttl;
+    uint32_t _max_negative_ttl;
+
+    // Cached response
+    struct Entry
+    {
+        std::string key;
+        std::string packet;
+        int64_t stored;   // milliseconds
+        int64_t expires;  // milliseconds
+        int hits;
+        bool prefetching;
+    };
+
+    // Most recently used at front
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+    std::vector<Shard*> _shards;
+    size_t _shard_capacity;
+
+    Shard* GetShard(const std::string& key) const noexcept;
+
+    // TTL of response, 0 if not cacheable
+    uint32_t Ttl(const dns::Response& response) const noexcept;
+};
+
+NETB_END
+
+#endif
@@ -83,30 +83,33 @@ std::string Message::String() const
 }
 
 // Pack to buffer 
-// Note: this implementation did not compress the domain name. 
+// Note: repeated names and suffixes are written as pointers (4.1.4), with
+// offset relative to the begining of the message, so the message should be 
+// packed into a buffer without other readable data before it. 
 bool Message::ToBuffer(StreamBuffer* buf) 
 {
     StreamWriter writer(buf);
+    NameTable names(buf);
     if(!_header.Serialize(writer)) return false;
     for(auto it = _questions.begin(); it != _questions.end(); ++it)
     {
         Question* p = *it;
-        if(!p->Serialize(writer)) return false;
+        if(!p->Serialize(writer, &names)) return false;
     }
     for(auto it = _answers.begin(); it != _answers.end(); ++it)
     {
         ResourceRecord* p = *it;
-        if(!p->Serialize(writer)) return false;
+        if(!p->Serialize(writer, &names)) return false;
     }
     for(auto it = _authorities.begin(); it != _authorities.end(); ++it)
     {
         ResourceRecord* p = *it;
-        if(!p->Serialize(writer)) return false;
+        if(!p->Serialize(writer, &names)) return false;
     }
     for(auto it = _additionals.begin(); it != _additionals.end(); ++it)
     {
         ResourceRecord* p = *it;
-        if(!p->Serialize(writer)) return false;
+        if(!p->Serialize(writer, &names)) return false;
     }
     return true;
 }
@@ -121,31 +124,59 @@ bool Message::FromBuffer(StreamBuffer* buf)
     for(int i = 0; i < _header.QuestionCount(); i++)
     {
         Question* p = new (std::nothrow) Question();
-        if(!p || !p->Serialize(reader)) return false;
-        _questions.push_back(p);
+        if(!p) return false;
+        _questions.push_back(p); // owned even if failed
+        if(!p->Serialize(reader)) return false;
     }
     for(int i = 0; i < _header.AnswerCount(); i++)
     {
         ResourceRecord* p = new (std::nothrow) ResourceRecord();
-        if(!p || !p->Serialize(reader)) return false;
+        if(!p) return false;
         _answers.push_back(p);
+        if(!p->Serialize(reader)) return false;
     }
     for(int i = 0; i < _header.AuthorityCount(); i++)
     {
         ResourceRecord* p = new (std::nothrow) ResourceRecord();
-        if(!p || !p->Serialize(reader)) return false;
+        if(!p) return false;
         _authorities.push_back(p);
+        if(!p->Serialize(reader)) return false;
     }
     for(int i = 0; i < _header.AdditionalCount(); i++)
     {
         ResourceRecord* p = new (std::nothrow) ResourceRecord();
-        if(!p || !p->Serialize(reader)) return false;
+        if(!p) return false;
         _additionals.push_back(p);
+        if(!p->Serialize(reader)) return false;
     }
     buf->Flush();
     return true;
 }
 
+// Only one OPT is allowed
+const ResourceRecord* Message::OPT() const
+{
+    for(auto it = _additionals.begin(); it != _additionals.end(); ++it)
+    {
+        if((*it)->Type() == (unsigned short)RECORD_TYPE::OPT)
+        {
+            return *it;
+        }
+    }
+    return nullptr;
+}
+
+// Values less than 512 are treated as 512
+unsigned short Message::PayloadSize() const
+{
+    const ResourceRecord* opt = OPT();
+    if(!opt || opt->Class() < UDP_PAYLOAD_SIZE)
+    {
+        return UDP_PAYLOAD_SIZE;
+    }
+    return opt->Class();
+}
+
 ////////////////////////////////////////////////////////////////////////////
 
 Query::Query()
@@ -162,11 +193,41 @@ Query::Query(const std::string& name, unsigned short qtype)
     _header.QuestionCount(_questions.size());
 }
 
+Query::Query(const DomainName& name, unsigned short qtype)
+{
+    _header.Question(true);
+    Question* q = new (std::nothrow) Question(name, qtype);
+    assert(q != NULL);
+    if(q) _questions.push_back(q);
+    _header.QuestionCount(_questions.size());
+}
+
 Query::~Query()
 {
 
 }
 
+// Owner is root, CLASS is the payload size, and TTL holds the flags
+// Version 0 and no extended RCODE in queries
+bool Query::EDNS(unsigned short payload, bool dnssec)
+{
+    if(OPT())
+    {
+        return false;
+    }
+    OPTRecordData* data = new (std::nothrow) OPTRecordData();
+    if(!data) return false;
+    ResourceRecord* rr = new (std::nothrow) ResourceRecord(DomainName(), payload, dnssec ? 0x8000 : 0, data);
+    if(!rr)
+    {
+        delete data;
+        return false;
+    }
+    _additionals.push_back(rr);
+    _header.AdditionalCount(_additionals.size());
+    return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 Response::Response()
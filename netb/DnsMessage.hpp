@@ -143,6 +143,13 @@ public:
     bool Question() const { return _flags.qr == 0; }
     void Question(bool q);
 
+    // Identifier to match up replies to outstanding queries
+    unsigned short Id() const { return _id; }
+    void Id(unsigned short id) { _id = id; }
+
+    // Message was truncated
+    bool Truncated() const { return _flags.tc == 1; }
+
     // Response Code
     enum class RCODE 
     {
@@ -346,6 +353,11 @@ public:
     Question(const DomainName& name, unsigned short qtype, unsigned short qclass = (unsigned short)QCLASS::IN);
     ~Question();
     
+    // Fields
+    const DomainName& Name() const { return _name; }
+    unsigned short Type() const { return _type; }
+    unsigned short Class() const { return _class; }
+
     // To string
     std::string String() const;
     
@@ -358,6 +370,13 @@ public:
                stream.Integer(_class);
     }
 
+    // Packing with name compression
+    bool Serialize(const StreamWriter& writer, NameTable* names)
+    {
+        return _name.Serialize(writer, 0, names) && 
+               writer.Integer(_type) &&
+               writer.Integer(_class);
+    }
     
 private:
     DomainName _name;
@@ -395,11 +414,28 @@ public:
     // String format of the message 
     std::string String() const;
 
-    // Pack to buffer 
+    // Pack to buffer, domain names are compressed
     bool ToBuffer(StreamBuffer* buf);
 
     // Unpack from buffer
     bool FromBuffer(StreamBuffer* buf);
+
+    // Sections
+    Header& GetHeader() { return _header; }
+    const Header& GetHeader() const { return _header; }
+    const std::vector<Question*>& Questions() const { return _questions; }
+    const std::vector<ResourceRecord*>& Answers() const { return _answers; }
+    const std::vector<ResourceRecord*>& Authorities() const { return _authorities; }
+    const std::vector<ResourceRecord*>& Additionals() const { return _additionals; }
+
+    // Max UDP payload without EDNS(0)
+    static const unsigned short UDP_PAYLOAD_SIZE = 512;
+
+    // EDNS(0) OPT pseudo-record in additional section, null if none
+    const ResourceRecord* OPT() const;
+
+    // UDP payload size advertised by the sender (RFC 6891 6.2.3)
+    unsigned short PayloadSize() const;
     
 protected:
     // Header Section
@@ -425,8 +461,13 @@ class Query : public Message
 public:
     Query();
     Query(const std::string& name, unsigned short qtype); 
+    Query(const DomainName& name, unsigned short qtype); 
     virtual ~Query();
 
+    // Advertise UDP payload size with an OPT record (RFC 6891)
+    // DNSSEC OK (DO) bit is set if required
+    bool EDNS(unsigned short payload, bool dnssec = false);
+
 };
 
 // DNS Response Message 
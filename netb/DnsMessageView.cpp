@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DnsMessageView.hpp"
+#include "DnsRdataCodec.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+#include <cctype>
+#include <cassert>
+
+NETB_BEGIN
+
+namespace dns {
+
+// Header is 12 bytes, fixed fields of question and RR are 4 and 10 bytes
+static const size_t HEADER_SIZE = 12;
+static const size_t QUESTION_SIZE = 4;
+static const size_t RECORD_SIZE = 10;
+
+// Names are limited to 255 octets in wire format (2.3.4)
+static const size_t MAX_WIRE_NAME = 255;
+
+// TTL of OPT pseudo-record holds flags (RFC 6891)
+static const uint16_t TYPE_OPT = 41;
+
+MessageView::MessageView() noexcept
+: _data(nullptr)
+, _size(0)
+, _qdcount(0)
+, _ancount(0)
+, _nscount(0)
+, _arcount(0)
+{
+
+}
+
+MessageView::~MessageView() noexcept
+{
+
+}
+
+uint16_t MessageView::Get16(size_t offset) const noexcept
+{
+    uint16_t v;
+    memcpy(&v, _data + offset, sizeof(v));
+    return ntohs(v);
+}
+
+uint32_t MessageView::Get32(size_t offset) const noexcept
+{
+    uint32_t v;
+    memcpy(&v, _data + offset, sizeof(v));
+    return ntohl(v);
+}
+
+void MessageView::Set16(size_t offset, uint16_t v) noexcept
+{
+    v = htons(v);
+    memcpy(_data + offset, &v, sizeof(v));
+}
+
+void MessageView::Set32(size_t offset, uint32_t v) noexcept
+{
+    v = htonl(v);
+    memcpy(_data + offset, &v, sizeof(v));
+}
+
+// Only the bounds are checked here, pointers are followed on decoding
+size_t MessageView::SkipName(size_t offset) const noexcept
+{
+    size_t start = offset;
+    while(offset < _size && offset - start < MAX_WIRE_NAME)
+    {
+        uint8_t len = _data[offset];
+        if(len == 0)
+        {
+            return offset + 1;
+        }
+        if((len & 0xc0) == 0xc0)
+        {
+            return offset + 2 <= _size ? offset + 2 : 0;
+        }
+        if(len & 0xc0)
+        {
+            return 0; // reserved label types
+        }
+        offset += 1 + len;
+    }
+    return 0;
+}
+
+bool MessageView::Parse(void* p, size_t n) noexcept
+{
+    return Parse(p, n, true);
+}
+
+bool MessageView::ParseQuestions(void* p, size_t n) noexcept
+{
+    return Parse(p, n, false);
+}
+
+// Offsets of records are 16 bits, as those in compression pointers
+bool MessageView::Parse(void* p, size_t n, bool records) noexcept
+{
+    _data = (uint8_t*)p;
+    _size = 0;
+    _qdcount = _ancount = _nscount = _arcount = 0;
+    if(p == nullptr || n < HEADER_SIZE || n > 65535)
+    {
+        return false;
+    }
+    _size = n;
+    size_t qdcount = Get16(4);
+    size_t ancount = records ? Get16(6) : 0;
+    size_t nscount = records ? Get16(8) : 0;
+    size_t arcount = records ? Get16(10) : 0;
+    if(qdcount > MAX_QUESTIONS || ancount + nscount + arcount > MAX_RECORDS)
+    {
+        _size = 0;
+        return false;
+    }
+    size_t offset = HEADER_SIZE;
+    for(size_t i = 0; i < qdcount; ++i)
+    {
+        struct Question& q = _questions[i];
+        q.name = (uint16_t)offset;
+        offset = SkipName(offset);
+        if(offset == 0 || offset + QUESTION_SIZE > _size)
+        {
+            _size = 0;
+            return false;
+        }
+        q.type = Get16(offset);
+        q.klass = Get16(offset + 2);
+        offset += QUESTION_SIZE;
+    }
+    for(size_t i = 0; i < ancount + nscount + arcount; ++i)
+    {
+        Record& r = _records[i];
+        r.name = (uint16_t)offset;
+        offset = SkipName(offset);
+        if(offset == 0 || offset + RECORD_SIZE > _size)
+        {
+            _size = 0;
+            return false;
+        }
+        r.type = Get16(offset);
+        r.klass = Get16(offset + 2);
+        r.ttl = Get32(offset + 4);
+        r.rdlen = Get16(offset + 8);
+        r.rdata = (uint16_t)(offset + RECORD_SIZE);
+        offset += RECORD_SIZE + r.rdlen;
+        const RdataCodec* codec = RdataCodec::Find(r.type);
+        if(offset > _size || (codec && !codec->Check(_data, _size, r.rdata, r.rdlen)))
+        {
+            _size = 0;
+            return false;
+        }
+    }
+    _qdcount = qdcount;
+    _ancount = ancount;
+    _nscount = nscount;
+    _arcount = arcount;
+    return true;
+}
+
+uint16_t MessageView::Id() const noexcept
+{
+    assert(_size > 0);
+    return Get16(0);
+}
+
+bool MessageView::Question() const noexcept
+{
+    assert(_size > 0);
+    return (_data[2] & 0x80) == 0;
+}
+
+bool MessageView::Truncated() const noexcept
+{
+    assert(_size > 0);
+    return (_data[2] & 0x02) != 0;
+}
+
+unsigned char MessageView::ResponseCode() const noexcept
+{
+    assert(_size > 0);
+    return _data[3] & 0x0f;
+}
+
+const struct MessageView::Question& MessageView::GetQuestion(size_t i) const noexcept
+{
+    assert(i < _qdcount);
+    return _questions[i];
+}
+
+const MessageView::Record& MessageView::GetRecord(size_t i) const noexcept
+{
+    assert(i < RecordCount());
+    return _records[i];
+}
+
+// Pointers must point backward, so they never loop
+size_t MessageView::Label(size_t offset, int* hops) const noexcept
+{
+    while(offset < _size)
+    {
+        uint8_t len = _data[offset];
+        if((len & 0xc0) == 0)
+        {
+            return offset + 1 + len <= _size ? offset : 0;
+        }
+        if((len & 0xc0) != 0xc0 || offset + 2 > _size || ++*hops > 127)
+        {
+            return 0;
+        }
+        size_t target = Get16(offset) & 0x3fff;
+        if(target >= offset)
+        {
+            return 0;
+        }
+        offset = target;
+    }
+    return 0;
+}
+
+// Root is ".", others are labels with a trailing "."
+ssize_t MessageView::Name(size_t offset, char* p, size_t n) const noexcept
+{
+    assert(p && n > 0);
+    size_t len = 0;
+    size_t wire = 0;
+    int hops = 0;
+    while(true)
+    {
+        offset = Label(offset, &hops);
+        if(offset == 0)
+        {
+            return -1;
+        }
+        uint8_t label = _data[offset];
+        wire += 1 + label;
+        if(wire > MAX_WIRE_NAME)
+        {
+            return -1;
+        }
+        if(label == 0)
+        {
+            break;
+        }
+        if(len + label + 1 >= n)
+        {
+            return -1;
+        }
+        memcpy(p + len, _data + offset + 1, label);
+        len += label;
+        p[len++] = '.';
+        offset += 1 + label;
+    }
+    if(len == 0)
+    {
+        if(n < 2) return -1;
+        p[len++] = '.';
+    }
+    p[len] = '\0';
+    return len;
+}
+
+std::string MessageView::Name(size_t offset) const
+{
+    char name[MAX_NAME_LENGTH];
+    ssize_t len = Name(offset, name, sizeof(name));
+    return len < 0 ? std::string() : std::string(name, len);
+}
+
+// The dotted name may or may not have the trailing "."
+bool MessageView::NameEquals(size_t offset, const char* name) const noexcept
+{
+    assert(name);
+    if(strcmp(name, ".") == 0)
+    {
+        ++name;
+    }
+    size_t wire = 0;
+    int hops = 0;
+    while(true)
+    {
+        offset = Label(offset, &hops);
+        if(offset == 0)
+        {
+            return false;
+        }
+        uint8_t label = _data[offset];
+        wire += 1 + label;
+        if(wire > MAX_WIRE_NAME)
+        {
+            return false;
+        }
+        if(label == 0)
+        {
+            return *name == '\0';
+        }
+        for(size_t i = 0; i < label; ++i, ++name)
+        {
+            if(*name == '\0' || ::tolower((unsigned char)*name) != ::tolower(_data[offset + 1 + i]))
+            {
+                return false;
+            }
+        }
+        if(*name == '.')
+        {
+            ++name;
+        }
+        else if(*name != '\0')
+        {
+            return false;
+        }
+        offset += 1 + label;
+    }
+}
+
+// Labels are compared one by one after following pointers
+bool MessageView::NameEquals(size_t offset, const void* wire, size_t n) const noexcept
+{
+    assert(wire);
+    const uint8_t* p = (const uint8_t*)wire;
+    size_t pos = 0;
+    int hops = 0;
+    while(pos < n)
+    {
+        offset = Label(offset, &hops);
+        if(offset == 0)
+        {
+            return false;
+        }
+        uint8_t label = _data[offset];
+        if(label != p[pos] || pos + 1 + label > n)
+        {
+            return false;
+        }
+        if(label == 0)
+        {
+            return pos + 1 == n;
+        }
+        for(size_t i = 1; i <= label; ++i)
+        {
+            if(::tolower(_data[offset + i]) != ::tolower(p[pos + i]))
+            {
+                return false;
+            }
+        }
+        pos += 1 + label;
+        offset += 1 + label;
+    }
+    return false;
+}
+
+void MessageView::Id(uint16_t id) noexcept
+{
+    assert(_size > 0);
+    Set16(0, id);
+}
+
+// TTL is right before RDLENGTH
+void MessageView::TTL(size_t i, uint32_t ttl) noexcept
+{
+    assert(i < RecordCount());
+    _records[i].ttl = ttl;
+    Set32(_records[i].rdata - 6, ttl);
+}
+
+void MessageView::AgeTTLs(uint32_t seconds) noexcept
+{
+    for(size_t i = 0; i < RecordCount(); ++i)
+    {
+        if(_records[i].type == TYPE_OPT)
+        {
+            continue;
+        }
+        uint32_t ttl = _records[i].ttl;
+        TTL(i, ttl > seconds ? ttl - seconds : 0);
+    }
+}
+
+} // namespace dns
+
+NETB_END
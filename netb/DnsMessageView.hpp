@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_DNS_MESSAGE_VIEW_HPP
+#define NETB_DNS_MESSAGE_VIEW_HPP
+
+#include "Config.hpp"
+#include "Uncopyable.hpp"
+#include <string>
+
+NETB_BEGIN
+
+namespace dns {
+
+//
+// MessageView parses a DNS message in place, without copying or
+// allocating anything. It keeps the offsets of questions and resource
+// records in fixed arrays, and names are only decoded when they are
+// asked for, by following compression pointers in the packet. RDATA of
+// known types is checked with the codec of the type.
+//
+// The packet is not owned and must outlive the view. Fixed size fields,
+// e.g. ID and TTL, may be rewritten in place, so that a proxy may
+// forward the packet after inspecting it.
+//
+// Messages with more entries than the capacity are rejected, unless
+// only questions are parsed.
+//
+class MessageView : private Uncopyable
+{
+public:
+    // Capacity of entries
+    static const size_t MAX_QUESTIONS = 4;
+    static const size_t MAX_RECORDS = 64;
+
+    // Max length of a name in dotted format, with terminating '\0'
+    static const size_t MAX_NAME_LENGTH = 256;
+
+    // Question entry, name is the offset in packet
+    struct Question
+    {
+        uint16_t name;
+        uint16_t type;
+        uint16_t klass;
+    };
+
+    // Resource record entry, name and rdata are offsets in packet
+    struct Record
+    {
+        uint16_t name;
+        uint16_t type;
+        uint16_t klass;
+        uint32_t ttl;
+        uint16_t rdata;
+        uint16_t rdlen;
+    };
+
+    MessageView() noexcept;
+    ~MessageView() noexcept;
+
+    // Parse a message in the given memory
+    // Return false if the message is malformed or too large
+    bool Parse(void* p, size_t n) noexcept;
+
+    // Parse header and questions only, records are not indexed and
+    // counted, so that a message of any size may be matched up
+    bool ParseQuestions(void* p, size_t n) noexcept;
+
+    // Packet
+    const void* Data() const noexcept { return _data; }
+    size_t Size() const noexcept { return _size; }
+
+    // Header fields
+    uint16_t Id() const noexcept;
+    bool Question() const noexcept; // Is the message a query
+    bool Truncated() const noexcept;
+    unsigned char ResponseCode() const noexcept;
+
+    // Entries of sections
+    size_t QuestionCount() const noexcept { return _qdcount; }
+    size_t AnswerCount() const noexcept { return _ancount; }
+    size_t AuthorityCount() const noexcept { return _nscount; }
+    size_t AdditionalCount() const noexcept { return _arcount; }
+
+    // Records of all sections are in order, answers first
+    size_t RecordCount() const noexcept { return _ancount + _nscount + _arcount; }
+
+    const struct Question& GetQuestion(size_t i) const noexcept;
+    const Record& GetRecord(size_t i) const noexcept;
+
+    // Decode name at offset into given memory in dotted format
+    // Return the length of the name, or -1 if malformed or too long
+    ssize_t Name(size_t offset, char* p, size_t n) const noexcept;
+
+    // Decode name at offset, empty if malformed
+    std::string Name(size_t offset) const;
+
+    // Compare name at offset with a dotted name in case-insensitive manner
+    bool NameEquals(size_t offset, const char* name) const noexcept;
+
+    // Compare name at offset with a name in wire format, e.g. DomainName::Wire()
+    bool NameEquals(size_t offset, const void* wire, size_t n) const noexcept;
+
+    // Rewrite in place
+    void Id(uint16_t id) noexcept;
+    void TTL(size_t i, uint32_t ttl) noexcept;
+
+    // Reduce TTLs of all records by given seconds, not below 0
+    // OPT pseudo-record is left alone
+    void AgeTTLs(uint32_t seconds) noexcept;
+
+private:
+    uint8_t* _data;
+    size_t _size;
+    size_t _qdcount;
+    size_t _ancount;
+    size_t _nscount;
+    size_t _arcount;
+    struct Question _questions[MAX_QUESTIONS];
+    Record _records[MAX_RECORDS];
+
+    // Parse questions, and records if required
+    bool Parse(void* p, size_t n, bool records) noexcept;
+
+    // Skip a name at offset, return offset after it or 0 if malformed
+    size_t SkipName(size_t offset) const noexcept;
+
+    // Label at offset after following pointers
+    // Return offset of the length octet, or 0 if malformed
+    size_t Label(size_t offset, int* hops) const noexcept;
+
+    uint16_t Get16(size_t offset) const noexcept;
+    uint32_t Get32(size_t offset) const noexcept;
+    void Set16(size_t offset, uint16_t v) noexcept;
+    void Set32(size_t offset, uint32_t v) noexcept;
+};
+
+} // namespace dns
+
+NETB_END
+
+#endif
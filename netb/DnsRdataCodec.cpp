@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DnsRdataCodec.hpp"
+#include "DnsRecord.hpp"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+NETB_BEGIN
+
+namespace dns {
+
+// Names are limited to 255 octets in wire format (2.3.4)
+static const size_t MAX_WIRE_NAME = 255;
+
+template <class T>
+static RecordData* Create()
+{
+    return new (std::nothrow) T();
+}
+
+#define FIELD(kind) { RDATA_FIELD::kind, 0 }
+#define BYTES(n) { RDATA_FIELD::BYTES, n }
+
+static const RdataField A_FIELDS[] = { BYTES(4) };
+static const RdataField NAME_FIELDS[] = { FIELD(NAME) };
+static const RdataField NAME2_FIELDS[] = { FIELD(NAME), FIELD(NAME) };
+static const RdataField SOA_FIELDS[] = { FIELD(NAME), FIELD(NAME), FIELD(U32), FIELD(U32),
+                                         FIELD(U32), FIELD(U32), FIELD(U32) };
+static const RdataField HINFO_FIELDS[] = { FIELD(STRING), FIELD(STRING) };
+static const RdataField MX_FIELDS[] = { FIELD(U16), FIELD(NAME) };
+static const RdataField TXT_FIELDS[] = { FIELD(STRINGS) };
+static const RdataField AAAA_FIELDS[] = { BYTES(16) };
+static const RdataField SRV_FIELDS[] = { FIELD(U16), FIELD(U16), FIELD(U16), FIELD(NAME) };
+static const RdataField NAPTR_FIELDS[] = { FIELD(U16), FIELD(U16), FIELD(STRING), FIELD(STRING),
+                                           FIELD(STRING), FIELD(NAME) };
+static const RdataField OPT_FIELDS[] = { BYTES(0) };
+
+#define CODEC(type, compressed, fields, create) \
+    { (uint16_t)RECORD_TYPE::type, #type, compressed, fields, sizeof(fields) / sizeof(fields[0]), create }
+
+// Sorted by type
+// Names may be compressed in types of RFC 1035, and receivers must
+// decompress those of SRV and NAPTR as well (RFC 3597 4). Names are
+// only compressed on packing in types of RFC 1035.
+static const RdataCodec s_codecs[] =
+{
+    CODEC(A,        false,  A_FIELDS,       Create<ARecordData>),
+    CODEC(NS,       true,   NAME_FIELDS,    Create<NSRecordData>),
+    CODEC(MD,       true,   NAME_FIELDS,    nullptr),
+    CODEC(MF,       true,   NAME_FIELDS,    nullptr),
+    CODEC(CNAME,    true,   NAME_FIELDS,    Create<CNAMERecordData>),
+    CODEC(SOA,      true,   SOA_FIELDS,     Create<SOARecordData>),
+    CODEC(MB,       true,   NAME_FIELDS,    nullptr),
+    CODEC(MG,       true,   NAME_FIELDS,    nullptr),
+    CODEC(MR,       true,   NAME_FIELDS,    nullptr),
+    CODEC(PTR,      true,   NAME_FIELDS,    Create<PTRRecordData>),
+    CODEC(HINFO,    false,  HINFO_FIELDS,   nullptr),
+    CODEC(MINFO,    true,   NAME2_FIELDS,   nullptr),
+    CODEC(MX,       true,   MX_FIELDS,      Create<MXRecordData>),
+    CODEC(TXT,      false,  TXT_FIELDS,     Create<TXTRecordData>),
+    CODEC(AAAA,     false,  AAAA_FIELDS,    Create<AAAARecordData>),
+    CODEC(SRV,      true,   SRV_FIELDS,     Create<SRVRecordData>),
+    CODEC(NAPTR,    true,   NAPTR_FIELDS,   nullptr),
+    CODEC(OPT,      false,  OPT_FIELDS,     Create<OPTRecordData>)
+};
+
+const RdataCodec* RdataCodec::Find(uint16_t type) noexcept
+{
+    const RdataCodec* end = s_codecs + sizeof(s_codecs) / sizeof(s_codecs[0]);
+    const RdataCodec* it = std::lower_bound(s_codecs, end, type,
+                           [](const RdataCodec& c, uint16_t t) { return c.type < t; });
+    return it != end && it->type == type ? it : nullptr;
+}
+
+// Return offset after the field, or -1 if it goes beyond end
+static ssize_t SkipField(const RdataField& f, const uint8_t* p, size_t offset, size_t end, bool compressed)
+{
+    switch(f.kind)
+    {
+        case RDATA_FIELD::NAME:
+        {
+            size_t start = offset;
+            while(offset < end && offset - start < MAX_WIRE_NAME)
+            {
+                uint8_t len = p[offset];
+                if(len == 0)
+                {
+                    return offset + 1;
+                }
+                if((len & 0xc0) == 0xc0)
+                {
+                    return compressed && offset + 2 <= end ? offset + 2 : -1;
+                }
+                if(len & 0xc0)
+                {
+                    return -1; // reserved label types
+                }
+                offset += 1 + len;
+            }
+            return -1;
+        }
+        case RDATA_FIELD::U16:
+            return offset + sizeof(uint16_t) <= end ? offset + sizeof(uint16_t) : -1;
+        case RDATA_FIELD::U32:
+            return offset + sizeof(uint32_t) <= end ? offset + sizeof(uint32_t) : -1;
+        case RDATA_FIELD::BYTES:
+            if(f.size == 0) return end;
+            return offset + f.size <= end ? offset + f.size : -1;
+        case RDATA_FIELD::STRING:
+            return offset < end && offset + 1 + p[offset] <= end ? offset + 1 + p[offset] : -1;
+        case RDATA_FIELD::STRINGS:
+            while(offset < end)
+            {
+                if(offset + 1 + p[offset] > end) return -1;
+                offset += 1 + p[offset];
+            }
+            return offset;
+    }
+    return -1;
+}
+
+bool RdataCodec::Check(const uint8_t* msg, size_t size, size_t offset, size_t rdlen) const noexcept
+{
+    size_t end = offset + rdlen;
+    if(end > size)
+    {
+        return false;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+        ssize_t next = SkipField(fields[i], msg, offset, end, compressed);
+        if(next < 0)
+        {
+            return false;
+        }
+        offset = next;
+    }
+    return offset == end;
+}
+
+std::string RdataCodec::String(const uint8_t* rdata, size_t rdlen) const
+{
+    std::ostringstream oss;
+    size_t offset = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        ssize_t next = SkipField(fields[i], rdata, offset, rdlen, false);
+        if(next < 0)
+        {
+            return std::string();
+        }
+        if(i > 0) oss << ";";
+        switch(fields[i].kind)
+        {
+            case RDATA_FIELD::NAME:
+                for(size_t pos = offset; rdata[pos] > 0; pos += 1 + rdata[pos])
+                {
+                    oss.write((const char*)rdata + pos + 1, rdata[pos]) << ".";
+                }
+                if(rdata[offset] == 0) oss << ".";
+                break;
+            case RDATA_FIELD::U16:
+                oss << (((unsigned int)rdata[offset] << 8) | rdata[offset + 1]);
+                break;
+            case RDATA_FIELD::U32:
+                oss << (((uint32_t)rdata[offset] << 24) | ((uint32_t)rdata[offset + 1] << 16) |
+                        ((uint32_t)rdata[offset + 2] << 8) | rdata[offset + 3]);
+                break;
+            case RDATA_FIELD::BYTES:
+                oss << std::hex << std::setfill('0');
+                for(size_t pos = offset; pos < (size_t)next; ++pos)
+                {
+                    oss << std::setw(2) << (unsigned int)rdata[pos];
+                }
+                oss << std::dec;
+                break;
+            case RDATA_FIELD::STRING:
+            case RDATA_FIELD::STRINGS:
+                for(size_t pos = offset; pos < (size_t)next; pos += 1 + rdata[pos])
+                {
+                    if(pos > offset) oss << ";";
+                    oss.write((const char*)rdata + pos + 1, rdata[pos]);
+                }
+                break;
+        }
+        offset = next;
+    }
+    return offset == rdlen ? oss.str() : std::string();
+}
+
+} // namespace dns
+
+NETB_END
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_DNS_RDATA_CODEC_HPP
+#define NETB_DNS_RDATA_CODEC_HPP
+
+#include "Config.hpp"
+#include <string>
+
+NETB_BEGIN
+
+namespace dns {
+
+class RecordData;
+
+// Fields of RDATA in wire format
+enum class RDATA_FIELD : uint8_t
+{
+    NAME,       // <domain-name>
+    U16,        // 16 bits integer
+    U32,        // 32 bits integer
+    BYTES,      // octets of fixed size, or the rest of RDATA if size is 0
+    STRING,     // <character-string>, a length octet followed by octets
+    STRINGS     // <character-string>s to the end of RDATA
+};
+
+struct RdataField
+{
+    RDATA_FIELD kind;
+    uint16_t size; // of BYTES
+};
+
+//
+// RdataCodec describes RDATA of a type with a list of fields, so that
+// RDATA may be checked and printed by walking the fields, and types
+// without a class of their own are still decoded. Codecs are kept in a
+// table sorted by type, and built at compile time.
+//
+// Types with a class, e.g. SOA, are created by the factory of their
+// codec. Others are kept as generic RDATA in wire format, with names
+// decompressed if they may be compressed, so RDATA is still valid when
+// packed in another message (RFC 3597 4).
+//
+struct RdataCodec
+{
+    uint16_t type;
+    const char* name; // mnemonic, e.g. "SOA"
+    bool compressed; // names may be compressed in received messages
+    const RdataField* fields;
+    size_t count;
+    RecordData* (*create)(); // null for generic RDATA
+
+    // Codec of given type, null if not known
+    static const RdataCodec* Find(uint16_t type) noexcept;
+
+    // Check RDATA at offset of a message, fields must fill it up exactly
+    // Pointers in names are checked for bounds only, and are rejected if
+    // names of the type are not compressed
+    bool Check(const uint8_t* msg, size_t size, size_t offset, size_t rdlen) const noexcept;
+
+    // RDATA with no compressed names in presentation format, fields are
+    // separated by ";", empty if malformed
+    std::string String(const uint8_t* rdata, size_t rdlen) const;
+};
+
+} // namespace dns
+
+NETB_END
+
+#endif
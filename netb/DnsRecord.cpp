@@ -21,6 +21,8 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <algorithm>
+#include <iomanip>
 
 NETB_BEGIN
 
@@ -36,6 +38,17 @@ ResourceRecord::ResourceRecord()
     
 }
 
+ResourceRecord::ResourceRecord(const DomainName& name, unsigned short klass, uint32_t ttl, RecordData* rdata)
+: _name(name)
+, _type(rdata ? rdata->Type() : 0)
+, _class(klass)
+, _ttl(ttl)
+, _rdlen(0)
+, _rdata(rdata)
+{
+
+}
+
 ResourceRecord::~ResourceRecord()
 {
     if(_rdata)
@@ -70,18 +83,20 @@ bool ResourceRecord::Serialize(const StreamReader& reader)
     return _rdata->Serialize(reader, _rdlen);        
 }
 
-bool ResourceRecord::Serialize(const StreamWriter& writer)
+bool ResourceRecord::Serialize(const StreamWriter& writer, NameTable* names)
 {
     if(!_rdata) return false;
-    bool ret = _name.Serialize(writer) && 
+    bool ret = _name.Serialize(writer, 0, names) && 
                writer.Integer(_type) &&
                writer.Integer(_class) &&
                writer.Integer(_ttl);
     if(!ret) return false;
 
-    size_t offset = 0;
-    if(!writer.Integer(_rdlen, &offset)) return false; 
-    if(!_rdata->Serialize(writer, _rdlen)) return false;
+    // RDLENGTH is updated after RDATA, at offset relative to readable data
+    size_t offset = writer.Buffer()->Peekable();
+    _rdlen = 0;
+    if(!writer.Integer(_rdlen)) return false; 
+    if(!_rdata->Serialize(writer, _rdlen, names)) return false;
     if(!RandomWriter(writer.Buffer()).Integer(offset, _rdlen)) return false;
     return true;    
 }
@@ -90,115 +105,266 @@ bool ResourceRecord::Serialize(const StreamWriter& writer)
 
 const char* DomainName::s_valid_chars = "0123456789abcdefghijklmnopqrstuvwxyz-_/.";
 
+// Names are limited to 255 octets in wire format (2.3.4)
+static const size_t MAX_WIRE_NAME = 255;
+
+
+// FNV-1a of lowercased bytes
+// Length octets are never letters, so the whole wire format is folded
+static size_t FoldedHash(const std::string& wire)
+{
+    size_t h = 2166136261u;
+    for(size_t i = 0; i < wire.length(); ++i)
+    {
+        h = (h ^ (unsigned char)::tolower((unsigned char)wire[i])) * 16777619u;
+    }
+    return h;
+}
+
+// Upper case ASCII letters of 8 bytes are folded at once
+// A byte is a letter if its low 7 bits are in 'A'..'Z' and high bit is 0
+static inline uint64_t Lower8(uint64_t x)
+{
+    uint64_t heptets = x & 0x7f7f7f7f7f7f7f7full;
+    uint64_t above_a = heptets + 0x3f3f3f3f3f3f3f3full; // >= 'A'
+    uint64_t above_z = heptets + 0x2525252525252525ull; // > 'Z'
+    uint64_t upper = (above_a ^ above_z) & ~x & 0x8080808080808080ull;
+    return x | (upper >> 2);
+}
+
+static bool CaseEqual(const char* a, const char* b, size_t n)
+{
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t))
+    {
+        uint64_t x;
+        uint64_t y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        if(x != y && Lower8(x) != Lower8(y))
+        {
+            return false;
+        }
+    }
+    for(; i < n; ++i)
+    {
+        if(::tolower((unsigned char)a[i]) != ::tolower((unsigned char)b[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 DomainName::DomainName()
+: _name(Root())
 {
 
 }
 
 DomainName::DomainName(const std::string& s)
+: _name(Root())
 {
     FromString(s);
 }
 
-// from string
+// Shared by all root names, created on first use
+const std::shared_ptr<const DomainName::Data>& DomainName::Root()
+{
+    static const std::shared_ptr<const Data> root = std::make_shared<const Data>(Data{ std::string(1, '\0'), FoldedHash(std::string(1, '\0')) });
+    return root;
+}
+
+void DomainName::Assign(const std::string& wire)
+{
+    std::shared_ptr<Data> data = std::make_shared<Data>();
+    data->wire = wire;
+    data->hash = FoldedHash(wire);
+    _name = data;
+}
+
+// from string, in lower case
+// Labels are 1 to 63 chars, the trailing dot is optional
 bool DomainName::FromString(const std::string& s)
 {
     std::string name(s);
-    // up to 256 character length
-    if(name.length() > 256) return false;
-    // to lower case 
-    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-    if(name.find_first_not_of(s_valid_chars, 0) != std::string::npos) return false;
-    // Add terminate dot
+    std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)::tolower((unsigned char)c); });
+    if(name.empty() || name.find_first_not_of(s_valid_chars, 0) != std::string::npos) return false;
+    if(name == ".")
+    {
+        _name = Root();
+        return true;
+    }
     if(name[name.length() - 1] != '.') 
     {
         name += '.';
     }
-    // Divided by dot        
+    std::string wire;
     size_t opos = 0;
     size_t pos;
     while((pos = name.find_first_of(".", opos)) != std::string::npos)
     {
-        std::string part;
-        part.append(name, opos, pos - opos);
-        _parts.push_back(part);
+        size_t len = pos - opos;
+        if(len == 0 || len > 63) return false;
+        wire += (char)len;
+        wire.append(name, opos, len);
         opos = pos + 1;
     }
+    wire += '\0';
+    if(wire.length() > MAX_WIRE_NAME) return false;
+    Assign(wire);
     return true;
 }
 
-// String format
+// String format, root is "."
 std::string DomainName::String() const
 {
-    std::ostringstream oss;
-    for(auto it = _parts.begin(); it != _parts.end(); ++it)
+    const std::string& wire = _name->wire;
+    if(wire.length() <= 1) return ".";
+    std::string s;
+    for(size_t i = 0; i < wire.length() && wire[i] != 0; i += 1 + (unsigned char)wire[i])
     {
-        oss << *it << ".";
+        s.append(wire, i + 1, (unsigned char)wire[i]);
+        s += '.';
     }
-    return oss.str();
+    return s;
+}
+
+// Hash is compared first, most different names stop there
+bool DomainName::operator==(const DomainName& other) const
+{
+    if(_name == other._name)
+    {
+        return true;
+    }
+    const std::string& a = _name->wire;
+    const std::string& b = other._name->wire;
+    return _name->hash == other._name->hash && a.length() == b.length() &&
+           CaseEqual(a.data(), b.data(), a.length());
 }
 
 // packing
-bool DomainName::Serialize(const StreamWriter& writer, unsigned short* wlen)
+// With a name table, the longest suffix written before is replaced by
+// a pointer, and new suffixes are kept for later names. Labels before
+// the pointer are written at once.
+bool DomainName::Serialize(const StreamWriter& writer, unsigned short* wlen, NameTable* names)
 {
-    for(auto it = _parts.begin(); it != _parts.end(); ++it)
+    const std::string& wire = _name->wire;
+    if(!names)
     {
-        std::string& s = *it;
-        if(!s.empty() && s != ".")
-        {
-            if(!writer.Integer((uint8_t)s.length()) || 
-               !writer.String(s))
-            {
-                return false;
-            }
-            if(wlen) *wlen += 1 + s.length();
-        }
+        if(!writer.Bytes(wire.data(), wire.length())) return false;
+        if(wlen) *wlen += wire.length();
+        return true;
+    }
+    std::string folded(wire);
+    std::transform(folded.begin(), folded.end(), folded.begin(), [](char c) { return (char)::tolower((unsigned char)c); });
+    size_t len = 0; // labels written as they are
+    uint16_t pointer = 0;
+    while(wire[len] != 0)
+    {
+        std::string suffix = folded.substr(len);
+        pointer = names->Find(suffix);
+        if(pointer > 0) break;
+        names->Add(suffix, len);
+        len += 1 + (unsigned char)wire[len];
+    }
+    if(!writer.Bytes(wire.data(), len)) return false;
+    if(pointer > 0)
+    {
+        if(!writer.Integer((uint16_t)(0xc000 | pointer))) return false;
+        if(wlen) *wlen += len + sizeof(uint16_t);
+        return true;
     }
     if(!writer.Integer((uint8_t)0)) return false;
-    if(wlen) *wlen += 1;
+    if(wlen) *wlen += len + 1;
     return true;
 }
 
 // unpacking
+// Pointers may be chained, but each must point strictly backward, and
+// hops are bounded too, so a crafted message is never looped
 bool DomainName::Serialize(const StreamReader& reader, unsigned short* rlen)
 {
+    std::string wire;
     uint8_t len;
     std::string s;
     while(true)
     {
         if(!reader.Integer(len)) return false;
         if(rlen) *rlen += 1;
-        if(len == 0) return true; // termintate with 0 length
+        if(len == 0) break; // termintate with 0 length
         if(len > 63) break; // pointer
         if(!reader.String(s, (size_t)len)) return false;
         if(rlen) *rlen += len;
-        _parts.push_back(s);
+        wire += (char)len;
+        wire += s;
+        if(wire.length() >= MAX_WIRE_NAME) return false;
     }
-    assert(len > 63);
     if(len > 63) // pointer, only one is possible
     {
+        if((len & 0xc0) != 0xc0) return false;
         uint8_t off;
         if(!reader.Integer(off)) return false;
         if(rlen) *rlen += 1;
-        size_t offset = (len & 63 << 8) + off;
+        size_t offset = ((len & 0x3f) << 8) + off;
+        const StreamBuffer* buf = reader.Buffer();
+        if(offset + 2 >= (size_t)buf->Peekable() - buf->Readable()) return false; // behind the pointer
         RandomReader rr(reader.Buffer());
+        int hops = 0;
         while(true)
         {
             if(!rr.Integer(offset, len)) return false;
             offset += 1;
             if(len == 0) break;
-            assert(len <= 63);
-            if(len > 63) return false;
+            if(len > 63) // pointer again
+            {
+                if((len & 0xc0) != 0xc0 || ++hops > 127) return false;
+                if(!rr.Integer(offset, off)) return false;
+                size_t target = ((len & 0x3f) << 8) + off;
+                if(target >= offset - 1) return false;
+                offset = target;
+                continue;
+            }
             if(!rr.String(offset, s, (size_t)len)) return false;
             offset += len;
-            _parts.push_back(s);
+            wire += (char)len;
+            wire += s;
+            if(wire.length() >= MAX_WIRE_NAME) return false;
         }
     }
+    wire += '\0';
+    Assign(wire);
     return true;
 }
 
 //////////////////////////////////////////////////////////////////////////
 
+NameTable::NameTable(const StreamBuffer* buf)
+: _buf(buf)
+, _start(buf->Peekable())
+{
+
+}
+
+uint16_t NameTable::Find(const std::string& suffix) const
+{
+    auto it = _offsets.find(suffix);
+    return it == _offsets.end() ? 0 : it->second;
+}
+
+// Pointer has 14 bits for offset, names beyond that are not kept
+// Offset 0 is the header, so never a name
+void NameTable::Add(const std::string& suffix, size_t distance)
+{
+    size_t offset = _buf->Peekable() - _start + distance;
+    if(offset > 0 && offset < 0x4000)
+    {
+        _offsets.insert(std::make_pair(suffix, (uint16_t)offset));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 RecordData::~RecordData()
 {
 
@@ -222,25 +388,25 @@ enum class RECORD_TYPE
     HINFO           =13, //host information
     MINFO           =14, //mailbox or mail list information
     MX              =15, //mail exchange
-    TXT             =16 //text strings
+    TXT             =16, //text strings
+    AAAA            =28, //IPv6 address
+    SRV             =33, //location of services
+    NAPTR           =35, //naming authority pointer
+    OPT             =41 //EDNS(0) pseudo-record
 };
 */
 
 // Create RecordData object by RECORD_TYPE 
+// RDATA of types without a class is kept as it is, so they do not fail a message
 // Return NULL on failure 
 RecordData* RecordData::Create(unsigned short type)
 {
-    RecordData* p = 0;
-    switch(type)
+    const RdataCodec* codec = RdataCodec::Find(type);
+    if(codec && codec->create)
     {
-        case (unsigned short)RECORD_TYPE::A: p = new (std::nothrow) ARecordData(); break;
-        case (unsigned short)RECORD_TYPE::CNAME: p = new (std::nothrow) CNAMERecordData(); break;
-        case (unsigned short)RECORD_TYPE::SOA: p = new (std::nothrow) SOARecordData(); break;
-        case (unsigned short)RECORD_TYPE::MX: p = new (std::nothrow) MXRecordData(); break;
-        case (unsigned short)RECORD_TYPE::TXT: p = new (std::nothrow) TXTRecordData(); break;
-        default: break;
+        return codec->create();
     }
-    return p;
+    return new (std::nothrow) GenericRecordData(type);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -254,7 +420,7 @@ ARecordData::~ARecordData()
 std::string ARecordData::String() const 
 {
     struct in_addr ia;
-    ia.s_addr = _ip;
+    ia.s_addr = htonl(_ip); // stored in host order
     std::string s("A:");
     s += inet_ntoa(ia);
     s += "\r\n";
@@ -268,7 +434,7 @@ bool ARecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
     return reader.Integer(_ip);
 }
 
-bool ARecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen)
+bool ARecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
 {
     rdlen = sizeof(uint32_t);
     return writer.Integer(_ip);
@@ -293,20 +459,30 @@ std::string CNAMERecordData::String() const
 // Serialization to and from buffer
 bool CNAMERecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
 {
-    unsigned short len;
+    unsigned short len = 0;
     if(!_name.Serialize(reader, &len)) return false;
     if(len != rdlen) return false;
     return true;
 }
 
-bool CNAMERecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen)
+bool CNAMERecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
 {
-    if(!_name.Serialize(writer, &rdlen)) return false;
+    if(!_name.Serialize(writer, &rdlen, names)) return false;
     return true;
 }
 
 //////////////////////////////////////////////////////////////////////////
 
+SOARecordData::SOARecordData()
+: _serial(0)
+, _refresh(0)
+, _retry(0)
+, _expire(0)
+, _minimum(0)
+{
+
+}
+
 SOARecordData::~SOARecordData()
 {
 
@@ -314,17 +490,29 @@ SOARecordData::~SOARecordData()
 
 std::string SOARecordData::String() const 
 {
-    return "SOA, not implemented.\n";
+    std::ostringstream oss;
+    oss << "SOA:" << _mname.String() << ";" << _rname.String() << ";" << _serial << ";" 
+        << _refresh << ";" << _retry << ";" << _expire << ";" << _minimum << "\r\n";
+    return oss.str();
 }
 
 // Serialization to and from buffer
 bool SOARecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
 {
+    unsigned short len = 0;
+    if(!_mname.Serialize(reader, &len) || !_rname.Serialize(reader, &len)) return false;
+    if(!reader.Integer(_serial) || !reader.Integer(_refresh) || !reader.Integer(_retry) ||
+       !reader.Integer(_expire) || !reader.Integer(_minimum)) return false;
+    if(rdlen != len + 5 * sizeof(uint32_t)) return false;
     return true;
 }
 
-bool SOARecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen)
+bool SOARecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
 {
+    if(!_mname.Serialize(writer, &rdlen, names) || !_rname.Serialize(writer, &rdlen, names)) return false;
+    if(!writer.Integer(_serial) || !writer.Integer(_refresh) || !writer.Integer(_retry) ||
+       !writer.Integer(_expire) || !writer.Integer(_minimum)) return false;
+    rdlen += 5 * sizeof(uint32_t);
     return true;
 }
 
@@ -353,12 +541,12 @@ bool MXRecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
 
 }
 
-bool MXRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen)
+bool MXRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
 {
     if(!writer.Integer(_preference)) return false;
     rdlen += sizeof(uint16_t);
     unsigned short len = 0;
-    if(!_exchange.Serialize(writer, &len)) return false;
+    if(!_exchange.Serialize(writer, &len, names)) return false;
     rdlen += len;
     return true;
 }
@@ -379,25 +567,316 @@ std::string TXTRecordData::String() const
 }
 
 // Serialization to and from buffer
+// Strings are joined, e.g. long SPF records (RFC 7208 3.3)
+// Empty RDATA is taken as empty text, as the codec checks it
 bool TXTRecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
 {
-    uint8_t len;
-    if(!reader.Integer(len)) return false;
-    if(len != rdlen - 1) return false;
-    if(!reader.String(_text, (size_t)len)) return false;
+    _text.clear();
+    size_t n = 0;
+    while(n < rdlen)
+    {
+        uint8_t len;
+        std::string s;
+        if(!reader.Integer(len)) return false;
+        n += 1 + len;
+        if(n > rdlen || !reader.String(s, (size_t)len)) return false;
+        _text += s;
+    }
+    return true;
+}
+
+// Text is split into strings of at most 255 bytes, at least one string
+bool TXTRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
+{
+    size_t pos = 0;
+    do
+    {
+        size_t len = std::min(_text.length() - pos, (size_t)255);
+        if(rdlen + 1 + len > 0xffff) return false;
+        if(!writer.Integer((uint8_t)len)) return false;
+        rdlen += sizeof(uint8_t);
+        if(!writer.Bytes(_text.data() + pos, len)) return false;
+        rdlen += len;
+        pos += len;
+    } while(pos < _text.length());
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+NSRecordData::~NSRecordData()
+{
+    
+}
+
+std::string NSRecordData::String() const
+{
+    std::string s("NS:");
+    s += _name.String();
+    s += "\r\n";
+    return s;
+}
+
+// Serialization to and from buffer
+bool NSRecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
+{
+    unsigned short len = 0;
+    if(!_name.Serialize(reader, &len)) return false;
+    if(len != rdlen) return false;
     return true;
 }
 
-bool TXTRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen)
+bool NSRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
 {
-    assert(_text.length() <= 256);
-    if(!writer.Integer((uint8_t)_text.length())) return false;
-    rdlen += sizeof(uint8_t);
-    if(!writer.String(_text)) return false;
-    rdlen += _text.length();
+    if(!_name.Serialize(writer, &rdlen, names)) return false;
     return true;
 }
 
+/////////////////////////////////////////////////////////////////////////////////
+
+PTRRecordData::~PTRRecordData()
+{
+    
+}
+
+std::string PTRRecordData::String() const
+{
+    std::string s("PTR:");
+    s += _name.String();
+    s += "\r\n";
+    return s;
+}
+
+// Serialization to and from buffer
+bool PTRRecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
+{
+    unsigned short len = 0;
+    if(!_name.Serialize(reader, &len)) return false;
+    if(len != rdlen) return false;
+    return true;
+}
+
+bool PTRRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
+{
+    if(!_name.Serialize(writer, &rdlen, names)) return false;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+AAAARecordData::~AAAARecordData()
+{
+    
+}
+
+std::string AAAARecordData::String() const 
+{
+    char ip[INET6_ADDRSTRLEN];
+    if(!inet_ntop(AF_INET6, _ip, ip, sizeof(ip))) return "";
+    std::string s("AAAA:");
+    s += ip;
+    s += "\r\n";
+    return s;
+}
+
+// Stored in network byte order
+bool AAAARecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
+{
+    if(rdlen != sizeof(_ip)) return false;
+    return reader.Bytes(_ip, sizeof(_ip));
+}
+
+bool AAAARecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
+{
+    rdlen = sizeof(_ip);
+    return writer.Bytes(_ip, sizeof(_ip));
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+SRVRecordData::SRVRecordData()
+: _priority(0)
+, _weight(0)
+, _port(0)
+{
+
+}
+
+SRVRecordData::~SRVRecordData()
+{
+
+}
+
+std::string SRVRecordData::String() const
+{
+    std::ostringstream oss;
+    oss << "SRV:" << _priority << ";" << _weight << ";" << _port << ";" << _target.String() << "\r\n";
+    return oss.str();
+}
+
+// Serialization to and from buffer
+bool SRVRecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
+{
+    if(!reader.Integer(_priority) || !reader.Integer(_weight) || !reader.Integer(_port)) return false;
+    unsigned short len = 0;
+    if(!_target.Serialize(reader, &len)) return false;
+    if(rdlen != 3 * sizeof(uint16_t) + len) return false;
+    return true;
+}
+
+// Target is never compressed (RFC 2782)
+bool SRVRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
+{
+    if(!writer.Integer(_priority) || !writer.Integer(_weight) || !writer.Integer(_port)) return false;
+    rdlen += 3 * sizeof(uint16_t);
+    unsigned short len = 0;
+    if(!_target.Serialize(writer, &len)) return false;
+    rdlen += len;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+OPTRecordData::~OPTRecordData()
+{
+
+}
+
+std::string OPTRecordData::String() const
+{
+    std::ostringstream oss;
+    oss << "OPT:";
+    for(auto it = _options.begin(); it != _options.end(); ++it)
+    {
+        oss << it->first << "(" << it->second.length() << ");";
+    }
+    oss << "\r\n";
+    return oss.str();
+}
+
+// Options must fill up RDATA exactly
+bool OPTRecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
+{
+    size_t len = 0;
+    while(len < rdlen)
+    {
+        uint16_t code;
+        uint16_t n;
+        std::string data;
+        if(!reader.Integer(code) || !reader.Integer(n)) return false;
+        len += 2 * sizeof(uint16_t) + n;
+        if(len > rdlen || !reader.String(data, (size_t)n)) return false;
+        _options.push_back(Option(code, data));
+    }
+    return true;
+}
+
+bool OPTRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
+{
+    for(auto it = _options.begin(); it != _options.end(); ++it)
+    {
+        if(it->second.length() > 65535) return false;
+        if(!writer.Integer(it->first) || 
+           !writer.Integer((uint16_t)it->second.length()) ||
+           !writer.String(it->second)) return false;
+        rdlen += 2 * sizeof(uint16_t) + it->second.length();
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+GenericRecordData::GenericRecordData(unsigned short type)
+: _type(type)
+, _codec(RdataCodec::Find(type))
+{
+
+}
+
+GenericRecordData::~GenericRecordData()
+{
+
+}
+
+std::string GenericRecordData::String() const
+{
+    std::ostringstream oss;
+    if(_codec)
+    {
+        oss << _codec->name << ":" << _codec->String((const uint8_t*)_data.data(), _data.length()) << "\r\n";
+        return oss.str();
+    }
+    oss << "TYPE" << _type << ":\\# " << _data.length() << " " << std::hex << std::setfill('0');
+    for(size_t i = 0; i < _data.length(); ++i)
+    {
+        oss << std::setw(2) << (unsigned int)(unsigned char)_data[i];
+    }
+    oss << "\r\n";
+    return oss.str();
+}
+
+// Names in RDATA of known types are decompressed field by field, so
+// RDATA is kept without pointers to the message
+bool GenericRecordData::Serialize(const StreamReader& reader, unsigned short rdlen)
+{
+    if(!_codec || !_codec->compressed)
+    {
+        if(!reader.String(_data, (size_t)rdlen)) return false;
+        return !_codec || _codec->Check((const uint8_t*)_data.data(), _data.length(), 0, _data.length());
+    }
+    _data.clear();
+    size_t consumed = 0;
+    for(size_t i = 0; i < _codec->count && consumed <= rdlen; ++i)
+    {
+        const RdataField& f = _codec->fields[i];
+        size_t n = 0;
+        switch(f.kind)
+        {
+            case RDATA_FIELD::NAME:
+            {
+                DomainName name;
+                unsigned short len = 0;
+                if(!name.Serialize(reader, &len)) return false;
+                _data += name.Wire();
+                consumed += len;
+                continue;
+            }
+            case RDATA_FIELD::U16:
+                n = sizeof(uint16_t);
+                break;
+            case RDATA_FIELD::U32:
+                n = sizeof(uint32_t);
+                break;
+            case RDATA_FIELD::BYTES:
+                n = f.size > 0 ? f.size : rdlen - consumed;
+                break;
+            case RDATA_FIELD::STRING:
+            {
+                uint8_t len = 0;
+                if(!reader.Integer(len)) return false;
+                _data += (char)len;
+                consumed += 1;
+                n = len;
+                break;
+            }
+            case RDATA_FIELD::STRINGS:
+                n = rdlen - consumed;
+                break;
+        }
+        std::string bytes;
+        if(consumed + n > rdlen || !reader.String(bytes, n)) return false;
+        _data += bytes;
+        consumed += n;
+    }
+    return consumed == rdlen && _codec->Check((const uint8_t*)_data.data(), _data.length(), 0, _data.length());
+}
+
+bool GenericRecordData::Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names)
+{
+    rdlen += _data.length();
+    return writer.String(_data);
+}
+
 } // namespace dns
 
 NETB_END
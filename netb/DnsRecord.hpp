@@ -23,6 +23,9 @@
 #include "StreamBuffer.hpp"
 #include "StreamWriter.hpp"
 #include "StreamReader.hpp"
+#include "DnsRdataCodec.hpp"
+#include <unordered_map>
+#include <memory>
 
 NETB_BEGIN 
 	
@@ -82,6 +85,17 @@ represented as either:
    - a sequence of labels ending with a pointer
 */
     
+class NameTable;
+
+//
+// DomainName keeps a name in uncompressed wire format, with the hash of
+// its lowercased bytes computed once. The data is immutable and shared
+// by copies, so names are cheap to pass around and to be used as keys.
+// Names are compared in case-insensitive manner, 8 bytes at a time.
+// Writing a name without compression is a single copy.
+//
+// Default name is the root, which has no labels.
+//
 class DomainName 
 {
 public:    
@@ -94,22 +108,76 @@ public:
     // to string
     std::string String() const;
 
+    // No labels
+    bool Empty() const { return _name->wire.length() <= 1; }
+
+    // Wire format, labels and the root
+    const std::string& Wire() const { return _name->wire; }
+
+    // Hash of lowercased wire format
+    size_t Hash() const { return _name->hash; }
+
+    // Compared in case-insensitive manner
+    bool operator==(const DomainName& other) const;
+    bool operator!=(const DomainName& other) const { return !(*this == other); }
+
     // packing
     // return the coded data length
-    bool Serialize(const StreamWriter& writer, unsigned short* wlen = 0);
+    // names are compressed with the table of written names if given
+    bool Serialize(const StreamWriter& writer, unsigned short* wlen = 0, NameTable* names = 0);
 
     // unpacking
     // return the coded data length
     bool Serialize(const StreamReader& reader, unsigned short* dlen = 0);
     
 private:
-    // name parts
-    std::vector<std::string> _parts;  
+    struct Data
+    {
+        std::string wire;
+        size_t hash;
+    };
+    std::shared_ptr<const Data> _name;
+
+    // Replace with given wire format
+    void Assign(const std::string& wire);
+
+    // Data of the root
+    static const std::shared_ptr<const Data>& Root();
 
     // valid chars
     static const char* s_valid_chars;
 };
 
+// Hash of names, e.g. for std::unordered_map
+struct DomainNameHash
+{
+    size_t operator()(const DomainName& name) const { return name.Hash(); }
+};
+
+//
+// Offsets of names that have been written in a message, so that a later
+// name or its suffix is written as a pointer to the prior one (4.1.4).
+// Suffixes are keyed in lowercased wire format, since names are compared
+// in case-insensitive manner.
+//
+class NameTable : private Uncopyable
+{
+public:
+    // Message starts at given position of the buffer
+    NameTable(const StreamBuffer* buf);
+
+    // Offset of a written suffix, 0 if not found
+    uint16_t Find(const std::string& suffix) const;
+
+    // Keep a suffix written at given distance from current position
+    void Add(const std::string& suffix, size_t distance = 0);
+
+private:
+    const StreamBuffer* _buf;
+    size_t _start;
+    std::unordered_map<std::string, uint16_t> _offsets;
+};
+
 /*
 3.2.2. TYPE values
 
@@ -132,6 +200,13 @@ HINFO           13 host information
 MINFO           14 mailbox or mail list information
 MX              15 mail exchange
 TXT             16 text strings
+
+Types defined later:
+
+AAAA            28 IPv6 address (RFC 3596)
+SRV             33 location of services (RFC 2782)
+NAPTR           35 naming authority pointer (RFC 3403)
+OPT             41 EDNS(0) pseudo-record (RFC 6891)
 */
 	
 enum class RECORD_TYPE 
@@ -151,7 +226,11 @@ enum class RECORD_TYPE
     HINFO   =13, //host information
     MINFO   =14, //mailbox or mail list information
     MX      =15, //mail exchange
-    TXT     =16  //text strings
+    TXT     =16, //text strings
+    AAAA    =28, //IPv6 address
+    SRV     =33, //location of services
+    NAPTR   =35, //naming authority pointer
+    OPT     =41  //EDNS(0) pseudo-record
 };
 
 /*
@@ -248,10 +327,11 @@ public:
 
     // Serialization to and from stream
     // rdlen is necessary for some types
+    // Names in RDATA of well-known types may be compressed (RFC 3597)
     virtual bool Serialize(const StreamReader& reader, unsigned short rdlen) = 0;
-    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen) = 0;
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0) = 0;
 
-    // Create object by TYPE
+    // Create object by TYPE with the codec registry
     static RecordData* Create(unsigned short type);
 };
 
@@ -261,16 +341,26 @@ class ResourceRecord : private Uncopyable
 public:
     ResourceRecord();
     ~ResourceRecord();
+
+    // Record to be packed, RDATA is owned by the record
+    ResourceRecord(const DomainName& name, unsigned short klass, uint32_t ttl, RecordData* rdata);
     
     // Type of record
     unsigned short Type() const;
 
+    // Fields
+    const DomainName& Name() const { return _name; }
+    unsigned short Class() const { return _class; }
+    uint32_t TTL() const { return _ttl; }
+    void TTL(uint32_t ttl) { _ttl = ttl; }
+    const RecordData* Data() const { return _rdata; }
+
     // To string
     std::string String() const;
     
     // Serialization
     bool Serialize(const StreamReader& reader);
-    bool Serialize(const StreamWriter& writer);
+    bool Serialize(const StreamWriter& writer, NameTable* names = 0);
                     
 protected:
     DomainName  _name;  // NAME
@@ -310,7 +400,7 @@ public:
 
     // Serialization to and from stream 
     virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
-    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
     
 private:
     // RDATA of A record
@@ -346,7 +436,7 @@ public:
     
     // Serialization to and from buffer
     virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
-    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
 
 private:
     // RDATA is the A name refered by the alias
@@ -412,6 +502,7 @@ All times are in units of seconds.
 class SOARecordData : public RecordData
 {
 public:
+    SOARecordData();
     virtual ~SOARecordData();
 
     // Type
@@ -422,11 +513,20 @@ public:
 
     // Serialization to and from stream 
     virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
-    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
     
+    // Minimum TTL of the zone, also TTL of negative responses
+    uint32_t Minimum() const { return _minimum; }
+
 private:
     // RDATA of SOA record
-
+    DomainName _mname;  // MNAME
+    DomainName _rname;  // RNAME
+    uint32_t _serial;   // SERIAL
+    uint32_t _refresh;  // REFRESH
+    uint32_t _retry;    // RETRY
+    uint32_t _expire;   // EXPIRE
+    uint32_t _minimum;  // MINIMUM
 };
 
 /*
@@ -463,7 +563,7 @@ public:
 
     // Serialization to and from buffer
     virtual bool Serialize(const StreamReader& stream, unsigned short rdlen);
-    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
 
 private:
     // RDATA
@@ -507,13 +607,230 @@ public:
 
     // Serialization to and from buffer
     virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
-    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
 
 private:
-    // TXTs 
+    // TXTs, multiple strings are joined
     std::string _text;
 };
 
+/*
+RFC 1035	Domain Implementation and Specification    November 1987
+3.3.11. NS RDATA format
+
+    +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+    /                   NSDNAME                     /
+    /                                               /
+    +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+
+where:
+
+NSDNAME         A <domain-name> which specifies a host which should be
+                authoritative for the specified class and domain.
+*/
+
+class NSRecordData : public RecordData 
+{
+public:
+    virtual ~NSRecordData();
+
+    // Get Type
+    virtual unsigned short Type() const { return (unsigned short)RECORD_TYPE::NS; }
+    
+    // To String
+    virtual std::string String() const;
+    
+    // Serialization to and from buffer
+    virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
+
+private:
+    // RDATA is the name server
+    DomainName _name; 
+};
+
+/*
+RFC 1035	Domain Implementation and Specification    November 1987
+3.3.12. PTR RDATA format
+
+    +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+    /                   PTRDNAME                    /
+    +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+
+where:
+
+PTRDNAME        A <domain-name> which points to some location in the
+                domain name space.
+*/
+
+class PTRRecordData : public RecordData 
+{
+public:
+    virtual ~PTRRecordData();
+
+    // Get Type
+    virtual unsigned short Type() const { return (unsigned short)RECORD_TYPE::PTR; }
+    
+    // To String
+    virtual std::string String() const;
+    
+    // Serialization to and from buffer
+    virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
+
+private:
+    // RDATA is the name pointed to
+    DomainName _name; 
+};
+
+/*
+RFC 3596	DNS Extensions to Support IPv6          October 2003
+2.2 AAAA data format
+
+A 128 bit IPv6 address is encoded in the data portion of an AAAA
+resource record in network byte order (high-order byte first).
+*/
+
+class AAAARecordData : public RecordData
+{
+public:
+    virtual ~AAAARecordData();
+
+    // Type
+    virtual unsigned short Type() const { return (unsigned short)RECORD_TYPE::AAAA; }
+
+    // To String
+    virtual std::string String() const;
+
+    // Serialization to and from stream 
+    virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
+    
+private:
+    // RDATA of AAAA record
+    // IPv6 address, 16 bytes in network byte order
+    uint8_t _ip[16];
+};
+
+/*
+RFC 2782	DNS RR for specifying the location of services    February 2000
+
+The format of the SRV RR
+
+    _Service._Proto.Name TTL Class SRV Priority Weight Port Target
+
+Priority, Weight and Port are 16 bit unsigned integers in network byte
+order. Target is the domain name of the target host, name compression
+is not to be used for this field.
+*/
+
+class SRVRecordData : public RecordData
+{
+public:
+    SRVRecordData();
+    virtual ~SRVRecordData();
+
+    // Get Type
+    virtual unsigned short Type() const { return (unsigned short)RECORD_TYPE::SRV; }
+
+    // To String 
+    virtual std::string String() const;
+
+    // Serialization to and from buffer
+    virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
+
+    // Fields
+    uint16_t Priority() const { return _priority; }
+    uint16_t Weight() const { return _weight; }
+    uint16_t Port() const { return _port; }
+    const DomainName& Target() const { return _target; }
+
+private:
+    // RDATA
+    uint16_t _priority;
+    uint16_t _weight;
+    uint16_t _port;
+    DomainName _target;
+};
+
+/*
+RFC 6891	Extension Mechanisms for DNS (EDNS(0))    April 2013
+6.1.2. Wire Format
+
+OPT pseudo-RR in additional section, with fixed part:
+
+    NAME         domain name    MUST be 0 (root domain)
+    TYPE         u_int16_t      OPT (41)
+    CLASS        u_int16_t      requestor's UDP payload size
+    TTL          u_int32_t      extended RCODE and flags
+    RDLEN        u_int16_t      length of all RDATA
+    RDATA        octet stream   {attribute,value} pairs
+
+The TTL is:
+
+                +0 (MSB)                            +1 (LSB)
+     +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+  0: |         EXTENDED-RCODE        |            VERSION            |
+     +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+  2: | DO|                           Z                               |
+     +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+
+RDATA is a sequence of options, each with 16 bit OPTION-CODE and
+OPTION-LENGTH followed by OPTION-DATA.
+*/
+
+class OPTRecordData : public RecordData
+{
+public:
+    virtual ~OPTRecordData();
+
+    // Get Type
+    virtual unsigned short Type() const { return (unsigned short)RECORD_TYPE::OPT; }
+
+    // To string
+    virtual std::string String() const;
+
+    // Serialization to and from buffer
+    virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
+
+    // Options, code and data
+    typedef std::pair<uint16_t, std::string> Option;
+    const std::vector<Option>& Options() const { return _options; }
+    void AddOption(uint16_t code, const std::string& data) { _options.push_back(Option(code, data)); }
+
+private:
+    std::vector<Option> _options;
+};
+
+// RDATA of types without a class, kept in wire format (RFC 3597)
+// Known types are checked and printed with their codec
+class GenericRecordData : public RecordData
+{
+public:
+    explicit GenericRecordData(unsigned short type);
+    virtual ~GenericRecordData();
+
+    // Get Type
+    virtual unsigned short Type() const { return _type; }
+
+    // To string, fields of known types, or "\\# length hex" (RFC 3597 5)
+    virtual std::string String() const;
+
+    // Serialization to and from buffer
+    virtual bool Serialize(const StreamReader& reader, unsigned short rdlen);
+    virtual bool Serialize(const StreamWriter& writer, unsigned short& rdlen, NameTable* names = 0);
+
+    // Raw RDATA
+    const std::string& Data() const { return _data; }
+
+private:
+    unsigned short _type;
+    const RdataCodec* _codec; // null if not known
+    std::string _data;
+};
+
 } // namespace dns
 
 NETB_END
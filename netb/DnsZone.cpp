@@ -0,0 +1,494 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DnsZone.hpp"
+#include "DnsMessage.hpp"
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+NETB_BEGIN
+
+// Header is 12 bytes, and the question starts right after it
+static const size_t HEADER_SIZE = 12;
+
+// Pointer to the question name
+static const uint16_t QUESTION_POINTER = 0xc000 | HEADER_SIZE;
+
+// Names are limited to 255 octets in wire format (2.3.4)
+static const size_t MAX_WIRE_NAME = 255;
+
+// OPT pseudo-record with root owner and no options (RFC 6891)
+static const size_t OPT_SIZE = 11;
+
+// Extended RCODE of unsupported EDNS version
+static const uint8_t BADVERS = 16;
+
+static void Append16(std::string* s, uint16_t v)
+{
+    v = htons(v);
+    s->append((const char*)&v, sizeof(v));
+}
+
+static void Append32(std::string* s, uint32_t v)
+{
+    v = htonl(v);
+    s->append((const char*)&v, sizeof(v));
+}
+
+static void Set16(void* p, uint16_t v)
+{
+    v = htons(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static uint16_t Get16(const void* p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohs(v);
+}
+
+DnsZone::DnsZone(const std::string& origin) noexcept
+: _origin(origin)
+, _origin_key(WireName(origin))
+, _has_soa(false)
+{
+    assert(!_origin_key.empty());
+    Insert(_origin_key);
+    BuildNegative(&_nxdomain, (uint8_t)dns::Header::RCODE::NAME_ERROR, 0);
+}
+
+DnsZone::~DnsZone() noexcept
+{
+    for(auto it = _index.begin(); it != _index.end(); ++it)
+    {
+        delete it->second;
+    }
+}
+
+// Names from string are in lower case
+std::string DnsZone::WireName(const std::string& name)
+{
+    dns::DomainName dn;
+    return dn.FromString(name) ? dn.Wire() : std::string();
+}
+
+// FNV-1a
+size_t DnsZone::Hash(const char* p, size_t n) noexcept
+{
+    size_t h = 2166136261u;
+    for(size_t i = 0; i < n; ++i)
+    {
+        h = (h ^ (unsigned char)p[i]) * 16777619u;
+    }
+    return h;
+}
+
+DnsZone::Node* DnsZone::Find(const char* key, size_t n) const noexcept
+{
+    auto range = _index.equal_range(Hash(key, n));
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        const std::string& k = it->second->key;
+        if(k.length() == n && memcmp(k.data(), key, n) == 0)
+        {
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+DnsZone::Node* DnsZone::Insert(const std::string& key)
+{
+    Node* node = Find(key.data(), key.length());
+    if(!node)
+    {
+        node = new Node();
+        node->key = key;
+        node->cname = -1;
+        Build(node);
+        _index.insert(std::make_pair(Hash(key.data(), key.length()), node));
+    }
+    return node;
+}
+
+// Origin must end the name at a label boundary
+ssize_t DnsZone::InZone(const char* key, size_t n) const noexcept
+{
+    size_t offset = 0;
+    while(offset < n)
+    {
+        if(n - offset == _origin_key.length() &&
+           memcmp(key + offset, _origin_key.data(), n - offset) == 0)
+        {
+            return offset;
+        }
+        offset += 1 + (unsigned char)key[offset];
+    }
+    return -1;
+}
+
+// Empty non-terminals between the name and origin are added too,
+// so that they are answered with NODATA rather than NXDOMAIN
+bool DnsZone::Add(const std::string& name, unsigned short type, uint32_t ttl,
+                  const void* rdata, size_t n) noexcept
+{
+    std::string key = WireName(name);
+    if(key.empty() || InZone(key.data(), key.length()) < 0 || n > 65535)
+    {
+        return false;
+    }
+    Record r;
+    r.type = type;
+    r.ttl = ttl;
+    r.rdata.assign((const char*)rdata, n);
+    Node* node = Insert(key);
+    node->records.push_back(r);
+    Build(node);
+    for(size_t offset = 1 + (unsigned char)key[0]; offset < key.length() - _origin_key.length();
+        offset += 1 + (unsigned char)key[offset])
+    {
+        Insert(key.substr(offset));
+    }
+    return true;
+}
+
+bool DnsZone::AddA(const std::string& name, const std::string& ip, uint32_t ttl) noexcept
+{
+    struct in_addr addr;
+    if(inet_pton(AF_INET, ip.c_str(), &addr) != 1)
+    {
+        return false;
+    }
+    return Add(name, (unsigned short)dns::RECORD_TYPE::A, ttl, &addr, sizeof(addr));
+}
+
+bool DnsZone::AddNS(const std::string& name, const std::string& host, uint32_t ttl) noexcept
+{
+    std::string rdata = WireName(host);
+    return !rdata.empty() && Add(name, (unsigned short)dns::RECORD_TYPE::NS, ttl, rdata.data(), rdata.length());
+}
+
+bool DnsZone::AddCNAME(const std::string& name, const std::string& target, uint32_t ttl) noexcept
+{
+    std::string rdata = WireName(target);
+    return !rdata.empty() && Add(name, (unsigned short)dns::RECORD_TYPE::CNAME, ttl, rdata.data(), rdata.length());
+}
+
+bool DnsZone::AddMX(const std::string& name, uint16_t preference, const std::string& exchange, uint32_t ttl) noexcept
+{
+    std::string host = WireName(exchange);
+    if(host.empty())
+    {
+        return false;
+    }
+    std::string rdata;
+    Append16(&rdata, preference);
+    rdata += host;
+    return Add(name, (unsigned short)dns::RECORD_TYPE::MX, ttl, rdata.data(), rdata.length());
+}
+
+// A single character string
+bool DnsZone::AddTXT(const std::string& name, const std::string& text, uint32_t ttl) noexcept
+{
+    if(text.length() > 255)
+    {
+        return false;
+    }
+    std::string rdata(1, (char)text.length());
+    rdata += text;
+    return Add(name, (unsigned short)dns::RECORD_TYPE::TXT, ttl, rdata.data(), rdata.length());
+}
+
+bool DnsZone::AddAAAA(const std::string& name, const std::string& ip, uint32_t ttl) noexcept
+{
+    struct in6_addr addr;
+    if(inet_pton(AF_INET6, ip.c_str(), &addr) != 1)
+    {
+        return false;
+    }
+    return Add(name, (unsigned short)dns::RECORD_TYPE::AAAA, ttl, &addr, sizeof(addr));
+}
+
+// Target is not compressed (RFC 2782)
+bool DnsZone::AddSRV(const std::string& name, uint16_t priority, uint16_t weight, uint16_t port,
+                     const std::string& target, uint32_t ttl) noexcept
+{
+    std::string host = WireName(target);
+    if(host.empty())
+    {
+        return false;
+    }
+    std::string rdata;
+    Append16(&rdata, priority);
+    Append16(&rdata, weight);
+    Append16(&rdata, port);
+    rdata += host;
+    return Add(name, (unsigned short)dns::RECORD_TYPE::SRV, ttl, rdata.data(), rdata.length());
+}
+
+// Negative answers of all names are updated
+bool DnsZone::SetSOA(const std::string& mname, const std::string& rname, uint32_t serial,
+                     uint32_t refresh, uint32_t retry, uint32_t expire, uint32_t minimum,
+                     uint32_t ttl) noexcept
+{
+    std::string m = WireName(mname);
+    std::string r = WireName(rname);
+    if(m.empty() || r.empty())
+    {
+        return false;
+    }
+    std::string rdata = m + r;
+    Append32(&rdata, serial);
+    Append32(&rdata, refresh);
+    Append32(&rdata, retry);
+    Append32(&rdata, expire);
+    Append32(&rdata, minimum);
+    _has_soa = true;
+    _soa.type = (uint16_t)dns::RECORD_TYPE::SOA;
+    _soa.ttl = std::min(ttl, minimum); // TTL of negative answers (RFC 2308)
+    _soa.rdata = rdata;
+    Node* apex = Find(_origin_key.data(), _origin_key.length());
+    assert(apex);
+    auto it = std::remove_if(apex->records.begin(), apex->records.end(),
+                             [](const Record& r) { return r.type == (uint16_t)dns::RECORD_TYPE::SOA; });
+    apex->records.erase(it, apex->records.end());
+    Record soa = _soa;
+    soa.ttl = ttl;
+    apex->records.push_back(soa);
+    for(auto it = _index.begin(); it != _index.end(); ++it)
+    {
+        Build(it->second);
+    }
+    BuildNegative(&_nxdomain, (uint8_t)dns::Header::RCODE::NAME_ERROR, 0);
+    return true;
+}
+
+// SOA owner is the origin, a suffix of the question name at given offset
+// Owner of NXDOMAIN answer is patched for each query
+void DnsZone::BuildNegative(Template* t, uint8_t rcode, size_t owner)
+{
+    t->type = 0;
+    t->rcode = rcode;
+    t->ancount = 0;
+    t->nscount = 0;
+    t->soa = -1;
+    t->data.clear();
+    if(_has_soa)
+    {
+        t->nscount = 1;
+        if(rcode == (uint8_t)dns::Header::RCODE::NAME_ERROR)
+        {
+            t->soa = 0;
+        }
+        Append16(&t->data, (uint16_t)(QUESTION_POINTER + owner));
+        Append16(&t->data, _soa.type);
+        Append16(&t->data, (uint16_t)dns::RECORD_CLASS::IN);
+        Append32(&t->data, _soa.ttl);
+        Append16(&t->data, (uint16_t)_soa.rdata.length());
+        t->data += _soa.rdata;
+    }
+}
+
+// Records of the same type are answered together
+void DnsZone::Build(Node* node)
+{
+    node->answers.clear();
+    node->cname = -1;
+    for(auto it = node->records.begin(); it != node->records.end(); ++it)
+    {
+        auto t = std::find_if(node->answers.begin(), node->answers.end(),
+                              [it](const Template& t) { return t.type == it->type; });
+        if(t == node->answers.end())
+        {
+            Template answer;
+            answer.type = it->type;
+            answer.rcode = (uint8_t)dns::Header::RCODE::NO_ERROR;
+            answer.ancount = 0;
+            answer.nscount = 0;
+            answer.soa = -1;
+            node->answers.push_back(answer);
+            t = node->answers.end() - 1;
+        }
+        t->ancount++;
+        Append16(&t->data, QUESTION_POINTER);
+        Append16(&t->data, it->type);
+        Append16(&t->data, (uint16_t)dns::RECORD_CLASS::IN);
+        Append32(&t->data, it->ttl);
+        Append16(&t->data, (uint16_t)it->rdata.length());
+        t->data += it->rdata;
+        if(it->type == (uint16_t)dns::RECORD_TYPE::CNAME)
+        {
+            node->cname = t - node->answers.begin();
+        }
+    }
+    BuildNegative(&node->nodata, (uint8_t)dns::Header::RCODE::NO_ERROR,
+                  node->key.length() - _origin_key.length());
+}
+
+// OPT record of the response, ARCOUNT is updated too
+// Extended RCODE is the upper 8 bits of 12 bits RCODE
+static size_t AppendOPT(unsigned char* r, size_t len, uint16_t payload, uint8_t rcode)
+{
+    unsigned char* p = r + len;
+    p[0] = 0; // root
+    Set16(p + 1, (uint16_t)dns::RECORD_TYPE::OPT);
+    Set16(p + 3, payload);
+    p[5] = rcode >> 4;
+    memset(p + 6, 0, 5); // version 0, flags and RDLEN
+    Set16(r + 10, 1);
+    return len + OPT_SIZE;
+}
+
+// Only standard queries of class IN with a single question are answered
+// Malformed queries are answered with FORMERR if the header is readable
+// OPT record is only looked for right after the question
+size_t DnsZone::Answer(const void* query, size_t n, void* response, size_t size, bool udp) const noexcept
+{
+    const unsigned char* q = (const unsigned char*)query;
+    unsigned char* r = (unsigned char*)response;
+    if(n < HEADER_SIZE || size < HEADER_SIZE || (q[2] & 0x80))
+    {
+        return 0; // not a query
+    }
+    uint8_t rcode = (uint8_t)dns::Header::RCODE::NO_ERROR;
+    size_t qlen = 0;
+    char key[MAX_WIRE_NAME];
+    size_t keylen = 0;
+    bool edns = false;
+    uint16_t payload = dns::Message::UDP_PAYLOAD_SIZE;
+    if((q[2] & 0x78) != 0)
+    {
+        rcode = (uint8_t)dns::Header::RCODE::NOT_IMPLEMENTED;
+    }
+    else if(Get16(q + 4) != 1)
+    {
+        rcode = (uint8_t)dns::Header::RCODE::FORMAT_ERROR;
+    }
+    else
+    {
+        size_t offset = HEADER_SIZE;
+        while(offset < n && q[offset] != 0 && q[offset] <= 63 &&
+              keylen + 1 + q[offset] < MAX_WIRE_NAME && offset + 1 + q[offset] < n)
+        {
+            size_t len = q[offset];
+            key[keylen++] = (char)len;
+            for(size_t i = 0; i < len; ++i)
+            {
+                key[keylen++] = (char)::tolower(q[offset + 1 + i]);
+            }
+            offset += 1 + len;
+        }
+        if(offset >= n || q[offset] != 0 || offset + 5 > n)
+        {
+            rcode = (uint8_t)dns::Header::RCODE::FORMAT_ERROR;
+        }
+        else
+        {
+            key[keylen++] = 0;
+            qlen = offset + 5 - HEADER_SIZE;
+            if(Get16(q + offset + 3) != (uint16_t)dns::RECORD_CLASS::IN)
+            {
+                rcode = (uint8_t)dns::Header::RCODE::REFUSED;
+            }
+            const unsigned char* opt = q + HEADER_SIZE + qlen;
+            if(Get16(q + 6) == 0 && Get16(q + 8) == 0 && Get16(q + 10) > 0 &&
+               HEADER_SIZE + qlen + OPT_SIZE <= n && opt[0] == 0 && 
+               Get16(opt + 1) == (uint16_t)dns::RECORD_TYPE::OPT)
+            {
+                edns = true;
+                payload = std::max(Get16(opt + 3), payload);
+                if(opt[6] != 0)
+                {
+                    rcode = BADVERS;
+                }
+            }
+        }
+    }
+    // Room for the OPT record is kept
+    size_t limit = udp ? std::min(size, (size_t)payload) : size;
+    if(edns)
+    {
+        limit = limit > OPT_SIZE ? limit - OPT_SIZE : 0;
+    }
+    if(HEADER_SIZE + qlen > limit)
+    {
+        return 0;
+    }
+    uint16_t advertised = (uint16_t)std::min(size, (size_t)65535);
+    // Header and question
+    memcpy(r, q, 2); // ID
+    r[2] = 0x80 | (q[2] & 0x79); // QR, OPCODE, RD
+    r[3] = rcode & 0x0f;
+    Set16(r + 4, qlen > 0 ? 1 : 0);
+    memset(r + 6, 0, 6);
+    memcpy(r + HEADER_SIZE, q + HEADER_SIZE, qlen);
+    size_t len = HEADER_SIZE + qlen;
+    if(rcode != (uint8_t)dns::Header::RCODE::NO_ERROR)
+    {
+        return edns ? AppendOPT(r, len, advertised, rcode) : len;
+    }
+    // Records
+    const Template* t = nullptr;
+    Node* node = Find(key, keylen);
+    ssize_t owner = 0;
+    if(node)
+    {
+        uint16_t qtype = Get16(q + HEADER_SIZE + qlen - 4);
+        for(auto it = node->answers.begin(); it != node->answers.end(); ++it)
+        {
+            if(it->type == qtype)
+            {
+                t = &(*it);
+                break;
+            }
+        }
+        if(!t)
+        {
+            t = node->cname >= 0 ? &node->answers[node->cname] : &node->nodata;
+        }
+    }
+    else if((owner = InZone(key, keylen)) >= 0)
+    {
+        t = &_nxdomain;
+    }
+    else
+    {
+        r[3] = (uint8_t)dns::Header::RCODE::REFUSED;
+        return edns ? AppendOPT(r, len, advertised, 0) : len;
+    }
+    r[2] |= 0x04; // AA
+    r[3] = t->rcode;
+    if(len + t->data.length() > limit)
+    {
+        r[2] |= 0x02; // TC
+        return edns ? AppendOPT(r, len, advertised, 0) : len;
+    }
+    memcpy(r + len, t->data.data(), t->data.length());
+    if(t->soa >= 0)
+    {
+        Set16(r + len + t->soa, (uint16_t)(QUESTION_POINTER + owner));
+    }
+    Set16(r + 6, t->ancount);
+    Set16(r + 8, t->nscount);
+    len += t->data.length();
+    return edns ? AppendOPT(r, len, advertised, 0) : len;
+}
+
+NETB_END
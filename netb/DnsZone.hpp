@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_DNS_ZONE_HPP
+#define NETB_DNS_ZONE_HPP
+
+#include "Config.hpp"
+#include "Uncopyable.hpp"
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+NETB_BEGIN
+
+//
+// DnsZone is an in-memory index of the records of a zone, for answering
+// queries as an authoritative server.
+//
+// Names are indexed by lowercased wire format, and the answer of each
+// name and type is encoded in advance. The owner names of answers are
+// pointers to the question, which always follows the 12 bytes header,
+// so a response is the header, the question copied from the query and
+// the prepared records. Answering a query allocates nothing.
+//
+// Negative answers, NXDOMAIN and NODATA, carry the SOA of the zone in
+// authority section (RFC 2308). A name with CNAME is answered with the
+// CNAME record for other types. Wildcards and delegations are not
+// supported. Names not in the zone are refused.
+//
+// Queries with EDNS(0) are answered with an OPT record, and over UDP
+// the response may be as large as the payload size of the client,
+// otherwise 512 bytes (RFC 6891).
+//
+// The zone is built before serving, and then may be shared by servers
+// in multiple threads, since answering does not change it.
+//
+class DnsZone : private Uncopyable
+{
+public:
+    // Origin of the zone, e.g. "example.com"
+    explicit DnsZone(const std::string& origin) noexcept;
+    ~DnsZone() noexcept;
+
+    // Origin in dotted format
+    const std::string& Origin() const noexcept { return _origin; }
+
+    // SOA of the zone, also added as a record of the origin
+    bool SetSOA(const std::string& mname, const std::string& rname, uint32_t serial,
+                uint32_t refresh, uint32_t retry, uint32_t expire, uint32_t minimum,
+                uint32_t ttl) noexcept;
+
+    // Add a record with RDATA in wire format
+    // Return false if the name is not in the zone
+    bool Add(const std::string& name, unsigned short type, uint32_t ttl,
+             const void* rdata, size_t n) noexcept;
+
+    // Add records of common types
+    bool AddA(const std::string& name, const std::string& ip, uint32_t ttl) noexcept;
+    bool AddNS(const std::string& name, const std::string& host, uint32_t ttl) noexcept;
+    bool AddCNAME(const std::string& name, const std::string& target, uint32_t ttl) noexcept;
+    bool AddMX(const std::string& name, uint16_t preference, const std::string& exchange, uint32_t ttl) noexcept;
+    bool AddTXT(const std::string& name, const std::string& text, uint32_t ttl) noexcept;
+    bool AddAAAA(const std::string& name, const std::string& ip, uint32_t ttl) noexcept;
+    bool AddSRV(const std::string& name, uint16_t priority, uint16_t weight, uint16_t port,
+                const std::string& target, uint32_t ttl) noexcept;
+
+    // Number of names, including empty non-terminals
+    size_t Size() const noexcept { return _index.size(); }
+
+    // Answer a query into given memory
+    // Return the length of the response, 0 if the query should be dropped
+    // The response is truncated (TC) if it is larger than given size, or
+    // than the payload size of the client over UDP
+    size_t Answer(const void* query, size_t n, void* response, size_t size, bool udp = false) const noexcept;
+
+    // Name in lowercased wire format, empty if invalid
+    static std::string WireName(const std::string& name);
+
+private:
+    std::string _origin;
+    std::string _origin_key;
+
+    // Answer of a name and type, following the question
+    struct Template
+    {
+        uint16_t type;
+        uint8_t rcode;
+        uint16_t ancount;
+        uint16_t nscount;
+        int soa; // offset of SOA owner name to be patched, -1 if fixed
+        std::string data;
+    };
+
+    // Record with RDATA in wire format
+    struct Record
+    {
+        uint16_t type;
+        uint32_t ttl;
+        std::string rdata;
+    };
+
+    struct Node
+    {
+        std::string key;
+        std::vector<Record> records;
+        std::vector<Template> answers; // one per type
+        int cname; // index of CNAME answer, -1 if none
+        Template nodata;
+    };
+
+    // Nodes by hash of key
+    std::unordered_multimap<size_t, Node*> _index;
+
+    // SOA record of the zone, and NXDOMAIN answer
+    bool _has_soa;
+    Record _soa;
+    Template _nxdomain;
+
+    Node* Find(const char* key, size_t n) const noexcept;
+    Node* Insert(const std::string& key);
+
+    // Offset of origin in key, -1 if not in zone
+    ssize_t InZone(const char* key, size_t n) const noexcept;
+
+    // Encode answers of a node
+    void Build(Node* node);
+    void BuildNegative(Template* t, uint8_t rcode, size_t owner);
+
+    static size_t Hash(const char* p, size_t n) noexcept;
+};
+
+NETB_END
+
+#endif
@@ -25,6 +25,8 @@ Error::Error() noexcept
 : _class(0)
 , _message("")
 , _code(0)
+, _context(nullptr)
+, _fd(-1)
 {
 
 }
@@ -34,7 +36,8 @@ Error::Error(const std::string& msg, int code) noexcept
 : _class(&GeneralError())
 , _message(msg)
 , _code(code)
-
+, _context(nullptr)
+, _fd(-1)
 {
 
 }
@@ -44,6 +47,8 @@ Error::Error(const class ErrorClass& cls, const std::string& msg, int code) noex
 : _class(&cls)
 , _message(msg)
 , _code(code)
+, _context(nullptr)
+, _fd(-1)
 {
 
 }
@@ -66,12 +71,15 @@ const class ErrorClass& Error::Class() const noexcept
 void Error::Reset() noexcept
 {
     _class = 0;
-    _message = "";
+    _message.clear();
     _code = 0; 
+    _context = nullptr;
+    _fd = -1;
 }
 
 void Error::Set(const std::string& msg, int code) noexcept
 {
+    _context = nullptr;
     _message = msg;
     _code = code; 
     if(!_class) _class = &GeneralError();
@@ -80,10 +88,34 @@ void Error::Set(const std::string& msg, int code) noexcept
 void Error::Set(const class ErrorClass& cls, const std::string& msg, int code) noexcept
 {
     _class = &cls;
+    _context = nullptr;
     _message = msg;
     _code = code; 
 }
 
+// Message is formatted from context and descriptor when it is asked for
+void Error::Set(const class ErrorClass& cls, const char* context, int fd, int code) noexcept
+{
+    _class = &cls;
+    _context = context;
+    _fd = fd;
+    _message.clear(); // no allocation, capacity is kept
+    _code = code; 
+}
+
+// Same format as "Socket::Send [fd]"
+const std::string& Error::Message() const noexcept
+{
+    if(_context && _message.empty())
+    {
+        std::ostringstream oss;
+        oss << _context;
+        if(_fd >= 0) oss << " [" << _fd << "]";
+        _message = oss.str();
+    }
+    return _message;
+}
+
 void Error::SetClass(const class ErrorClass& cls) noexcept
 {
     _class = &cls;
@@ -91,6 +123,7 @@ void Error::SetClass(const class ErrorClass& cls) noexcept
 
 void Error::SetMessage(const std::string& msg) noexcept
 {
+    _context = nullptr;
     _message = msg;
     if(!_class) _class = &GeneralError();
 }
@@ -107,7 +140,7 @@ std::string Error::Report() const noexcept
     std::ostringstream oss;
     oss << _class->Name();
     if(_code > 0) oss << ":" << _code;
-    if(!_message.empty()) oss << ":" << _message;
+    if(!Message().empty()) oss << ":" << _message;
     oss << ".";
     return oss.str();
 }
@@ -34,6 +34,11 @@ NETB_BEGIN
 // Error class object is a bridge between an error object and an exception. 
 // Usually a subclass of ErrorClass will be declared for each of exceptions. 
 // Error class has a member method to throw associated exception. 
+//
+// Errors of system calls may be set with a static context string and the 
+// descriptor instead of a text message. The message is then formatted only 
+// when it is asked for, so that routine errors, e.g. EAGAIN in non-block 
+// I/O, are set without allocation. 
 // 
 // A static object for each ErrorClass and its subclasses is initiated   
 // when it is referenced for the first time. It is then referenced by all 
@@ -65,12 +70,13 @@ public:
 
     // Get
     const class ErrorClass& Class() const noexcept;
-    const std::string& Message() const noexcept { return _message; }
+    const std::string& Message() const noexcept; // formatted on first call if lazy
     int Code() const noexcept { return _code; }
 
     // Set 
     void Set(const std::string& msg, int code = 0) noexcept; // unclassified error by default
     void Set(const class ErrorClass& cls, const std::string& msg = "", int code = 0) noexcept;
+    void Set(const class ErrorClass& cls, const char* context, int fd, int code) noexcept; // lazy
     void SetClass(const class ErrorClass& cls) noexcept;
     void SetMessage(const std::string& msg) noexcept;
     void SetCode(int code) noexcept;
@@ -80,9 +86,13 @@ public:
 
 private:
     const class ErrorClass* _class; // classification, ErrorClass or its subclass
-    std::string _message;
+    mutable std::string _message;
     int _code;
 
+    // Static context and descriptor of lazy message, e.g. "Socket::Send" 
+    const char* _context;
+    int _fd;
+
 public:
     // Helper class for formatting error message
     class MessageStream
@@ -109,6 +119,7 @@ public:
 #define RESET_ERROR(e) do{ if(e) e->Reset(); } while(0) // no trailing ;
 #define SET_ERROR_CLASS(e, cls) do{ if(e) e->SetClass(cls); } while(0) // no trailing ;
 #define SET_ERROR_MESSAGE(e, msg) do{ if(e) e->SetMessage((Error::MessageStream() << msg)); } while(0) // no trailing ;
+#define SET_ERROR_CONTEXT(e, cls, context, fd, code) do{ if(e) e->Set(cls, context, fd, code); } while(0) // no trailing ;
 #define SET_ERROR_CODE(e, code) do{ if(e) e->SetCode(code); } while(0) // no trailing ;
 
 NETB_END
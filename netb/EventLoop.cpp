@@ -25,6 +25,9 @@ EventLoop::EventLoop()
 , _current_handler(nullptr)
 , _event_handling(false)
 , _queue_invoking(false)
+, _queue_since(0)
+, _stats(nullptr)
+, _now(TimingWheel::Now())
 , _wakeup_handler(this, _wakeup_pipe.ReadSocket())
 {
     // Handle reading event of wake up
@@ -47,38 +50,93 @@ void EventLoop::Run()
     
     while(!_stop)
     {
-        // Block to wait for active events
+        // Stats is checked per iteration, costs no clock reading if not enabled
+        EventLoopStats* stats = _stats.load(std::memory_order_relaxed);
+        int64_t start = 0;
+        if(stats)
+        {
+            stats->_busy_since.store(0, std::memory_order_relaxed);
+            start = EventLoopStats::Now();
+        }
+        // Block to wait for active events, or next timer tick
         std::vector<struct SocketSelector::SocketEvents> sockets;
-        if(_selector.Select(sockets, -1, nullptr) > 0) // ignore errors
+        int n = _selector.Select(sockets, _timers.Timeout(_now), nullptr);
+        _now = TimingWheel::Now();
+        if(stats)
+        {
+            int64_t woken = EventLoopStats::Now();
+            stats->_busy_since.store(woken, std::memory_order_relaxed);
+            stats->_iterations.fetch_add(1, std::memory_order_relaxed);
+            stats->_wait_time.Record(woken - start);
+            stats->_ready_events.Record(n > 0 ? n : 0);
+            start = woken;
+        }
+        if(n > 0) // ignore errors
         {
             _event_handling = true;
             for(auto it = sockets.begin(); it != sockets.end(); ++it)
             {
                 _current_handler = _handlers[it->fd];
                 assert(_current_handler);
-                //if((_current_handler->GetEvents() | it->events) != 0)
-                //{
+                if(stats)
+                {
+                    int64_t begin = EventLoopStats::Now();
+                    _current_handler->HandleEvents(it->events);
+                    stats->_callback_time.Record(EventLoopStats::Now() - begin);
+                }
+                else
+                {
                     _current_handler->HandleEvents(it->events);
-                //}
+                }
             }
             _current_handler = nullptr;
             _event_handling = false;
         }
+        // Expired timers
+        _timers.Advance(_now);
         // Invoking Queued functions
         std::vector<Functor> functions;
+        int64_t queued = 0;
         _queue_invoking = true;
         {
             std::unique_lock<std::mutex> lock(_queue_mutex);
             functions.swap(_queue);
+            queued = _queue_since;
+            _queue_since = 0;
+            // Stats may be enabled in this iteration, depth is counted
+            // with the queue under the lock
+            EventLoopStats* counted = _stats.load(std::memory_order_relaxed);
+            if(counted) counted->_queue_depth.fetch_sub(functions.size(), std::memory_order_relaxed);
+        }
+        if(stats && !functions.empty())
+        {
+            stats->_queue_length.Record(functions.size());
+            stats->_queue_wait.Record(queued > 0 ? EventLoopStats::Now() - queued : 0);
         }
         for(size_t i = 0; i < functions.size(); ++i)
         {
             functions[i]();
         }
         _queue_invoking = false;
+        if(stats)
+        {
+            stats->_iteration_time.Record(EventLoopStats::Now() - start);
+        }
     }
 }
 
+// Stats block is never freed before the loop, so that readers in other
+// threads may keep the pointer
+void EventLoop::EnableStats()
+{
+    if(_stats_block) return;
+    _stats_block.reset(new EventLoopStats());
+    _stats_block->_handlers.store(_handlers.size(), std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(_queue_mutex);
+    _stats_block->_queue_depth.store(_queue.size(), std::memory_order_relaxed);
+    _stats.store(_stats_block.get(), std::memory_order_release);
+}
+
 // Stop running loop
 // Todo: using atomic type for thread safe
 void EventLoop::Stop()
@@ -101,6 +159,8 @@ bool EventLoop::RegisterHandler(EventHandler* handler)
     if(it == _handlers.end())
     {
         _handlers[fd] = handler;
+        EventLoopStats* stats = _stats.load(std::memory_order_relaxed);
+        if(stats) stats->_handlers.store(_handlers.size(), std::memory_order_relaxed);
     }
     return _selector.Set(handler->GetSocket(), handler->GetEvents());
 }
@@ -129,17 +189,35 @@ bool EventLoop::RemoveHandler(EventHandler* handler)
     {
         if(it->second == handler) // found
         {
-            it = _handlers.erase(it);
             _selector.Remove(it->first);
+            it = _handlers.erase(it);
         }
         else
         {
             ++it;
         }
     }
+    EventLoopStats* stats = _stats.load(std::memory_order_relaxed);
+    if(stats) stats->_handlers.store(_handlers.size(), std::memory_order_relaxed);
     return true;
 }
 
+// Start a timer, or move an active timer
+void EventLoop::ScheduleTimer(Timer* timer, int64_t deadline)
+{
+    assert(timer);
+    AssertInLoopThread();
+    _timers.Schedule(timer, deadline);
+}
+
+// Remove a timer
+void EventLoop::CancelTimer(Timer* timer)
+{
+    assert(timer);
+    AssertInLoopThread();
+    _timers.Cancel(timer);
+}
+
 // Set a function that will be invoked in the loop
 // Invoked immediately if called in the loop thread
 // Otherwise append to the queue
@@ -161,6 +239,12 @@ void EventLoop::InvokeLater(const Functor& f)
 {
     {
         std::unique_lock<std::mutex> lock(_queue_mutex);
+        EventLoopStats* stats = _stats.load(std::memory_order_acquire);
+        if(stats)
+        {
+            if(_queue.empty()) _queue_since = EventLoopStats::Now();
+            stats->_queue_depth.fetch_add(1, std::memory_order_relaxed);
+        }
         _queue.push_back(f);
     }
     if(!IsInLoopThread() || _queue_invoking)
@@ -171,6 +255,8 @@ void EventLoop::InvokeLater(const Functor& f)
 
 void EventLoop::Wakeup()
 {
+    EventLoopStats* stats = _stats.load(std::memory_order_acquire);
+    if(stats) stats->_wakeups.fetch_add(1, std::memory_order_relaxed);
     char c = 0;
     if(_wakeup_pipe.Write(&c, 1) < 0)
     {
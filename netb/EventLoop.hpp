@@ -22,8 +22,11 @@
 #include "EventHandler.hpp"
 #include "SocketSelector.hpp"
 #include "SocketPipe.hpp"
+#include "TimingWheel.hpp"
+#include "EventLoopStats.hpp"
 #include <thread>
 #include <mutex>
+#include <memory>
 #include <functional>
 #include <cassert>
 #include <map>
@@ -41,7 +44,8 @@ NETB_BEGIN
 // notification by registering event handlers and dispaching ready 
 // events to the handlers. It also supports function running 
 // notification by setting a general function object as callback.  
-// Timer notification is not supported in this implementation. 
+// Timer notification is supported by a timing wheel driven by the 
+// loop, which is coarse (one tick) but cheap to refresh. 
 //
 // Todo: current implementation suppose that one SOCKET only bound 
 // to one handler, so using a map to manage the the socket and 
@@ -93,6 +97,28 @@ public:
     // Append to the waiting list
     void InvokeLater(const Functor& f);
     
+    // Timer facility, the clock is cached per loop iteration
+    typedef TimingWheel::Timer Timer;
+
+    // Time in milliseconds when the loop waked up last time
+    // Cheap enough to be used on each I/O
+    int64_t Now() const { return _now; }
+
+    // Start a timer with absolute deadline, or move an active timer
+    // Must called in loop thread
+    void ScheduleTimer(Timer* timer, int64_t deadline);
+
+    // Start a timer with delay in milliseconds from now
+    // Must called in loop thread
+    void ScheduleTimerAfter(Timer* timer, int delay)
+    {
+        ScheduleTimer(timer, _now + delay);
+    }
+
+    // Remove a timer
+    // Must called in loop thread
+    void CancelTimer(Timer* timer);
+
     // Check in owner thread
     // thread safe ?
     bool IsInLoopThread() const
@@ -106,6 +132,25 @@ public:
         assert(IsInLoopThread());
     }
 
+    // Start collecting stats, it can not be stopped
+    // Must called in loop thread or before the loop is running
+    void EnableStats();
+
+    // Stats block, nullptr if not enabled
+    // Thread safe, the block lives as long as the loop
+    const EventLoopStats* Stats() const
+    {
+        return _stats.load(std::memory_order_acquire);
+    }
+
+    // I/O stats of all sockets in the loop, nullptr if stats is not enabled
+    // Only updated by sockets in loop thread
+    SocketStats* SocketTotals() const
+    {
+        EventLoopStats* stats = _stats.load(std::memory_order_relaxed);
+        return stats ? &stats->_sockets : nullptr;
+    }
+
 private:
     // Owner thread id
     const std::thread::id _thread_id;
@@ -128,6 +173,15 @@ private:
     std::vector<Functor> _queue;
     std::mutex _queue_mutex;
     bool _queue_invoking; // only used in loop
+    int64_t _queue_since; // time of the oldest queued function, for stats
+
+    // Optional stats, only updated in loop
+    std::atomic<EventLoopStats*> _stats;
+    std::unique_ptr<EventLoopStats> _stats_block;
+
+    // Timers, only used in loop
+    TimingWheel _timers;
+    int64_t _now;
 
 private:
     // Wake up from sleeping
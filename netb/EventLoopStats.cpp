@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EventLoopStats.hpp"
+#include <chrono>
+
+NETB_BEGIN
+
+EventLoopStats::EventLoopStats() noexcept
+: _iterations(0)
+, _wakeups(0)
+, _handlers(0)
+, _queue_depth(0)
+, _busy_since(0)
+, _sockets(&_receive_latency)
+{
+
+}
+
+EventLoopStats::~EventLoopStats() noexcept
+{
+
+}
+
+int64_t EventLoopStats::Now() noexcept
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t EventLoopStats::Busy() const noexcept
+{
+    int64_t since = _busy_since.load(std::memory_order_relaxed);
+    return since > 0 ? Now() - since : 0;
+}
+
+NETB_END
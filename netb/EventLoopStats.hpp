@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_EVENT_LOOP_STATS_HPP
+#define NETB_EVENT_LOOP_STATS_HPP
+
+#include "Config.hpp"
+#include "Uncopyable.hpp"
+#include "Histogram.hpp"
+#include "SocketStats.hpp"
+#include <atomic>
+
+NETB_BEGIN
+
+//
+// EventLoopStats is the optional stats block of an event loop. It is
+// updated by the loop thread with relaxed atomics, except queue depth
+// and wakeups, which are also counted by other threads queuing functions
+// or waking up the loop, with atomic increments. It may be read in any
+// other thread, e.g. for alerting on loop stalls or finding slow
+// handlers. Times are in microseconds.
+//
+class EventLoopStats : private Uncopyable
+{
+public:
+    EventLoopStats() noexcept;
+    ~EventLoopStats() noexcept;
+
+    // Current time in microseconds of monotonic clock
+    static int64_t Now() noexcept;
+
+    // Loop iterations
+    uint64_t Iterations() const noexcept { return _iterations.load(std::memory_order_relaxed); }
+
+    // Wakeups of the loop by other threads or queued functions
+    uint64_t Wakeups() const noexcept { return _wakeups.load(std::memory_order_relaxed); }
+
+    // Registered handlers
+    size_t Handlers() const noexcept { return _handlers.load(std::memory_order_relaxed); }
+
+    // Functions waiting in the queue
+    size_t QueueDepth() const noexcept { return _queue_depth.load(std::memory_order_relaxed); }
+
+    // Time the loop has been busy in current iteration, 0 if it is waiting
+    // for events. A growing value means the loop is stalled
+    int64_t Busy() const noexcept;
+
+    // Time blocked in waiting for events per iteration
+    const Histogram& WaitTime() const noexcept { return _wait_time; }
+
+    // Time of the iteration after waking up, the lag of next events
+    const Histogram& IterationTime() const noexcept { return _iteration_time; }
+
+    // Ready sockets per iteration
+    const Histogram& ReadyEvents() const noexcept { return _ready_events; }
+
+    // Time of each handler callback
+    const Histogram& CallbackTime() const noexcept { return _callback_time; }
+
+    // Queued functions run per iteration, and time the oldest one waited
+    const Histogram& QueueLength() const noexcept { return _queue_length; }
+    const Histogram& QueueWait() const noexcept { return _queue_wait; }
+
+    // I/O of all async sockets in the loop, with latency from waking up
+    // to received callbacks
+    const SocketStats& Sockets() const noexcept { return _sockets; }
+    const Histogram& ReceiveLatency() const noexcept { return _receive_latency; }
+
+private:
+    friend class EventLoop;
+
+    std::atomic<uint64_t> _iterations;
+    std::atomic<uint64_t> _wakeups;
+    std::atomic<size_t> _handlers;
+    std::atomic<size_t> _queue_depth;
+    std::atomic<int64_t> _busy_since; // 0 if waiting
+
+    Histogram _wait_time;
+    Histogram _iteration_time;
+    Histogram _ready_events;
+    Histogram _callback_time;
+    Histogram _queue_length;
+    Histogram _queue_wait;
+    Histogram _receive_latency;
+    SocketStats _sockets;
+};
+
+NETB_END
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Histogram.hpp"
+#include <cassert>
+
+NETB_BEGIN
+
+Histogram::Histogram() noexcept
+{
+    Reset();
+}
+
+Histogram::~Histogram() noexcept
+{
+
+}
+
+// Values below SUB_BUCKETS map to themselves, others to the sub-bucket
+// of the top SUB_BUCKET_BITS + 1 bits, after the buckets of lower powers
+size_t Histogram::BucketOf(uint64_t v) noexcept
+{
+    if(v < SUB_BUCKETS)
+    {
+        return v;
+    }
+    size_t exp = 63 - __builtin_clzll(v);
+    size_t i = (exp - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + ((v >> (exp - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return i < BUCKETS ? i : BUCKETS - 1;
+}
+
+uint64_t Histogram::UpperBound(size_t i) noexcept
+{
+    assert(i < BUCKETS);
+    if(i < SUB_BUCKETS)
+    {
+        return i;
+    }
+    if(i == BUCKETS - 1)
+    {
+        return UINT64_MAX;
+    }
+    size_t shift = i / SUB_BUCKETS - 1;
+    uint64_t lower = (uint64_t)(SUB_BUCKETS + i % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+// Max is raised with CAS, which rarely loops as it rarely changes
+void Histogram::Record(uint64_t v) noexcept
+{
+    _buckets[BucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(v, std::memory_order_relaxed);
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while(v > max && !_max.compare_exchange_weak(max, v, std::memory_order_relaxed));
+}
+
+uint64_t Histogram::Bucket(size_t i) const noexcept
+{
+    assert(i < BUCKETS);
+    return _buckets[i].load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::Percentile(double p) const noexcept
+{
+    uint64_t count = Count();
+    if(count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p / 100 * count + 0.5);
+    if(rank == 0) rank = 1;
+    uint64_t seen = 0;
+    uint64_t max = Max();
+    for(size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += Bucket(i);
+        if(seen >= rank)
+        {
+            return UpperBound(i) < max ? UpperBound(i) : max;
+        }
+    }
+    return max;
+}
+
+// Max of the other is taken as a value, so the CAS of Record() applies
+void Histogram::Merge(const Histogram& other) noexcept
+{
+    for(size_t i = 0; i < BUCKETS; ++i)
+    {
+        uint64_t n = other.Bucket(i);
+        if(n > 0) _buckets[i].fetch_add(n, std::memory_order_relaxed);
+    }
+    _count.fetch_add(other.Count(), std::memory_order_relaxed);
+    _sum.fetch_add(other.Sum(), std::memory_order_relaxed);
+    uint64_t v = other.Max();
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while(v > max && !_max.compare_exchange_weak(max, v, std::memory_order_relaxed));
+}
+
+// Not atomic as a whole, records in between may be partly lost
+void Histogram::Reset() noexcept
+{
+    for(size_t i = 0; i < BUCKETS; ++i)
+    {
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+NETB_END
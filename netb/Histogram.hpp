@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_HISTOGRAM_HPP
+#define NETB_HISTOGRAM_HPP
+
+#include "Config.hpp"
+#include "Uncopyable.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+NETB_BEGIN
+
+//
+// Histogram counts values in log-linear buckets, as HDR histograms do.
+// Each power of 2 is split into 16 linear sub-buckets, so a value is
+// known within 1/16 of itself, and values below 16 are exact. Values
+// of 2^40 or more are counted in the last bucket. Count, sum and max
+// are kept exactly.
+//
+// Recording is lock-free with relaxed atomics, so a histogram may be
+// recorded in one or more threads and read in another. A reader may see
+// a count that does not match the buckets exactly while recording goes
+// on, which is fine for monitoring.
+//
+class Histogram : private Uncopyable
+{
+public:
+    // Sub-buckets per power of 2, and buckets up to 2^40
+    static const size_t SUB_BUCKET_BITS = 4;
+    static const size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const size_t BUCKETS = (40 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    Histogram() noexcept;
+    ~Histogram() noexcept;
+
+    // Record a value
+    void Record(uint64_t v) noexcept;
+
+    // Number, sum and max of recorded values
+    uint64_t Count() const noexcept { return _count.load(std::memory_order_relaxed); }
+    uint64_t Sum() const noexcept { return _sum.load(std::memory_order_relaxed); }
+    uint64_t Max() const noexcept { return _max.load(std::memory_order_relaxed); }
+
+    // Count of the bucket
+    uint64_t Bucket(size_t i) const noexcept;
+
+    // Bucket of a value, and the max value of a bucket
+    static size_t BucketOf(uint64_t v) noexcept;
+    static uint64_t UpperBound(size_t i) noexcept;
+
+    // Add counts of another histogram, e.g. to aggregate per-thread ones
+    void Merge(const Histogram& other) noexcept;
+
+    // Value at given percentile (0-100), upper bound of the bucket
+    // that holds it, but no more than max
+    uint64_t Percentile(double p) const noexcept;
+
+    // Clear all
+    void Reset() noexcept;
+
+private:
+    std::atomic<uint64_t> _buckets[BUCKETS];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+};
+
+NETB_END
+
+#endif
@@ -17,6 +17,7 @@
 
 #include "HttpMessage.hpp"
 #include <sstream>
+#include <cstring>
 #include <cassert>
 
 NETB_BEGIN
@@ -47,7 +48,7 @@ void HttpMessage::Reset()
     }
     _headers.clear();
 
-    if(!_body)
+    if(_body)
     {
         delete[] _body; 
         _body = nullptr; 
@@ -84,6 +85,20 @@ void HttpMessage::SetHeader(const char* key, const char* value)
     _headers.push_back(new Header(key, value));
 }
 
+void HttpMessage::SetHeader(const char* key, long value)
+{
+    std::ostringstream oss;
+    oss << value;
+    SetHeader(key, oss.str().c_str());
+}
+
+void HttpMessage::SetHeader(const char* key, double value)
+{
+    std::ostringstream oss;
+    oss << value;
+    SetHeader(key, oss.str().c_str());
+}
+
 void HttpMessage::RemoveHeader(const char* key) 
 {
     std::vector<Header*>::iterator it(_headers.begin());
@@ -116,18 +131,22 @@ const char* HttpMessage::GetHeader(const char* key) const
     return nullptr;
 }
 
+// 0 if the header is not present
 long HttpMessage::GetHeaderAsInt(const char* key) const
 {
-    std::string value = GetHeader(key);
+    const char* value = GetHeader(key);
+    if(!value) return 0;
     std::istringstream iss(value);
     long v = 0;
     iss >> v;
     return v;
 }
 
+// 0 if the header is not present
 double HttpMessage::GetHeaderAsFloat(const char* key) const
 {
-    std::string value = GetHeader(key);
+    const char* value = GetHeader(key);
+    if(!value) return 0;
     std::istringstream iss(value);
     double v = 0;
     iss >> v;
@@ -144,6 +163,20 @@ const void* HttpMessage::GetBody() const
     return _body;
 }
 
+// Body is copied
+void HttpMessage::SetBody(const void* p, size_t n)
+{
+    delete[] _body;
+    _body = nullptr;
+    _body_len = 0;
+    if(p && n > 0)
+    {
+        _body = new char[n];
+        memcpy(_body, p, n);
+        _body_len = n;
+    }
+}
+
 // To string for debug
 std::string HttpMessage::String() const 
 {
@@ -238,11 +271,15 @@ void HttpMessage::ReadHeader(const StreamReader& stream)
             _state = _body_len > 0 ? PARSING::BODY : PARSING::DONE;
             break;
         }
-        // parse line to key and value
+        // parse line to key and value, malformed lines are skipped
         size_t pos = line.find(":");
-        assert(pos != std::string::npos);
+        if(pos == std::string::npos)
+        {
+            continue;
+        }
         std::string key = line.substr(0, pos);
-        std::string value = line.substr(pos + 1);
+        size_t start = line.find_first_not_of(' ', pos + 1);
+        std::string value = start == std::string::npos ? std::string() : line.substr(start);
         SetHeader(key.c_str(), value.c_str());
     }
 }
@@ -339,6 +376,14 @@ HttpResponse::HttpResponse(const char* version)
 
 }
 
+HttpResponse::HttpResponse(int code, const char* phrase, const char* version) 
+: HttpMessage(version) 
+, _code(code)
+, _phrase(phrase)
+{
+
+}
+
 HttpResponse::~HttpResponse()
 {
 
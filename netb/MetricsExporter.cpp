@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MetricsExporter.hpp"
+#include <future>
+#include <cstring>
+#include <cassert>
+
+NETB_BEGIN
+
+// std::placeholders::_1, _2, ...
+using namespace std::placeholders;
+
+// Loop thread is started before the acceptor is bound to it
+MetricsExporter::MetricsExporter(const MetricsRegistry* registry, const std::string& path)
+: _registry(registry)
+, _path(path)
+, _loop(_thread.Start())
+, _acceptor(_loop)
+, _scrapes(0)
+{
+    assert(_registry);
+    _acceptor.SetAcceptedCallback(std::bind(&MetricsExporter::OnAccepted, this, _1, _2, _3));
+}
+
+MetricsExporter::~MetricsExporter() noexcept
+{
+    Close();
+}
+
+void MetricsExporter::Open(const SocketAddress& addr)
+{
+    Error e;
+    if(!Open(addr, &e))
+    {
+        THROW_ERROR(e);
+    }
+}
+
+bool MetricsExporter::Open(const SocketAddress& addr, Error* e) noexcept
+{
+    return _acceptor.Open(addr, true, false, e);
+}
+
+// Block until isolated from loop
+bool MetricsExporter::Close(Error* e) noexcept
+{
+    bool ret = _acceptor.Close(e);
+    std::promise<void> done;
+    _loop->Invoke([this, &done]()
+    {
+        CloseConnections();
+        done.set_value();
+    });
+    done.get_future().wait();
+    return ret;
+}
+
+void MetricsExporter::CloseConnections()
+{
+    for(auto it = _connections.begin(); it != _connections.end(); ++it)
+    {
+        delete *it;
+    }
+    _connections.clear();
+}
+
+void MetricsExporter::Destroy(Connection* conn) noexcept
+{
+    delete conn;
+}
+
+// Connection is owned by the exporter
+bool MetricsExporter::OnAccepted(AsyncTcpAcceptor* acceptor, SOCKET s, const SocketAddress* addr)
+{
+    Connection* conn = new (std::nothrow) Connection(_loop, s, addr);
+    if(!conn)
+    {
+        return false;
+    }
+    conn->SetConnectedCallback(std::bind(&MetricsExporter::OnConnected, this, _1, _2));
+    conn->SetReceivedCallback(std::bind(&MetricsExporter::OnReceived, this, _1, _2));
+    conn->SetIdleTimeout(DEFAULT_IDLE_TIMEOUT);
+    if(!conn->Connected(nullptr))
+    {
+        delete conn; // socket is closed with it
+        return true;
+    }
+    _connections.insert(conn);
+    return true;
+}
+
+// Closed connection is deleted later, out of its own callback
+void MetricsExporter::OnConnected(AsyncTcpSocket* conn, bool connected)
+{
+    Connection* c = static_cast<Connection*>(conn);
+    if(!connected && _connections.erase(c) > 0)
+    {
+        _loop->InvokeLater(std::bind(&MetricsExporter::Destroy, c));
+    }
+}
+
+// Pipelined requests are answered in order
+void MetricsExporter::OnReceived(AsyncTcpSocket* conn, StreamBuffer* buf)
+{
+    Connection* c = static_cast<Connection*>(conn);
+    while(buf->Readable() > 0 && c->request.FromBuffer(buf))
+    {
+        Respond(c);
+        c->request.Reset();
+    }
+    buf->Flush();
+}
+
+// Only GET and HEAD of the path, query string is ignored
+void MetricsExporter::Respond(Connection* conn)
+{
+    const char* method = conn->request.GetMethod();
+    std::string url = conn->request.GetUrl();
+    url = url.substr(0, url.find('?'));
+    bool head = strcmp(method, "HEAD") == 0;
+    std::string body;
+    HttpResponse response(200, "OK");
+    if(!head && strcmp(method, "GET") != 0)
+    {
+        response.SetStatus(405, "Method Not Allowed");
+        response.SetHeader("Allow", "GET, HEAD");
+    }
+    else if(url != _path)
+    {
+        response.SetStatus(404, "Not Found");
+    }
+    else
+    {
+        _registry->Export(&body);
+        response.SetHeader("Content-Type", MetricsRegistry::CONTENT_TYPE);
+        _scrapes.fetch_add(1, std::memory_order_relaxed);
+    }
+    response.SetHeader("Content-Length", (long)body.size());
+    if(!head && !body.empty())
+    {
+        response.SetBody(body.data(), body.size());
+    }
+    StreamBuffer out;
+    response.ToBuffer(&out);
+    conn->Send(&out);
+}
+
+NETB_END
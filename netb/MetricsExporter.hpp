@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_METRICS_EXPORTER_HPP
+#define NETB_METRICS_EXPORTER_HPP
+
+#include "Uncopyable.hpp"
+#include "EventLoopThread.hpp"
+#include "AsyncTcpAcceptor.hpp"
+#include "AsyncTcpSocket.hpp"
+#include "HttpMessage.hpp"
+#include "MetricsRegistry.hpp"
+#include <atomic>
+#include <set>
+
+NETB_BEGIN
+
+//
+// MetricsExporter serves metrics of a registry over HTTP, for scraping
+// by Prometheus, e.g. GET /metrics. It runs on its own loop thread, so 
+// that formatting and sending never take time of data plane loops, 
+// which only see relaxed atomic reads of their stats.
+//
+// Connections are kept alive for following scrapes, and closed when
+// idle for a while.
+//
+class MetricsExporter : private Uncopyable
+{
+public:
+    // Idle timeout of connections in milliseconds
+    static const int DEFAULT_IDLE_TIMEOUT = 60000;
+
+    // Registry is not owned, and must outlive the exporter
+    // Loop thread is started at once
+    explicit MetricsExporter(const MetricsRegistry* registry, const std::string& path = "/metrics");
+    ~MetricsExporter() noexcept;
+
+    // Event loop of the exporter
+    EventLoop* GetLoop() const noexcept { return _loop; }
+
+    // Open to serve on given address
+    void Open(const SocketAddress& addr); // throw on errors
+    bool Open(const SocketAddress& addr, Error* e) noexcept;
+
+    // Close, and drop all connections
+    bool Close(Error* e = nullptr) noexcept;
+
+    // Local address
+    SocketAddress Address() const noexcept { return _acceptor.Address(); }
+
+    // Requests served with metrics
+    uint64_t Scrapes() const noexcept { return _scrapes.load(std::memory_order_relaxed); }
+
+private:
+    const MetricsRegistry* _registry;
+    const std::string _path;
+    EventLoopThread _thread;
+    EventLoop* _loop;
+    AsyncTcpAcceptor _acceptor;
+    std::atomic<uint64_t> _scrapes;
+
+    // Connection with request being parsed
+    class Connection : public AsyncTcpSocket
+    {
+    public:
+        Connection(EventLoop* loop, SOCKET s, const SocketAddress* addr)
+        : AsyncTcpSocket(loop, s, addr) { }
+        HttpRequest request;
+    };
+    std::set<Connection*> _connections; // only used in loop thread
+
+    // AsyncTcpAcceptor::AcceptedCallback
+    bool OnAccepted(AsyncTcpAcceptor* acceptor, SOCKET s, const SocketAddress* addr);
+
+    // AsyncTcpSocket::ConnectedCallback and ReceivedCallback
+    void OnConnected(AsyncTcpSocket* conn, bool connected);
+    void OnReceived(AsyncTcpSocket* conn, StreamBuffer* buf);
+
+    // Response of a request
+    void Respond(Connection* conn);
+
+    // Close connections in loop thread
+    void CloseConnections();
+    static void Destroy(Connection* conn) noexcept;
+};
+
+NETB_END
+
+#endif
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MetricsRegistry.hpp"
+#include "EventLoop.hpp"
+#include "SocketStats.hpp"
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cassert>
+
+NETB_BEGIN
+
+const char* MetricsRegistry::CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+static const char* TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+
+MetricsRegistry::MetricsRegistry() noexcept
+{
+
+}
+
+MetricsRegistry::~MetricsRegistry() noexcept
+{
+
+}
+
+// [a-zA-Z_:][a-zA-Z0-9_:]*
+bool MetricsRegistry::ValidName(const std::string& name) noexcept
+{
+    if(name.empty() || ::isdigit((unsigned char)name[0]))
+    {
+        return false;
+    }
+    for(size_t i = 0; i < name.size(); ++i)
+    {
+        char c = name[i];
+        if(!::isalnum((unsigned char)c) && c != '_' && c != ':')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The first registering of a name fixes its type and help
+bool MetricsRegistry::Add(const std::string& name, const std::string& help, TYPE type, Series&& series)
+{
+    if(!ValidName(name))
+    {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _families.find(name);
+    if(it == _families.end())
+    {
+        Family& family = _families[name];
+        family.help = help;
+        family.type = type;
+        family.series.push_back(std::move(series));
+        return true;
+    }
+    Family& family = it->second;
+    if(family.type != type)
+    {
+        return false;
+    }
+    for(auto s = family.series.begin(); s != family.series.end(); ++s)
+    {
+        if(s->labels == series.labels)
+        {
+            return false;
+        }
+    }
+    family.series.push_back(std::move(series));
+    return true;
+}
+
+MetricsRegistry::Counter* MetricsRegistry::AddCounter(const std::string& name, const std::string& help, const std::string& labels)
+{
+    std::shared_ptr<Counter> counter = std::make_shared<Counter>();
+    Counter* p = counter.get();
+    Series series = { labels, [p]() { return (double)p->Value(); }, nullptr, counter };
+    return Add(name, help, TYPE::COUNTER, std::move(series)) ? p : nullptr;
+}
+
+MetricsRegistry::Gauge* MetricsRegistry::AddGauge(const std::string& name, const std::string& help, const std::string& labels)
+{
+    std::shared_ptr<Gauge> gauge = std::make_shared<Gauge>();
+    Gauge* p = gauge.get();
+    Series series = { labels, [p]() { return (double)p->Value(); }, nullptr, gauge };
+    return Add(name, help, TYPE::GAUGE, std::move(series)) ? p : nullptr;
+}
+
+Histogram* MetricsRegistry::AddHistogram(const std::string& name, const std::string& help, const std::string& labels)
+{
+    std::shared_ptr<Histogram> histogram = std::make_shared<Histogram>();
+    Histogram* p = histogram.get();
+    Series series = { labels, Reader(), p, histogram };
+    return Add(name, help, TYPE::HISTOGRAM, std::move(series)) ? p : nullptr;
+}
+
+bool MetricsRegistry::AddCounter(const std::string& name, const std::string& help, const std::string& labels, const Reader& reader)
+{
+    assert(reader);
+    Series series = { labels, reader, nullptr, nullptr };
+    return Add(name, help, TYPE::COUNTER, std::move(series));
+}
+
+bool MetricsRegistry::AddGauge(const std::string& name, const std::string& help, const std::string& labels, const Reader& reader)
+{
+    assert(reader);
+    Series series = { labels, reader, nullptr, nullptr };
+    return Add(name, help, TYPE::GAUGE, std::move(series));
+}
+
+bool MetricsRegistry::AddHistogram(const std::string& name, const std::string& help, const std::string& labels, const Histogram* histogram)
+{
+    assert(histogram);
+    Series series = { labels, Reader(), histogram, nullptr };
+    return Add(name, help, TYPE::HISTOGRAM, std::move(series));
+}
+
+// Stats block lives as long as the loop
+bool MetricsRegistry::AddEventLoop(const EventLoop* loop, const std::string& labels)
+{
+    assert(loop);
+    const EventLoopStats* s = loop->Stats();
+    if(!s)
+    {
+        return false;
+    }
+    bool ok = AddCounter("netb_loop_iterations_total", "Iterations of the event loop.", labels, 
+                         [s]() { return (double)s->Iterations(); });
+    ok = AddCounter("netb_loop_wakeups_total", "Wakeups of the event loop by other threads.", labels, 
+                    [s]() { return (double)s->Wakeups(); }) && ok;
+    ok = AddGauge("netb_loop_handlers", "Registered event handlers.", labels, 
+                  [s]() { return (double)s->Handlers(); }) && ok;
+    ok = AddGauge("netb_loop_queue_depth", "Functions waiting in the queue of the loop.", labels, 
+                  [s]() { return (double)s->QueueDepth(); }) && ok;
+    ok = AddGauge("netb_loop_busy_microseconds", "Time the loop has been busy in current iteration.", labels, 
+                  [s]() { return (double)s->Busy(); }) && ok;
+    ok = AddHistogram("netb_loop_wait_microseconds", "Time blocked in waiting for events.", labels, 
+                      &s->WaitTime()) && ok;
+    ok = AddHistogram("netb_loop_iteration_microseconds", "Time of iterations after waking up.", labels, 
+                      &s->IterationTime()) && ok;
+    ok = AddHistogram("netb_loop_ready_events", "Ready sockets per iteration.", labels, 
+                      &s->ReadyEvents()) && ok;
+    ok = AddHistogram("netb_loop_callback_microseconds", "Time of handler callbacks.", labels, 
+                      &s->CallbackTime()) && ok;
+    ok = AddHistogram("netb_loop_queue_length", "Queued functions run per iteration.", labels, 
+                      &s->QueueLength()) && ok;
+    ok = AddHistogram("netb_loop_queue_wait_microseconds", "Time the oldest queued function waited.", labels, 
+                      &s->QueueWait()) && ok;
+    return AddSocketStats("netb_loop_socket", &s->Sockets(), labels) && ok;
+}
+
+bool MetricsRegistry::AddSocketStats(const std::string& prefix, const SocketStats* s, const std::string& labels)
+{
+    assert(s);
+    bool ok = AddCounter(prefix + "_receives_total", "Receiving system calls.", labels, 
+                         [s]() { return (double)s->Receives(); });
+    ok = AddCounter(prefix + "_received_bytes_total", "Bytes received.", labels, 
+                    [s]() { return (double)s->BytesReceived(); }) && ok;
+    ok = AddCounter(prefix + "_sends_total", "Sending system calls.", labels, 
+                    [s]() { return (double)s->Sends(); }) && ok;
+    ok = AddCounter(prefix + "_sent_bytes_total", "Bytes sent.", labels, 
+                    [s]() { return (double)s->BytesSent(); }) && ok;
+    ok = AddCounter(prefix + "_partial_sends_total", "Sends that took less than given data.", labels, 
+                    [s]() { return (double)s->PartialSends(); }) && ok;
+    ok = AddGauge(prefix + "_buffered_high_water_bytes", "Max bytes waiting in sending buffer.", labels, 
+                  [s]() { return (double)s->BufferedHighWater(); }) && ok;
+    if(s->Latency())
+    {
+        ok = AddHistogram(prefix + "_latency_microseconds", "Latency from waking up to received callback.", 
+                          labels, s->Latency()) && ok;
+    }
+    return ok;
+}
+
+// Families without series are removed too
+size_t MetricsRegistry::Remove(const std::string& labels)
+{
+    size_t n = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _families.begin();
+    while(it != _families.end())
+    {
+        std::vector<Series>& series = it->second.series;
+        for(auto s = series.begin(); s != series.end(); )
+        {
+            if(s->labels == labels)
+            {
+                s = series.erase(s);
+                ++n;
+            }
+            else
+            {
+                ++s;
+            }
+        }
+        it = series.empty() ? _families.erase(it) : std::next(it);
+    }
+    return n;
+}
+
+// Integers are exact up to 2^53
+static void AppendValue(std::string* out, double v)
+{
+    char buf[32];
+    if(std::isnan(v))
+    {
+        out->append("NaN");
+        return;
+    }
+    if(std::isinf(v))
+    {
+        out->append(v > 0 ? "+Inf" : "-Inf");
+        return;
+    }
+    if(v == std::floor(v) && std::fabs(v) < 9007199254740992.0)
+    {
+        snprintf(buf, sizeof(buf), "%lld", (long long)v);
+    }
+    else
+    {
+        snprintf(buf, sizeof(buf), "%.17g", v);
+    }
+    out->append(buf);
+}
+
+// Backslash and line feed are escaped in help text
+static void AppendHelp(std::string* out, const std::string& help)
+{
+    for(size_t i = 0; i < help.size(); ++i)
+    {
+        if(help[i] == '\\') out->append("\\\\");
+        else if(help[i] == '\n') out->append("\\n");
+        else out->push_back(help[i]);
+    }
+}
+
+// name{labels} value
+static void AppendSample(std::string* out, const std::string& name, const std::string& labels, 
+                         const char* le, double v)
+{
+    out->append(name);
+    if(!labels.empty() || le)
+    {
+        out->push_back('{');
+        out->append(labels);
+        if(le)
+        {
+            if(!labels.empty()) out->push_back(',');
+            out->append("le=\"").append(le).append("\"");
+        }
+        out->push_back('}');
+    }
+    out->push_back(' ');
+    AppendValue(out, v);
+    out->push_back('\n');
+}
+
+// Buckets are cumulative, one per power of 2, the last one is +Inf
+void MetricsRegistry::ExportHistogram(std::string* out, const std::string& name, 
+                                      const std::string& labels, const Histogram& h)
+{
+    std::string bucket = name + "_bucket";
+    uint64_t count = 0;
+    for(size_t i = 0; i < Histogram::BUCKETS; ++i)
+    {
+        count += h.Bucket(i);
+        if(i % Histogram::SUB_BUCKETS == Histogram::SUB_BUCKETS - 1 && i < Histogram::BUCKETS - 1)
+        {
+            char le[32];
+            snprintf(le, sizeof(le), "%llu", (unsigned long long)Histogram::UpperBound(i));
+            AppendSample(out, bucket, labels, le, (double)count);
+        }
+    }
+    AppendSample(out, bucket, labels, "+Inf", (double)count);
+    AppendSample(out, name + "_sum", labels, nullptr, (double)h.Sum());
+    AppendSample(out, name + "_count", labels, nullptr, (double)count);
+}
+
+void MetricsRegistry::Export(std::string* out) const
+{
+    assert(out);
+    std::unique_lock<std::mutex> lock(_mutex);
+    for(auto it = _families.begin(); it != _families.end(); ++it)
+    {
+        const std::string& name = it->first;
+        const Family& family = it->second;
+        out->append("# HELP ").append(name).push_back(' ');
+        AppendHelp(out, family.help);
+        out->append("\n# TYPE ").append(name).push_back(' ');
+        out->append(TYPE_NAMES[(int)family.type]).push_back('\n');
+        for(auto s = family.series.begin(); s != family.series.end(); ++s)
+        {
+            if(family.type == TYPE::HISTOGRAM)
+            {
+                ExportHistogram(out, name, s->labels, *s->histogram);
+            }
+            else
+            {
+                AppendSample(out, name, s->labels, nullptr, s->reader());
+            }
+        }
+    }
+}
+
+NETB_END
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_METRICS_REGISTRY_HPP
+#define NETB_METRICS_REGISTRY_HPP
+
+#include "Config.hpp"
+#include "Uncopyable.hpp"
+#include "Histogram.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+
+NETB_BEGIN
+
+class EventLoop;
+class SocketStats;
+
+//
+// MetricsRegistry keeps named counters, gauges and histograms, and 
+// exports them in the text exposition format of Prometheus. 
+//
+// Metrics may be owned by the registry, or read from external sources,
+// e.g. stats of event loops and sockets, which are read with relaxed 
+// atomics on exporting, so that scraping never blocks the loops. The 
+// registry is locked only on registering and exporting.
+//
+// A metric is a family of series of the same name, each one with its
+// own labels given in exposition format, e.g. loop="0",route="/". 
+// Histograms are exported with buckets at powers of 2.
+//
+class MetricsRegistry : private Uncopyable
+{
+public:
+    // Types of exposition format
+    enum class TYPE { COUNTER, GAUGE, HISTOGRAM };
+
+    // Value read on exporting, must be thread safe
+    typedef std::function<double ()> Reader;
+
+    // Counter owned by the registry, updated in any thread
+    class Counter : private Uncopyable
+    {
+    public:
+        Counter() noexcept : _value(0) { }
+        void Add(uint64_t n = 1) noexcept { _value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t Value() const noexcept { return _value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<uint64_t> _value;
+    };
+
+    // Gauge owned by the registry, updated in any thread
+    class Gauge : private Uncopyable
+    {
+    public:
+        Gauge() noexcept : _value(0) { }
+        void Set(int64_t v) noexcept { _value.store(v, std::memory_order_relaxed); }
+        void Add(int64_t n) noexcept { _value.fetch_add(n, std::memory_order_relaxed); }
+        int64_t Value() const noexcept { return _value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<int64_t> _value;
+    };
+
+    MetricsRegistry() noexcept;
+    ~MetricsRegistry() noexcept;
+
+    // Metrics owned by the registry, freed on removing
+    // Return nullptr if the name is invalid, registered in another type,
+    // or the series of the labels exists
+    Counter* AddCounter(const std::string& name, const std::string& help, const std::string& labels = std::string());
+    Gauge* AddGauge(const std::string& name, const std::string& help, const std::string& labels = std::string());
+    Histogram* AddHistogram(const std::string& name, const std::string& help, const std::string& labels = std::string());
+
+    // Metrics read from external sources on exporting
+    // Sources must outlive the registry, or be removed before gone
+    bool AddCounter(const std::string& name, const std::string& help, const std::string& labels, const Reader& reader);
+    bool AddGauge(const std::string& name, const std::string& help, const std::string& labels, const Reader& reader);
+    bool AddHistogram(const std::string& name, const std::string& help, const std::string& labels, const Histogram* histogram);
+
+    // Stats of a loop and all sockets in it, named netb_loop_*
+    // Return false if stats of the loop is not enabled
+    bool AddEventLoop(const EventLoop* loop, const std::string& labels);
+
+    // Stats of a socket, or a route of a server, named with given prefix
+    bool AddSocketStats(const std::string& prefix, const SocketStats* stats, const std::string& labels);
+
+    // Remove all series of given labels, e.g. of a closed connection
+    // Return the number of removed series
+    size_t Remove(const std::string& labels);
+
+    // Append all metrics in text exposition format
+    void Export(std::string* out) const;
+
+    // Content type of exporting
+    static const char* CONTENT_TYPE;
+
+private:
+    struct Series
+    {
+        std::string labels;
+        Reader reader;
+        const Histogram* histogram;
+        std::shared_ptr<void> owned;
+    };
+
+    struct Family
+    {
+        std::string help;
+        TYPE type;
+        std::vector<Series> series;
+    };
+
+    // Sorted by name
+    std::map<std::string, Family> _families;
+    mutable std::mutex _mutex;
+
+    // Add a series, return false if not accepted
+    bool Add(const std::string& name, const std::string& help, TYPE type, Series&& series);
+
+    static bool ValidName(const std::string& name) noexcept;
+    static void ExportHistogram(std::string* out, const std::string& name, 
+                                const std::string& labels, const Histogram& h);
+};
+
+NETB_END
+
+#endif
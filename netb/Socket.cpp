@@ -16,6 +16,9 @@
  */
 
 #include "Socket.hpp"
+#include <poll.h>
+#include <climits>
+#include <algorithm>
 
 NETB_BEGIN
 
@@ -43,6 +46,7 @@ bool CloseSocket(SOCKET& s, Error* e) noexcept
 // Empty socket, initialized by following operations
 Socket::Socket() noexcept
 : _fd(INVALID_SOCKET)
+, _blocking(-1)
 {
 
 }
@@ -51,6 +55,7 @@ Socket::Socket() noexcept
 // No socket is opened if errors ocurred
 Socket::Socket(int domain, int type, int protocol)
 : _fd(INVALID_SOCKET)
+, _blocking(-1)
 {
     Error e;
     if(!InitSocket(domain, type, protocol, &e))
@@ -63,13 +68,15 @@ Socket::Socket(int domain, int type, int protocol)
 // No socket is opened if errors ocurred
 Socket::Socket(int domain, int type, int protocol, Error* e) noexcept
 : _fd(INVALID_SOCKET)
+, _blocking(-1)
 {
     InitSocket(domain, type, protocol, e);
 }
 
-// Attch an externally opened socket
+// Attch an externally opened socket, I/O mode is unknown
 Socket::Socket(SOCKET s) noexcept
 : _fd(s)
+, _blocking(-1)
 {
 
 }
@@ -94,6 +101,12 @@ bool Socket::InitSocket(int domain, int type, int protocol, Error* e) noexcept
         SET_SOCKET_OPEN_ERROR(e, "Socket::InitSocket");
         return false;
     }
+    // New socket is in block mode, unless asked otherwise
+#ifdef SOCK_NONBLOCK
+    _blocking = (type & SOCK_NONBLOCK) ? 0 : 1;
+#else
+    _blocking = 1;
+#endif
     return true;
 }
 
@@ -128,6 +141,10 @@ bool Socket::Attach(SOCKET s) noexcept
     {
         Close(); // errors on closing is ignored
     }
+    if(_fd != s)
+    {
+        _blocking = -1;
+    }
     _fd = s;
     return _fd != INVALID_SOCKET;
 }
@@ -138,6 +155,7 @@ SOCKET Socket::Detach() noexcept
 {
     SOCKET s = _fd;
     _fd = INVALID_SOCKET;
+    _blocking = -1;
     return s;
 }
 
@@ -145,6 +163,7 @@ SOCKET Socket::Detach() noexcept
 bool Socket::Close(Error* e) noexcept
 {
     if(_fd == INVALID_SOCKET) return true;
+    _blocking = -1;
     return CloseSocket(_fd, e);
 }
 
@@ -275,7 +294,7 @@ SOCKET Socket::Accept(Error* e) noexcept
     {
         if(!SocketError::Interrupted())
         {
-            SET_SOCKET_ACCEPT_ERROR(e, "Socke::Accept [" <<  _fd << "]");
+            SocketError::Accept::SetError(e, "Socket::Accept", _fd);
             return INVALID_SOCKET;
         }
     }
@@ -306,7 +325,7 @@ SOCKET Socket::AcceptFrom(SocketAddress* addr, Error* e) noexcept
     {
         if(!SocketError::Interrupted())
         {
-            SET_SOCKET_ACCEPT_ERROR(e, "Socket::AcceptFrom [" <<  _fd << "]");
+            SocketError::Accept::SetError(e, "Socket::AcceptFrom", _fd);
             return INVALID_SOCKET;
         }
     }
@@ -354,56 +373,105 @@ SocketAddress Socket::ConnectedAddress(Error* e) const noexcept
     return addr;
 }
 
-// Select events of the sockets
-// -1: block, 0: non-block, >0: block with timeout
-bool Socket::WaitForRead(int timeout, Error* e) noexcept
+Socket::Deadline Socket::DeadlineAfter(int timeout) noexcept
 {
-    SocketSelector selector(_fd, SOCKET_EVENT_READ);
-    std::vector<SocketSelector::SocketEvents> sockets;
-    if(selector.Select(sockets, timeout, e) <= 0)
+    if(timeout < 0)
     {
-        return false;
+        return Deadline::max();
     }
-    assert(!sockets.empty());
-    assert(sockets[0].fd == _fd);
-    assert((sockets[0].events | SOCKET_EVENT_READ) > 0);
-    return true;
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+}
+
+// -1: block, 0: non-block, >0: block with timeout
+bool Socket::WaitForRead(int timeout, Error* e) noexcept
+{
+    return Poll(SOCKET_EVENT_READ, DeadlineAfter(timeout), e) > 0;
 }
 
 bool Socket::WaitForWrite(int timeout, Error* e) noexcept
 {
-    SocketSelector selector(_fd, SOCKET_EVENT_WRITE);
-    std::vector<SocketSelector::SocketEvents> sockets;
-    if(selector.Select(sockets, timeout, e) <= 0)
-    {
-        return false;
-    }
-    assert(!sockets.empty());
-    assert(sockets[0].fd == _fd);
-    assert((sockets[0].events | SOCKET_EVENT_WRITE) > 0);
-    return true;
+    return Poll(SOCKET_EVENT_WRITE, DeadlineAfter(timeout), e) > 0;
+}
+
+bool Socket::WaitForRead(const Deadline& deadline, Error* e) noexcept
+{
+    return Poll(SOCKET_EVENT_READ, deadline, e) > 0;
+}
+
+bool Socket::WaitForWrite(const Deadline& deadline, Error* e) noexcept
+{
+    return Poll(SOCKET_EVENT_WRITE, deadline, e) > 0;
 }
 
 // -1: errors, 0: timeout, >0: events
 int Socket::WaitForReady(int timeout, Error* e) noexcept
 {
-    SocketSelector selector(_fd, SOCKET_EVENT_READ | SOCKET_EVENT_WRITE | SOCKET_EVENT_EXCEPT);
-    std::vector<SocketSelector::SocketEvents> sockets;
-    if(selector.Select(sockets, timeout, e) < 0)
+    return Poll(SOCKET_EVENT_READ | SOCKET_EVENT_WRITE | SOCKET_EVENT_EXCEPT, DeadlineAfter(timeout), e);
+}
+
+int Socket::WaitForReady(const Deadline& deadline, Error* e) noexcept
+{
+    return Poll(SOCKET_EVENT_READ | SOCKET_EVENT_WRITE | SOCKET_EVENT_EXCEPT, deadline, e);
+}
+
+// A single socket is polled with pollfd on stack, so it works for any 
+// descriptor, unlike select() that is limited by FD_SETSIZE. Errors and 
+// hangup are reported as ready, so that following I/O gets the error.
+int Socket::Poll(int events, const Deadline& deadline, Error* e) noexcept
+{
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = 0;
+    if(events & SOCKET_EVENT_READ) pfd.events |= POLLIN;
+    if(events & SOCKET_EVENT_WRITE) pfd.events |= POLLOUT;
+    if(events & SOCKET_EVENT_EXCEPT) pfd.events |= POLLPRI;
+    int ret;
+    while(true)
     {
+        pfd.revents = 0;
+        int timeout = -1;
+        if(deadline != Deadline::max())
+        {
+            // Round up, not to wake up before deadline
+            auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+            timeout = left <= 0 ? 0 : (int)std::min<int64_t>((left + 999) / 1000, INT_MAX);
+        }
+#ifdef _WIN32
+        ret = ::WSAPoll(&pfd, 1, timeout);
+#else
+        ret = ::poll(&pfd, 1, timeout);
+#endif
+        if(ret >= 0 || !SocketError::Interrupted())
+        {
+            break;
+        }
+    }
+    if(ret < 0)
+    {
+        SocketError::Select::SetError(e, "Socket::Poll", _fd);
         return -1;
     }
-    if(sockets.empty())
+    if(ret == 0)
     {
+        SET_ERROR_CONTEXT(e, RuntimeError(), "Socket::Poll", _fd, ErrorCode::TIMEDOUT);
         return 0;
     }
-    assert(!sockets.empty());
-    assert(sockets[0].fd == _fd);
-    assert(sockets[0].events > 0);
-    return sockets[0].events;
-} 
+    if(pfd.revents & POLLNVAL)
+    {
+        SocketError::Select::SetError(e, "Socket::Poll", _fd, EBADF);
+        return -1;
+    }
+    int ready = SOCKET_EVENT_NONE;
+    if(pfd.revents & (POLLIN | POLLHUP)) ready |= SOCKET_EVENT_READ;
+    if(pfd.revents & POLLOUT) ready |= SOCKET_EVENT_WRITE;
+    if(pfd.revents & (POLLPRI | POLLERR)) ready |= SOCKET_EVENT_EXCEPT;
+    if(pfd.revents & (POLLERR | POLLHUP)) ready |= events; // to get the error by I/O
+    return ready;
+}
 
 // Send data over a connected socket
+// Errors are set lazily, since EAGAIN is routine in non-block mode
 // Return value varied on block or non-block mode
 ssize_t Socket::Send(const void* p, size_t n, int flags, Error* e) noexcept 
 {
@@ -413,7 +481,7 @@ ssize_t Socket::Send(const void* p, size_t n, int flags, Error* e) noexcept
     {
         if(!SocketError::Interrupted())
         {
-            SET_SOCKET_SEND_ERROR(e, "Socket::Send [" << _fd << "]"); 
+            SocketError::Send::SetError(e, "Socket::Send", _fd);
             break;
         }
     }
@@ -430,7 +498,7 @@ ssize_t Socket::Receive(void* p, size_t n, int flags, Error* e) noexcept
     {
         if(!SocketError::Interrupted())
         {
-            SET_SOCKET_RECEIVE_ERROR(e, "Socket::Receive [" << _fd << "]"); 
+            SocketError::Receive::SetError(e, "Socket::Receive", _fd);
             break;
         }
     }
@@ -450,7 +518,7 @@ ssize_t Socket::SendTo(const void* p, size_t n, const SocketAddress& addr, int f
     {
         if(!SocketError::Interrupted())
         {
-            SET_SOCKET_SEND_ERROR(e, "Socket::SendTo [" << _fd << "]");
+            SocketError::Send::SetError(e, "Socket::SendTo", _fd);
             break;
         }
     }
@@ -472,25 +540,45 @@ ssize_t Socket::ReceiveFrom(void* p, size_t n, SocketAddress* addr, int flags, E
     {
         if(!SocketError::Interrupted())
         {
-            SET_SOCKET_RECEIVE_ERROR(e, "Socket::ReceiveFrom [" << _fd << "]");
+            SocketError::Receive::SetError(e, "Socket::ReceiveFrom", _fd);
             break;
         }
     }
     return ret;
 }
 
+// Send data in segments of msg->msg_iov with one system call
+// Return value varied on block or non-block mode
 ssize_t Socket::SendMessage(const struct msghdr* msg, int flags, Error* e) noexcept
 {
-    assert(false);
-    SET_ERROR(e, "Function is not implemented yet.", 0);
-    return -1;
+    assert(msg);
+    ssize_t ret;
+    while((ret = ::sendmsg(_fd, msg, flags)) == SOCKET_ERROR)
+    {
+        if(!SocketError::Interrupted())
+        {
+            SocketError::Send::SetError(e, "Socket::SendMessage", _fd);
+            break;
+        }
+    }
+    return ret;
 }
 
+// Receive data into segments of msg->msg_iov with one system call
+// Return value varied on block or non-block mode
 ssize_t Socket::ReceiveMessage(struct msghdr* msg, int flags, Error* e) noexcept
 {
-    assert(false);
-    SET_ERROR(e, "Function is not implemented yet.", 0);
-    return -1;
+    assert(msg);
+    ssize_t ret;
+    while((ret = ::recvmsg(_fd, msg, flags)) == SOCKET_ERROR)
+    {
+        if(!SocketError::Interrupted())
+        {
+            SocketError::Receive::SetError(e, "Socket::ReceiveMessage", _fd);
+            break;
+        }
+    }
+    return ret;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -505,22 +593,33 @@ void Socket::Block(bool block)
     }
 }
 
+// The mode is cached, so that repeated calls in the same mode cost no 
+// system calls. Changing O_NONBLOCK of the descriptor by other means 
+// makes the cache stale. 
 bool Socket::Block(bool block, Error* e) noexcept
 {
+    if(_blocking == (block ? 1 : 0))
+    {
+        return true;
+    }
 #ifdef _WIN32
     unsigned long arg = block ? 0 : 1;
     int ret = ::ioctlsocket(_fd, FIONBIO, &arg);
 #else
-    int flags = ::fcntl(_fd, F_GETFL);
-    if(block) flags &= ~O_NONBLOCK;
-    else flags |= O_NONBLOCK;
-    int ret = ::fcntl(_fd, F_SETFL, flags);
+    int ret = ::fcntl(_fd, F_GETFL);
+    if(ret != SOCKET_ERROR)
+    {
+        int flags = block ? (ret & ~O_NONBLOCK) : (ret | O_NONBLOCK);
+        ret = flags == ret ? 0 : ::fcntl(_fd, F_SETFL, flags);
+    }
 #endif
     if(ret == SOCKET_ERROR)
     {
+        _blocking = -1;
         SET_SOCKET_CONTROL_ERROR(e, "Socket::Block [" << _fd << "][" << block << "]");
         return false;
     }
+    _blocking = block ? 1 : 0;
     return true;
 }
 
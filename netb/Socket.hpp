@@ -21,6 +21,7 @@
 #include "SocketConfig.hpp"
 #include "SocketAddress.hpp"
 #include "SocketSelector.hpp"
+#include <chrono>
 
 NETB_BEGIN
 
@@ -145,16 +146,26 @@ public:
     // return empty address on errors
     SocketAddress ConnectedAddress(Error* e = nullptr) const noexcept;
 
+    // Absolute deadline of waiting, on steady clock
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+    // Deadline of timeout in milliseconds from now, -1 for no deadline
+    static Deadline DeadlineAfter(int timeout) noexcept;
+
     // Timeout control for read and write
     // Return true if I/O is ready, return false if timeout or errors occurred
     // timeout in milliseconds, -1: block, 0: non-block, >0: block with timeout
+    // Waiting is resumed on system interruption, with time left to deadline
     bool WaitForRead(int timeout = -1, Error* e = nullptr) noexcept;
     bool WaitForWrite(int timeout = -1, Error* e = nullptr) noexcept;
+    bool WaitForRead(const Deadline& deadline, Error* e = nullptr) noexcept;
+    bool WaitForWrite(const Deadline& deadline, Error* e = nullptr) noexcept;
 
     // Timeout control for I/O events
     // Return -1 for errors, 0 for timeout, and >0 for I/O events
     // timeout in milliseconds, -1: errors, 0: timeout, >0: events
     int WaitForReady(int timeout = -1, Error* e = nullptr) noexcept; 
+    int WaitForReady(const Deadline& deadline, Error* e = nullptr) noexcept; 
 
     // Send and receive data through connected socket
     ssize_t Send(const void* p, size_t n, int flags = 0, Error* e = nullptr) noexcept;
@@ -173,9 +184,13 @@ public:
 
 public: 
     // Set IO mode: block or non-block
+    // The mode is cached, no system call if it is not changed
     void Block(bool block); // default is block
     bool Block(bool block, Error* e) noexcept;
 
+    // Cached IO mode, 1: block, 0: non-block, -1: unknown
+    int Blocking() const noexcept { return _blocking; }
+
     // Set socket option of reuse address
     void ReuseAddress(bool reuse); // default is false
     bool ReuseAddress(bool reuse, Error* e) noexcept;
@@ -192,8 +207,15 @@ private:
     // Socket descriptor (file descriptor)
     SOCKET _fd; 
 
+    // Cached IO mode, -1 if unknown, e.g. attached socket
+    int _blocking;
+
     // Initialize socket, return false on errors
     bool InitSocket(int domain, int type, int protocol, Error* e) noexcept;
+
+    // Wait for SOCKET_EVENT_XXX until deadline
+    // Return -1 for errors, 0 for timeout, and >0 for I/O events
+    int Poll(int events, const Deadline& deadline, Error* e) noexcept;
 };
 
 NETB_END
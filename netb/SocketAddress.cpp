@@ -206,44 +206,70 @@ unsigned short SocketAddress::Port() const
 }
 
 // Check special address
-bool SocketAddress::Wildcard() const  // INADDR_ANY
+// Unsupported families are not special
+bool SocketAddress::Wildcard() const  // INADDR_ANY:0
 {
-    assert(false);
+    return AnyHost() && AnyPort();
 }
 
 bool SocketAddress::Any() const  // INADDR_ANY:0
 {
-    assert(false);
+    return AnyHost() && AnyPort();
 }
 
 bool SocketAddress::AnyPort() const  // 0
 {
-    assert(false);
+    return (this->ss_family == AF_INET || this->ss_family == AF_INET6) && Port() == 0;
 }
 
 bool SocketAddress::AnyHost() const  // INADDR_ANY
 {
-    assert(false);
+    if(this->ss_family == AF_INET)
+    {
+        return reinterpret_cast<const struct sockaddr_in*>(this)->sin_addr.s_addr == htonl(INADDR_ANY);
+    }
+    else if(this->ss_family == AF_INET6)
+    {
+        return IN6_IS_ADDR_UNSPECIFIED(&reinterpret_cast<const struct sockaddr_in6*>(this)->sin6_addr);
+    }
+    return false;
 }
 
 bool SocketAddress::Localhost() const  // "localhost"
 {
-    assert(false);
+    return Loopback();
 }
 
 bool SocketAddress::Loopback() const  // INADDR_LOOPBACK
 {
-    assert(false);
+    if(this->ss_family == AF_INET)
+    {
+        return (ntohl(reinterpret_cast<const struct sockaddr_in*>(this)->sin_addr.s_addr) >> 24) == 127;
+    }
+    else if(this->ss_family == AF_INET6)
+    {
+        return IN6_IS_ADDR_LOOPBACK(&reinterpret_cast<const struct sockaddr_in6*>(this)->sin6_addr);
+    }
+    return false;
 }
 
 bool SocketAddress::Broadcast() const  // INADDR_NONE
 {
-    assert(false);
+    return this->ss_family == AF_INET && 
+           reinterpret_cast<const struct sockaddr_in*>(this)->sin_addr.s_addr == htonl(INADDR_NONE);
 }
 
 bool SocketAddress::Multicast() const // 
 {
-    assert(false);
+    if(this->ss_family == AF_INET)
+    {
+        return IN_MULTICAST(ntohl(reinterpret_cast<const struct sockaddr_in*>(this)->sin_addr.s_addr));
+    }
+    else if(this->ss_family == AF_INET6)
+    {
+        return IN6_IS_ADDR_MULTICAST(&reinterpret_cast<const struct sockaddr_in6*>(this)->sin6_addr);
+    }
+    return false;
 }
 
 // String format address
@@ -30,6 +30,45 @@ void SetError(Error* e, const std::string& msg, int code)
     SET_ERROR(e, msg, code);
 }
 
+//
+// Error codes of each function are sorted into classes by a table, codes 
+// not in the table are unclassified. Tables are short, so they are simply 
+// scanned. 
+//
+enum CLASSIFICATION { LOGIC, RUNTIME };
+
+struct Classification
+{
+    int code;
+    CLASSIFICATION cls;
+};
+
+template <size_t N>
+static const class ErrorClass& Classify(const Classification (&table)[N], int code) noexcept
+{
+    for(size_t i = 0; i < N; ++i)
+    {
+        if(table[i].code == code)
+        {
+            if(table[i].cls == LOGIC) return LogicError();
+            return RuntimeError();
+        }
+    }
+    return GeneralError();
+}
+
+// Implement error setting functions declared for a function, with its table
+// Lazy one only keeps the static context and descriptor, no allocation 
+#define IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(FUNC, TABLE)                         \
+    void FUNC::SetError(Error* e, const std::string& msg, int code)                 \
+    {                                                                               \
+        if(e) e->Set(Classify(TABLE, code), msg, code);                             \
+    }                                                                               \
+    void FUNC::SetError(Error* e, const char* context, int fd, int code) noexcept    \
+    {                                                                               \
+        if(e) e->Set(Classify(TABLE, code), context, fd, code);                     \
+    }
+
 /*
 EBADF   An invalid file descriptor was given in one of the sets.
         (Perhaps a file descriptor that was already closed, or one on
@@ -45,25 +84,14 @@ EINVAL  The value contained within timeout is invalid.
 ENOMEM  Unable to allocate memory for internal tables.
 */
 
-void Select::SetError(Error* e, const std::string& msg, int code)
+static const Classification SELECT_ERRORS[] =
 {
-    switch(code)
-    {
-        case EBADF:
-        case EINVAL: 
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        case ENOMEM:
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-            SET_ERROR(e, msg, code);
-    }
-}
+    { EBADF,           LOGIC },
+    { EINVAL,          LOGIC },
+    { ENOMEM,          RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Select, SELECT_ERRORS)
 
 /*
 Error code for socket() 
@@ -96,30 +124,19 @@ EPROTONOSUPPORT
 Other errors may be generated by the underlying protocol modules.
 */
 
-void Open::SetError(Error* e, const std::string& msg, int code)
+static const Classification OPEN_ERRORS[] =
 {
-    switch(code)
-    {
-        case EAFNOSUPPORT:
-        case EINVAL:
-        case EPROTONOSUPPORT:
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        case EACCES:
-        case EMFILE:
-        case ENFILE:
-        case ENOBUFS:
-        case ENOMEM:
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-            SET_ERROR(e, msg, code);
-    }
-}
+    { EAFNOSUPPORT,    LOGIC },
+    { EINVAL,          LOGIC },
+    { EPROTONOSUPPORT, LOGIC },
+    { EACCES,          RUNTIME },
+    { EMFILE,          RUNTIME },
+    { ENFILE,          RUNTIME },
+    { ENOBUFS,         RUNTIME },
+    { ENOMEM,          RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Open, OPEN_ERRORS)
 
 /*
 Error code for close():
@@ -134,25 +151,14 @@ See NOTES for a discussion of why close() should not be retried after
 an error.
 */
 
-void Close::SetError(Error* e, const std::string& msg, int code)
+static const Classification CLOSE_ERRORS[] =
 {
-    switch(code)
-    {
-        case EBADF:
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        case EINTR:
-        case EIO:
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-            SET_ERROR(e, msg, code);
-    }
-}
+    { EBADF,           LOGIC },
+    { EINTR,           RUNTIME },
+    { EIO,             RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Close, CLOSE_ERRORS)
 
 /*
 Error code for shutdown()
@@ -168,26 +174,15 @@ ENOTSOCK
         The file descriptor sockfd does not refer to a socket.
 */
 
-void Shutdown::SetError(Error* e, const std::string& msg, int code)
+static const Classification SHUTDOWN_ERRORS[] =
 {
-    switch(code)
-    {
-        case EBADF:
-        case EINVAL:
-        case ENOTSOCK:
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        case ENOTCONN:
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-            SET_ERROR(e, msg, code);
-    }
-}
+    { EBADF,           LOGIC },
+    { EINVAL,          LOGIC },
+    { ENOTSOCK,        LOGIC },
+    { ENOTCONN,        RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Shutdown, SHUTDOWN_ERRORS)
 
 /*
 Error code for bind():
@@ -216,23 +211,16 @@ ENOTSOCK
         The file descriptor sockfd does not refer to a socket.
 */
 
-void Bind::SetError(Error* e, const std::string& msg, int code)
+static const Classification BIND_ERRORS[] =
 {
-    switch(code)
-    {
-        case EACCES: 
-        case EADDRINUSE: 
-        case EBADF:
-        case EINVAL: 
-        case ENOTSOCK:
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        default:
-            SET_ERROR(e, msg, code);
-    }
-}
+    { EACCES,          LOGIC },
+    { EADDRINUSE,      LOGIC },
+    { EBADF,           LOGIC },
+    { EINVAL,          LOGIC },
+    { ENOTSOCK,        LOGIC }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Bind, BIND_ERRORS)
 
 /*
 Error code for connect():
@@ -307,57 +295,115 @@ ETIMEDOUT
 
 */
 
-void Connect::SetError(Error* e, const std::string& msg, int code)
+static const Classification CONNECT_ERRORS[] =
 {
-    switch(code)
-    {
-        case EAFNOSUPPORT: 
-        case EALREADY: 
-        case EBADF: 
-        case EFAULT: 
-        case EISCONN: 
-        case ENOTSOCK: 
-        case EPROTOTYPE: 
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            return;
-        }
-        case EACCES: 
-        case EPERM: 
-        case EADDRINUSE:
-        case EADDRNOTAVAIL: 
-        case ENETUNREACH: 
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        case EAGAIN: 
-        case ECONNREFUSED:
-        case EINPROGRESS:
-        case EINTR: 
-        case ETIMEDOUT: 
-        {
-            assert(false);
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-        {
-            SET_ERROR(e, msg, code);
-            break;
-        }
-    }
-}
+    { EAFNOSUPPORT,    LOGIC },
+    { EALREADY,        LOGIC },
+    { EBADF,           LOGIC },
+    { EFAULT,          LOGIC },
+    { EISCONN,         LOGIC },
+    { ENOTSOCK,        LOGIC },
+    { EPROTOTYPE,      LOGIC },
+    { EACCES,          RUNTIME },
+    { EPERM,           RUNTIME },
+    { EADDRINUSE,      RUNTIME },
+    { EADDRNOTAVAIL,   RUNTIME },
+    { ENETUNREACH,     RUNTIME },
+    { EAGAIN,          RUNTIME },
+    { ECONNREFUSED,    RUNTIME },
+    { EINPROGRESS,     RUNTIME },
+    { ETIMEDOUT,       RUNTIME },
+    { EINTR,           RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Connect, CONNECT_ERRORS)
+
+/*
+Error code for listen():
+
+EADDRINUSE
+        Another socket is already listening on the same port.
+
+EBADF  The argument sockfd is not a valid file descriptor.
+
+ENOTSOCK
+        The file descriptor sockfd does not refer to a socket.
+
+EOPNOTSUPP
+        The socket is not of a type that supports the listen()
+        operation.
+*/
 
-void Listen::SetError(Error* e, const std::string& msg, int code)
+static const Classification LISTEN_ERRORS[] =
 {
+    { EBADF,           LOGIC },
+    { ENOTSOCK,        LOGIC },
+    { EOPNOTSUPP,      LOGIC },
+    { EADDRINUSE,      RUNTIME }
+};
 
-}
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Listen, LISTEN_ERRORS)
+
+/*
+Error code for accept():
+
+EAGAIN or EWOULDBLOCK
+        The socket is marked nonblocking and no connections are
+        present to be accepted.
+
+EBADF  sockfd is not an open file descriptor.
+
+ECONNABORTED
+        A connection has been aborted.
+
+EFAULT The addr argument is not in a writable part of the user
+        address space.
+
+EINTR  The system call was interrupted by a signal that was caught
+        before a valid connection arrived; see signal(7).
+
+EINVAL Socket is not listening for connections, or addrlen is
+        invalid (e.g., is negative).
+
+EMFILE The per-process limit on the number of open file descriptors
+        has been reached.
+
+ENFILE The system-wide limit on the total number of open files has
+        been reached.
+
+ENOBUFS, ENOMEM
+        Not enough free memory.
+
+ENOTSOCK
+        The file descriptor sockfd does not refer to a socket.
 
-void Accept::SetError(Error* e, const std::string& msg, int code)
+EOPNOTSUPP
+        The referenced socket is not of type SOCK_STREAM.
+
+EPERM  Firewall rules forbid connection.
+
+EPROTO Protocol error.
+*/
+
+static const Classification ACCEPT_ERRORS[] =
 {
-    
-}
+    { EBADF,           LOGIC },
+    { EFAULT,          LOGIC },
+    { EINVAL,          LOGIC },
+    { ENOTSOCK,        LOGIC },
+    { EOPNOTSUPP,      LOGIC },
+    { EAGAIN,          RUNTIME },
+    { ECONNABORTED,    RUNTIME },
+    { EINTR,           RUNTIME },
+    { EMFILE,          RUNTIME },
+    { ENFILE,          RUNTIME },
+    { ENOBUFS,         RUNTIME },
+    { ENOMEM,          RUNTIME },
+    { EPERM,           RUNTIME },
+    { EPROTO,          RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Accept, ACCEPT_ERRORS)
 
 /*
 Error code for send(), sendto(), and sendmsg():
@@ -432,47 +478,27 @@ EPIPE   The local end has been shut down on a connection oriented
         unless MSG_NOSIGNAL is set.
 */
 
-void Send::SetError(Error* e, const std::string& msg, int code)
+static const Classification SEND_ERRORS[] =
 {
-    switch(code)
-    {
-        case EACCES:
-        case EBADF:
-        case EDESTADDRREQ: 
-        case EFAULT: 
-        case EINVAL: 
-        case EISCONN: 
-        case EMSGSIZE: 
-        case ENOTCONN:
-        case ENOTSOCK:
-        case EOPNOTSUPP:
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        case ECONNRESET:
-        case ENOBUFS:
-        case ENOMEM: 
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        case EAGAIN:
-        //case EWOULDBLOCK:
-        case EINTR:
-        case EPIPE:
-        {
-            assert(false);
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-        {
-            SET_ERROR(e, msg, code);
-            break;
-        }
-    }
-}
+    { EACCES,          LOGIC },
+    { EBADF,           LOGIC },
+    { EDESTADDRREQ,    LOGIC },
+    { EFAULT,          LOGIC },
+    { EINVAL,          LOGIC },
+    { EISCONN,         LOGIC },
+    { EMSGSIZE,        LOGIC },
+    { ENOTCONN,        LOGIC },
+    { ENOTSOCK,        LOGIC },
+    { EOPNOTSUPP,      LOGIC },
+    { ECONNRESET,      RUNTIME },
+    { ENOBUFS,         RUNTIME },
+    { ENOMEM,          RUNTIME },
+    { EAGAIN,          RUNTIME },
+    { EINTR,           RUNTIME },
+    { EPIPE,           RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Send, SEND_ERRORS)
 
 /*
 Error code for recv(), recvfrom(), and recvmsg():
@@ -509,40 +535,20 @@ ENOTSOCK
         The file descriptor sockfd does not refer to a socket.
 */
 
-void Receive::SetError(Error* e, const std::string& msg, int code)
+static const Classification RECEIVE_ERRORS[] =
 {
-    switch(code)
-    {
-        case EBADF:
-        case EFAULT: 
-        case EINVAL:
-        case ENOTCONN:
-        case ENOTSOCK: 
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        case ECONNREFUSED: 
-        case ENOMEM:
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        case EAGAIN:
-        //case EWOULDBLOCK:
-        case EINTR: 
-        {
-            assert(false);
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-        {
-            SET_ERROR(e, msg, code);
-            break;
-        }
-    }
-}
+    { EBADF,           LOGIC },
+    { EFAULT,          LOGIC },
+    { EINVAL,          LOGIC },
+    { ENOTCONN,        LOGIC },
+    { ENOTSOCK,        LOGIC },
+    { ECONNREFUSED,    RUNTIME },
+    { ENOMEM,          RUNTIME },
+    { EAGAIN,          RUNTIME },
+    { EINTR,           RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Receive, RECEIVE_ERRORS)
 
 /*
 Error code for getsockname() and getpeername():
@@ -565,31 +571,17 @@ ENOTCONN
         The socket is not connected. (for getpeername() only)
 */
 
-void Name::SetError(Error* e, const std::string& msg, int code)
+static const Classification NAME_ERRORS[] =
 {
-    switch(code)
-    {
-        case EBADF:
-        case EFAULT:
-        case EINVAL:
-        case ENOTSOCK: 
-        case ENOTCONN:
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        case ENOBUFS:
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-        {
-            SET_ERROR(e, msg, code);
-            break;
-        }
-    }
-}
+    { EBADF,           LOGIC },
+    { EFAULT,          LOGIC },
+    { EINVAL,          LOGIC },
+    { ENOTSOCK,        LOGIC },
+    { ENOTCONN,        LOGIC },
+    { ENOBUFS,         RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Name, NAME_ERRORS)
 
 /*
 Error code for fcntl(F_GETFL/F_SETFL):
@@ -612,31 +604,17 @@ ENOLCK Too many segment locks open, lock table is full, or a remote
 
 // Handle fcntl with F_GETFL/F_SETFL errors 
 
-void Control::SetError(Error* e, const std::string& msg, int code)
+static const Classification CONTROL_ERRORS[] =
 {
-    switch(code)
-    {
-        case EBADF:
-        case EINVAL:
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        case EACCES:
-        case EAGAIN:
-        case EFAULT:
-        case ENOLCK:
-        {
-            SET_RUNTIME_ERROR(e, msg, code);
-            break;
-        }
-        default:
-        {
-            SET_ERROR(e, msg, code);
-            break;
-        }
-    }
-}
+    { EBADF,           LOGIC },
+    { EINVAL,          LOGIC },
+    { EACCES,          RUNTIME },
+    { EAGAIN,          RUNTIME },
+    { EFAULT,          RUNTIME },
+    { ENOLCK,          RUNTIME }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Control, CONTROL_ERRORS)
 
 /*
 // Error code for setsockopt() and getsockopt(): 
@@ -658,26 +636,16 @@ ENOPROTOOPT
 ENOTSOCK    The file descriptor sockfd does not refer to a socket.
 */
 
-void Option::SetError(Error* e, const std::string& msg, int code)
+static const Classification OPTION_ERRORS[] =
 {
-    switch(code)
-    {
-        case EBADF:
-        case EFAULT:
-        case EINVAL:
-        case ENOPROTOOPT: 
-        case ENOTSOCK:
-        {
-            SET_LOGIC_ERROR(e, msg, code);
-            break;
-        }
-        default:
-        {
-            SET_ERROR(e, msg, code);
-            break;
-        }
-    }
-}
+    { EBADF,           LOGIC },
+    { EFAULT,          LOGIC },
+    { EINVAL,          LOGIC },
+    { ENOPROTOOPT,     LOGIC },
+    { ENOTSOCK,        LOGIC }
+};
+
+IMPLEMENT_SET_SOCKET_ERROR_FOR_FUNCTION(Option, OPTION_ERRORS)
 
 //
 // Check if given error code is for system interruption 
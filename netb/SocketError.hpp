@@ -65,7 +65,7 @@ inline void SetError(Error* e, const std::string& msg)
 // Marcro below may be used to do the same thing. Only for the function on current error code, i.e., 
 // SocketError::SetError(e, msg);
 //
-#define SET_SOCKET_ERROR(e, msg) do{ SocketError::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_ERROR(e, msg) do{ if(e) SocketError::SetError(e, (Error::MessageStream() << msg)); } while(0) 
 
 //
 // Sorting error codes to classify the errors is helpful for error handling 
@@ -89,12 +89,25 @@ inline void SetError(Error* e, const std::string& msg)
         {                                                           \
             SetError(e, msg, ErrorCode::Current());                 \
         }                                                           \
+        void SetError(Error* e, const char* context, int fd,        \
+                      int code) noexcept;                           \
+        inline void SetError(Error* e, const char* context,         \
+                             int fd) noexcept                       \
+        {                                                           \
+            SetError(e, context, fd, ErrorCode::Current());         \
+        }                                                           \
     } 
 
 //
 // We declare set socket error functions in terms of the function that 
 // just retuned. Accordingly, sorting the error codes and set the error 
 // object need to be done in each function declared here. 
+//
+// The functions with a static context string and the descriptor, e.g.
+// SocketError::Send::SetError(e, "Socket::Send", fd), defer formatting of
+// the message until it is asked for. They are used on I/O paths where 
+// errors are routine, e.g. EAGAIN in non-block mode, so that nothing is 
+// allocated there. 
 // 
 
 DECLARE_SET_SOCKET_ERROR_FOR_FUNCTION(Select)
@@ -119,19 +132,19 @@ DECLARE_SET_SOCKET_ERROR_FOR_FUNCTION(Option)
 // SocketError::Open::SetError(e, msg);
 // 
 
-#define SET_SOCKET_SELECT_ERROR(e, msg) do{ SocketError::Select::SetError(e, (Error::MessageStream() << msg)); } while(0) 
-#define SET_SOCKET_OPEN_ERROR(e, msg) do{ SocketError::Open::SetError(e, (Error::MessageStream() << msg)); } while(0) 
-#define SET_SOCKET_CLOSE_ERROR(e, msg) do{ SocketError::Close::SetError(e, (Error::MessageStream() << msg)); } while(0) 
-#define SET_SOCKET_SHUTDOWN_ERROR(e, msg) do{ SocketError::Shutdown::SetError(e, (Error::MessageStream() << msg)); } while(0) 
-#define SET_SOCKET_BIND_ERROR(e, msg) do{ SocketError::Bind::SetError(e, (Error::MessageStream() << msg)); } while(0) 
-#define SET_SOCKET_CONNECT_ERROR(e, msg) do{ SocketError::Connect::SetError(e, (Error::MessageStream() << msg)); } while(0)
-#define SET_SOCKET_LISTEN_ERROR(e, msg) do{ SocketError::Listen::SetError(e, (Error::MessageStream() << msg)); } while(0)
-#define SET_SOCKET_ACCEPT_ERROR(e, msg) do{ SocketError::Accept::SetError(e, (Error::MessageStream() << msg)); } while(0)
-#define SET_SOCKET_SEND_ERROR(e, msg) do{ SocketError::Send::SetError(e, (Error::MessageStream() << msg)); } while(0) 
-#define SET_SOCKET_RECEIVE_ERROR(e, msg) do{ SocketError::Receive::SetError(e, (Error::MessageStream() << msg)); } while(0) 
-#define SET_SOCKET_NAME_ERROR(e, msg) do{ SocketError::Name::SetError(e, (Error::MessageStream() << msg)); } while(0)
-#define SET_SOCKET_CONTROL_ERROR(e, msg) do{ SocketError::Control::SetError(e, (Error::MessageStream() << msg)); } while(0)
-#define SET_SOCKET_OPTION_ERROR(e, msg) do{ SocketError::Option::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_SELECT_ERROR(e, msg) do{ if(e) SocketError::Select::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_OPEN_ERROR(e, msg) do{ if(e) SocketError::Open::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_CLOSE_ERROR(e, msg) do{ if(e) SocketError::Close::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_SHUTDOWN_ERROR(e, msg) do{ if(e) SocketError::Shutdown::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_BIND_ERROR(e, msg) do{ if(e) SocketError::Bind::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_CONNECT_ERROR(e, msg) do{ if(e) SocketError::Connect::SetError(e, (Error::MessageStream() << msg)); } while(0)
+#define SET_SOCKET_LISTEN_ERROR(e, msg) do{ if(e) SocketError::Listen::SetError(e, (Error::MessageStream() << msg)); } while(0)
+#define SET_SOCKET_ACCEPT_ERROR(e, msg) do{ if(e) SocketError::Accept::SetError(e, (Error::MessageStream() << msg)); } while(0)
+#define SET_SOCKET_SEND_ERROR(e, msg) do{ if(e) SocketError::Send::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_RECEIVE_ERROR(e, msg) do{ if(e) SocketError::Receive::SetError(e, (Error::MessageStream() << msg)); } while(0) 
+#define SET_SOCKET_NAME_ERROR(e, msg) do{ if(e) SocketError::Name::SetError(e, (Error::MessageStream() << msg)); } while(0)
+#define SET_SOCKET_CONTROL_ERROR(e, msg) do{ if(e) SocketError::Control::SetError(e, (Error::MessageStream() << msg)); } while(0)
+#define SET_SOCKET_OPTION_ERROR(e, msg) do{ if(e) SocketError::Option::SetError(e, (Error::MessageStream() << msg)); } while(0) 
 
 //
 // While in some cases, socket API returned with an error that may be recovered 
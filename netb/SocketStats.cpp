@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SocketStats.hpp"
+
+NETB_BEGIN
+
+SocketStats::SocketStats(Histogram* latency) noexcept
+: _latency(latency)
+{
+    Reset();
+}
+
+SocketStats::~SocketStats() noexcept
+{
+
+}
+
+void SocketStats::OnReceived(ssize_t n) noexcept
+{
+    Add(_receives, 1);
+    if(n > 0) Add(_bytes_received, n);
+}
+
+void SocketStats::OnSent(ssize_t n, size_t requested) noexcept
+{
+    Add(_sends, 1);
+    if(n > 0) Add(_bytes_sent, n);
+    if(n < (ssize_t)requested) Add(_partial_sends, 1);
+}
+
+void SocketStats::OnBuffered(size_t n) noexcept
+{
+    if(n > Get(_buffered_high_water))
+    {
+        _buffered_high_water.store(n, std::memory_order_relaxed);
+    }
+}
+
+void SocketStats::OnLatency(int64_t us) noexcept
+{
+    if(_latency) _latency->Record(us > 0 ? us : 0);
+}
+
+void SocketStats::Reset() noexcept
+{
+    _receives.store(0, std::memory_order_relaxed);
+    _bytes_received.store(0, std::memory_order_relaxed);
+    _sends.store(0, std::memory_order_relaxed);
+    _bytes_sent.store(0, std::memory_order_relaxed);
+    _partial_sends.store(0, std::memory_order_relaxed);
+    _buffered_high_water.store(0, std::memory_order_relaxed);
+}
+
+NETB_END
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_SOCKET_STATS_HPP
+#define NETB_SOCKET_STATS_HPP
+
+#include "Config.hpp"
+#include "Uncopyable.hpp"
+#include "Histogram.hpp"
+#include <atomic>
+#include <sys/types.h>
+
+NETB_BEGIN
+
+//
+// SocketStats counts I/O of a socket, or of all sockets of a loop, or of
+// a route of a server. Counters are relaxed atomics that are updated by
+// one thread only, usually the loop thread, with plain loads and stores,
+// so they cost no more than plain counters and may be read in any thread.
+//
+// Latency from the loop waking up to the received callback is recorded
+// to an optional histogram, which may be shared with relaxed atomics.
+// Async sockets record it only if the loop has stats enabled.
+//
+class SocketStats : private Uncopyable
+{
+public:
+    explicit SocketStats(Histogram* latency = nullptr) noexcept;
+    ~SocketStats() noexcept;
+
+    // System calls and bytes of receiving and sending
+    uint64_t Receives() const noexcept { return Get(_receives); }
+    uint64_t BytesReceived() const noexcept { return Get(_bytes_received); }
+    uint64_t Sends() const noexcept { return Get(_sends); }
+    uint64_t BytesSent() const noexcept { return Get(_bytes_sent); }
+
+    // Sends that took less than given data, the rest is buffered
+    uint64_t PartialSends() const noexcept { return Get(_partial_sends); }
+
+    // Max bytes ever waiting in sending buffer
+    uint64_t BufferedHighWater() const noexcept { return Get(_buffered_high_water); }
+
+    // Histogram of latency in microseconds, null if not recorded
+    Histogram* Latency() const noexcept { return _latency; }
+
+    // Update by the only writer thread
+    // A call returned n, negative on errors
+    void OnReceived(ssize_t n) noexcept;
+    void OnSent(ssize_t n, size_t requested) noexcept;
+    void OnBuffered(size_t n) noexcept;
+    void OnLatency(int64_t us) noexcept;
+
+    // Clear counters, not the histogram
+    void Reset() noexcept;
+
+private:
+    std::atomic<uint64_t> _receives;
+    std::atomic<uint64_t> _bytes_received;
+    std::atomic<uint64_t> _sends;
+    std::atomic<uint64_t> _bytes_sent;
+    std::atomic<uint64_t> _partial_sends;
+    std::atomic<uint64_t> _buffered_high_water;
+    Histogram* _latency;
+
+    static uint64_t Get(const std::atomic<uint64_t>& c) noexcept
+    {
+        return c.load(std::memory_order_relaxed);
+    }
+
+    // Single writer, no read-modify-write instruction is needed
+    static void Add(std::atomic<uint64_t>& c, uint64_t n) noexcept
+    {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+NETB_END
+
+#endif
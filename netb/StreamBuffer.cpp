@@ -18,6 +18,7 @@
 #include "StreamBuffer.hpp"
 #include <cstring>
 #include <cassert>
+#include <algorithm>
 
 NETB_BEGIN
 
@@ -126,7 +127,7 @@ ssize_t StreamBuffer::Readable(const char* delim) const
 {
     if(Readable() < strlen(delim)) return -1;
     const char* p1 = (const char*)Read();
-    const char* p2 = std::find_first_of(p1, (const char*)Write(), delim, delim + strlen(delim));
+    const char* p2 = std::search(p1, (const char*)Write(), delim, delim + strlen(delim));
     if(p2 == Write()) return -1;
     return p2 - p1;
 }
@@ -144,7 +145,7 @@ bool StreamBuffer::Read(void* p, size_t n, size_t* offset)
 ssize_t StreamBuffer::Peekable(size_t offset, const char delim) const
 {
     if(Peekable(offset) < sizeof(delim)) return -1;
-    const char* p1 = (const char*)Peekable(offset);
+    const char* p1 = (const char*)Peek(offset);
     const char* p2 = std::find(p1, (const char*)Write(), delim);
     if(p2 == Write()) return -1;
     return p2 - p1;
@@ -155,8 +156,8 @@ ssize_t StreamBuffer::Peekable(size_t offset, const char delim) const
 ssize_t StreamBuffer::Peekable(size_t offset, const char* delim) const
 {
     if(Peekable(offset) < strlen(delim)) return -1;
-    const char* p1 = (const char*)Peekable(offset);
-    const char* p2 = std::find_first_of(p1, (const char*)Write(), delim, delim + strlen(delim));
+    const char* p1 = (const char*)Peek(offset);
+    const char* p2 = std::search(p1, (const char*)Write(), delim, delim + strlen(delim));
     if(p2 == Write()) return -1;
     return p2 - p1;
 }
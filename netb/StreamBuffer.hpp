@@ -369,7 +369,7 @@ private:
     void Reclaim()
     {
         std::rotate(_bytes.begin(), _bytes.begin() + _opos, 
-                    _bytes.begin() + _wpos - _opos);
+                    _bytes.begin() + _wpos);
         _wpos -= _opos;
         _rpos -= _opos;
         _opos = 0;
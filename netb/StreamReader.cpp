@@ -175,7 +175,7 @@ bool StreamReader::String(std::string& s, const char delim) const
     if(n == 0) 
     {
         s.clear();
-        return true;
+        return _stream->Read(sizeof(delim));
     }
     return String(s, (size_t)n) && _stream->Read(sizeof(delim));
 }
@@ -191,7 +191,7 @@ bool StreamReader::String(std::string& s, const char* delim) const
     if(n == 0) 
     {
         s.clear();
-        return true;
+        return _stream->Read(strlen(delim));
     }
     return String(s, (size_t)n) && _stream->Read(strlen(delim));
 }
@@ -104,8 +104,8 @@ bool StreamWriter::Integer(int32_t v, size_t* offset) const
 bool StreamWriter::Integer(uint32_t v, size_t* offset) const
 {
     if(!_stream) return false;
-    uint16_t nv = htonl(v);
-    return _stream->Write(&nv, sizeof(uint16_t), offset);
+    uint32_t nv = htonl(v);
+    return _stream->Write(&nv, sizeof(uint32_t), offset);
 }
 
 bool StreamWriter::Integer(int64_t v, size_t* offset) const
@@ -0,0 +1,610 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StunMessage.hpp"
+#include "StreamWriter.hpp"
+#include "RandomReader.hpp"
+#include "RandomWriter.hpp"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+NETB_BEGIN
+
+namespace stun {
+
+// FINGERPRINT is CRC-32 of the message XOR'ed with this value (15.5)
+static const uint32_t FINGERPRINT_XOR = 0x5354554e;
+
+// Type and length of attribute
+static const size_t ATTRIBUTE_HEADER_SIZE = 4;
+
+// Attribute values are padded to 4 bytes
+static size_t Padded(size_t n)
+{
+    return (n + 3) & ~(size_t)3;
+}
+
+// CRC-32 of ISO 3309, as in FINGERPRINT
+struct Crc32Table
+{
+    uint32_t v[256];
+
+    Crc32Table()
+    {
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            v[i] = c;
+        }
+    }
+};
+
+static uint32_t Crc32(const uint8_t* p, size_t n)
+{
+    static const Crc32Table table;
+    uint32_t crc = 0xffffffff;
+    for(size_t i = 0; i < n; ++i)
+    {
+        crc = table.v[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+// SHA-1 (RFC 3174), only used for HMAC of MESSAGE-INTEGRITY
+class Sha1
+{
+public:
+    static const size_t BLOCK_SIZE = 64;
+    static const size_t DIGEST_SIZE = 20;
+
+    Sha1()
+    : _length(0)
+    , _used(0)
+    {
+        _h[0] = 0x67452301;
+        _h[1] = 0xefcdab89;
+        _h[2] = 0x98badcfe;
+        _h[3] = 0x10325476;
+        _h[4] = 0xc3d2e1f0;
+    }
+
+    void Update(const uint8_t* p, size_t n)
+    {
+        _length += n;
+        while(n > 0)
+        {
+            size_t k = std::min(n, BLOCK_SIZE - _used);
+            memcpy(_block + _used, p, k);
+            _used += k;
+            p += k;
+            n -= k;
+            if(_used == BLOCK_SIZE)
+            {
+                Transform();
+                _used = 0;
+            }
+        }
+    }
+
+    void Final(uint8_t* digest)
+    {
+        uint64_t bits = _length * 8;
+        uint8_t pad = 0x80;
+        Update(&pad, 1);
+        pad = 0;
+        while(_used != BLOCK_SIZE - 8)
+        {
+            Update(&pad, 1);
+        }
+        uint8_t len[8];
+        for(int i = 0; i < 8; ++i)
+        {
+            len[i] = (uint8_t)(bits >> (56 - i * 8));
+        }
+        Update(len, 8);
+        for(int i = 0; i < 5; ++i)
+        {
+            digest[i * 4] = (uint8_t)(_h[i] >> 24);
+            digest[i * 4 + 1] = (uint8_t)(_h[i] >> 16);
+            digest[i * 4 + 2] = (uint8_t)(_h[i] >> 8);
+            digest[i * 4 + 3] = (uint8_t)_h[i];
+        }
+    }
+
+private:
+    uint32_t _h[5];
+    uint8_t _block[BLOCK_SIZE];
+    uint64_t _length;
+    size_t _used;
+
+    static uint32_t Rotate(uint32_t v, int n)
+    {
+        return (v << n) | (v >> (32 - n));
+    }
+
+    void Transform()
+    {
+        uint32_t w[80];
+        for(int i = 0; i < 16; ++i)
+        {
+            w[i] = ((uint32_t)_block[i * 4] << 24) | ((uint32_t)_block[i * 4 + 1] << 16) |
+                   ((uint32_t)_block[i * 4 + 2] << 8) | _block[i * 4 + 3];
+        }
+        for(int i = 16; i < 80; ++i)
+        {
+            w[i] = Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = _h[0], b = _h[1], c = _h[2], d = _h[3], e = _h[4];
+        for(int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if(i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            }
+            else if(i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            }
+            else if(i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            uint32_t t = Rotate(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = Rotate(b, 30);
+            b = a;
+            a = t;
+        }
+        _h[0] += a;
+        _h[1] += b;
+        _h[2] += c;
+        _h[3] += d;
+        _h[4] += e;
+    }
+};
+
+// HMAC-SHA1 (RFC 2104)
+static void HmacSha1(const std::string& key, const uint8_t* p, size_t n, uint8_t* digest)
+{
+    uint8_t k[Sha1::BLOCK_SIZE] = { 0 };
+    if(key.size() > Sha1::BLOCK_SIZE)
+    {
+        Sha1 h;
+        h.Update((const uint8_t*)key.data(), key.size());
+        h.Final(k);
+    }
+    else
+    {
+        memcpy(k, key.data(), key.size());
+    }
+    uint8_t pad[Sha1::BLOCK_SIZE];
+    for(size_t i = 0; i < Sha1::BLOCK_SIZE; ++i)
+    {
+        pad[i] = k[i] ^ 0x36;
+    }
+    uint8_t inner[Sha1::DIGEST_SIZE];
+    Sha1 ih;
+    ih.Update(pad, sizeof(pad));
+    ih.Update(p, n);
+    ih.Final(inner);
+    for(size_t i = 0; i < Sha1::BLOCK_SIZE; ++i)
+    {
+        pad[i] = k[i] ^ 0x5c;
+    }
+    Sha1 oh;
+    oh.Update(pad, sizeof(pad));
+    oh.Update(inner, sizeof(inner));
+    oh.Final(digest);
+}
+
+// Transaction IDs must be unpredictable to resist spoofing (6), so they
+// come from the system CSPRNG, with random_device if it is unavailable
+static void RandomBytes(uint8_t* p, size_t n)
+{
+    int fd = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if(fd >= 0)
+    {
+        size_t got = 0;
+        while(got < n)
+        {
+            ssize_t r = ::read(fd, p + got, n - got);
+            if(r < 0 && errno == EINTR) continue;
+            if(r <= 0) break;
+            got += r;
+        }
+        ::close(fd);
+        if(got == n) return;
+    }
+    std::random_device random;
+    for(size_t i = 0; i < n; ++i)
+    {
+        p[i] = (uint8_t)random();
+    }
+}
+
+Message::Message()
+: _type(0)
+{
+    memset(_tid, 0, sizeof(_tid));
+}
+
+Message::Message(uint16_t method, uint16_t klass)
+: _type(0)
+{
+    // Method bits are split by class bits (6)
+    _type = (method & 0x000f) | ((method & 0x0070) << 1) | ((method & 0x0f80) << 2) | (klass & 0x0110);
+    RandomBytes(_tid, TRANSACTION_ID_SIZE);
+}
+
+Message::~Message()
+{
+
+}
+
+uint16_t Message::Method() const
+{
+    return (_type & 0x000f) | ((_type & 0x00e0) >> 1) | ((_type & 0x3e00) >> 2);
+}
+
+uint16_t Message::Class() const
+{
+    return _type & 0x0110;
+}
+
+void Message::TransactionId(const uint8_t* tid)
+{
+    assert(tid);
+    memcpy(_tid, tid, TRANSACTION_ID_SIZE);
+}
+
+void Message::AddAttribute(uint16_t type, const std::string& value)
+{
+    _attributes.push_back(Attribute(type, value));
+}
+
+const std::string* Message::GetAttribute(uint16_t type) const
+{
+    for(auto it = _attributes.begin(); it != _attributes.end(); ++it)
+    {
+        if(it->first == type)
+        {
+            return &it->second;
+        }
+    }
+    return nullptr;
+}
+
+// Address attributes (15.1, 15.2)
+//  0 | family | port | address of 4 or 16 bytes
+// Port and address of XOR-MAPPED-ADDRESS are XOR'ed with magic cookie,
+// and the transaction ID for IPv6
+bool Message::MappedAddress(SocketAddress* addr) const
+{
+    assert(addr);
+    bool xored = true;
+    const std::string* v = GetAttribute((uint16_t)ATTRIBUTE::XOR_MAPPED_ADDRESS);
+    if(!v)
+    {
+        v = GetAttribute((uint16_t)ATTRIBUTE::MAPPED_ADDRESS);
+        xored = false;
+    }
+    if(!v || v->size() < 8)
+    {
+        return false;
+    }
+    const uint8_t* p = (const uint8_t*)v->data();
+    uint8_t mask[16];
+    uint32_t cookie = htonl(MAGIC_COOKIE);
+    memcpy(mask, &cookie, 4);
+    memcpy(mask + 4, _tid, TRANSACTION_ID_SIZE);
+    if(!xored)
+    {
+        memset(mask, 0, sizeof(mask));
+    }
+    uint16_t port = (uint16_t)(((p[2] ^ mask[0]) << 8) | (p[3] ^ mask[1]));
+    if(p[1] == 0x01 && v->size() == 8)
+    {
+        sockaddr_in* sa = (sockaddr_in*)addr;
+        memset((sockaddr_storage*)addr, 0, sizeof(sockaddr_storage));
+        sa->sin_family = AF_INET;
+        sa->sin_port = htons(port);
+        uint8_t* a = (uint8_t*)&sa->sin_addr;
+        for(size_t i = 0; i < 4; ++i)
+        {
+            a[i] = p[4 + i] ^ mask[i];
+        }
+        return true;
+    }
+    if(p[1] == 0x02 && v->size() == 20)
+    {
+        sockaddr_in6* sa = (sockaddr_in6*)addr;
+        memset((sockaddr_storage*)addr, 0, sizeof(sockaddr_storage));
+        sa->sin6_family = AF_INET6;
+        sa->sin6_port = htons(port);
+        uint8_t* a = (uint8_t*)&sa->sin6_addr;
+        for(size_t i = 0; i < 16; ++i)
+        {
+            a[i] = p[4 + i] ^ mask[i];
+        }
+        return true;
+    }
+    return false;
+}
+
+bool Message::MappedAddress(const SocketAddress& addr)
+{
+    uint8_t mask[16];
+    uint32_t cookie = htonl(MAGIC_COOKIE);
+    memcpy(mask, &cookie, 4);
+    memcpy(mask + 4, _tid, TRANSACTION_ID_SIZE);
+    uint8_t v[20] = { 0 };
+    size_t n = 0;
+    const uint8_t* a = nullptr;
+    if(addr.Family() == AF_INET)
+    {
+        v[1] = 0x01;
+        a = (const uint8_t*)&((const sockaddr_in*)&addr)->sin_addr;
+        n = 4;
+    }
+    else if(addr.Family() == AF_INET6)
+    {
+        v[1] = 0x02;
+        a = (const uint8_t*)&((const sockaddr_in6*)&addr)->sin6_addr;
+        n = 16;
+    }
+    else
+    {
+        return false;
+    }
+    uint16_t port = addr.Port();
+    v[2] = (uint8_t)(port >> 8) ^ mask[0];
+    v[3] = (uint8_t)port ^ mask[1];
+    for(size_t i = 0; i < n; ++i)
+    {
+        v[4 + i] = a[i] ^ mask[i];
+    }
+    AddAttribute((uint16_t)ATTRIBUTE::XOR_MAPPED_ADDRESS, std::string((const char*)v, 4 + n));
+    return true;
+}
+
+// ERROR-CODE (15.6)
+//  0 (21 bits) | class (3 bits) | number (8 bits) | reason phrase
+void Message::ErrorCode(int code, const std::string& reason)
+{
+    assert(code >= 300 && code <= 699);
+    uint8_t v[4] = { 0, 0, (uint8_t)(code / 100), (uint8_t)(code % 100) };
+    AddAttribute((uint16_t)ATTRIBUTE::ERROR_CODE, std::string((const char*)v, 4) + reason);
+}
+
+int Message::ErrorCode(std::string* reason) const
+{
+    const std::string* v = GetAttribute((uint16_t)ATTRIBUTE::ERROR_CODE);
+    if(!v || v->size() < 4)
+    {
+        return 0;
+    }
+    if(reason)
+    {
+        *reason = v->substr(4);
+    }
+    return ((*v)[2] & 0x07) * 100 + (uint8_t)(*v)[3];
+}
+
+std::string Message::String() const
+{
+    std::ostringstream oss;
+    oss << "STUN method 0x" << std::hex << Method() << " class 0x" << Class() << " id ";
+    oss << std::setfill('0');
+    for(size_t i = 0; i < TRANSACTION_ID_SIZE; ++i)
+    {
+        oss << std::setw(2) << (unsigned int)_tid[i];
+    }
+    for(auto it = _attributes.begin(); it != _attributes.end(); ++it)
+    {
+        oss << " 0x" << std::setw(4) << it->first;
+    }
+    return oss.str();
+}
+
+// Length in header covers MESSAGE-INTEGRITY when computing HMAC, and
+// FINGERPRINT when computing CRC (15.4, 15.5), so it is patched before
+// each one
+bool Message::ToBuffer(StreamBuffer* buf, const std::string& key, bool fingerprint) const
+{
+    assert(buf);
+    StreamWriter writer(buf);
+    RandomWriter patcher(buf);
+    size_t start = buf->Peekable();
+    if(!writer.Integer(_type) || !writer.Integer((uint16_t)0) ||
+       !writer.Integer(MAGIC_COOKIE) || !writer.Bytes(_tid, TRANSACTION_ID_SIZE))
+    {
+        return false;
+    }
+    static const uint8_t zeros[4] = { 0 };
+    for(auto it = _attributes.begin(); it != _attributes.end(); ++it)
+    {
+        if(it->first == (uint16_t)ATTRIBUTE::MESSAGE_INTEGRITY ||
+           it->first == (uint16_t)ATTRIBUTE::FINGERPRINT)
+        {
+            continue; // always computed
+        }
+        size_t n = it->second.size();
+        if(n > 0xffff || !writer.Integer(it->first) || !writer.Integer((uint16_t)n) ||
+           !writer.Bytes(it->second.data(), n) || !writer.Bytes(zeros, Padded(n) - n))
+        {
+            return false;
+        }
+    }
+    size_t length = buf->Peekable() - start - HEADER_SIZE;
+    if(!key.empty())
+    {
+        length += ATTRIBUTE_HEADER_SIZE + MESSAGE_INTEGRITY_SIZE;
+        if(!patcher.Integer(start + 2, (uint16_t)length)) return false;
+        uint8_t hmac[MESSAGE_INTEGRITY_SIZE];
+        HmacSha1(key, (const uint8_t*)buf->Peek(start), buf->Peekable() - start, hmac);
+        if(!writer.Integer((uint16_t)ATTRIBUTE::MESSAGE_INTEGRITY) ||
+           !writer.Integer((uint16_t)MESSAGE_INTEGRITY_SIZE) || !writer.Bytes(hmac, sizeof(hmac)))
+        {
+            return false;
+        }
+    }
+    if(fingerprint)
+    {
+        length += ATTRIBUTE_HEADER_SIZE + FINGERPRINT_SIZE;
+        if(!patcher.Integer(start + 2, (uint16_t)length)) return false;
+        uint32_t crc = Fingerprint(buf->Peek(start), buf->Peekable() - start);
+        if(!writer.Integer((uint16_t)ATTRIBUTE::FINGERPRINT) ||
+           !writer.Integer((uint16_t)FINGERPRINT_SIZE) || !writer.Integer(crc))
+        {
+            return false;
+        }
+    }
+    return length <= 0xffff && patcher.Integer(start + 2, (uint16_t)length);
+}
+
+bool Message::FromBuffer(StreamBuffer* buf)
+{
+    assert(buf);
+    size_t size = Probe(buf->Read(), buf->Readable());
+    if(size == 0)
+    {
+        return false;
+    }
+    RandomReader reader(buf);
+    size_t start = buf->Peekable() - buf->Readable();
+    _attributes.clear();
+    _signed.clear();
+    if(!reader.Integer(start, _type) || !reader.Bytes(start + 8, _tid, TRANSACTION_ID_SIZE))
+    {
+        return false;
+    }
+    const uint8_t* msg = (const uint8_t*)buf->Read();
+    size_t offset = HEADER_SIZE;
+    while(offset < size)
+    {
+        uint16_t type, n;
+        if(offset + ATTRIBUTE_HEADER_SIZE > size ||
+           !reader.Integer(start + offset, type) || !reader.Integer(start + offset + 2, n) ||
+           offset + ATTRIBUTE_HEADER_SIZE + Padded(n) > size)
+        {
+            return false;
+        }
+        std::string value;
+        if(!reader.String(start + offset + ATTRIBUTE_HEADER_SIZE, value, (size_t)n))
+        {
+            return false;
+        }
+        // Attributes after MESSAGE-INTEGRITY are not covered by HMAC,
+        // and are ignored except FINGERPRINT (15.4)
+        bool signed_before = !_signed.empty();
+        if(type == (uint16_t)ATTRIBUTE::MESSAGE_INTEGRITY && !signed_before)
+        {
+            if(n != MESSAGE_INTEGRITY_SIZE) return false;
+            // HMAC input has length covering up to the end of this attribute
+            _signed.assign((const char*)msg, offset);
+            uint16_t length = htons((uint16_t)(offset + ATTRIBUTE_HEADER_SIZE + n - HEADER_SIZE));
+            _signed.replace(2, 2, (const char*)&length, 2);
+        }
+        else if(type == (uint16_t)ATTRIBUTE::FINGERPRINT)
+        {
+            uint32_t crc;
+            if(n != FINGERPRINT_SIZE || !reader.Integer(start + offset + ATTRIBUTE_HEADER_SIZE, crc) ||
+               crc != Fingerprint(msg, offset))
+            {
+                return false;
+            }
+            _attributes.push_back(Attribute(type, value));
+            break;
+        }
+        if(!signed_before)
+        {
+            _attributes.push_back(Attribute(type, value));
+        }
+        offset += ATTRIBUTE_HEADER_SIZE + Padded(n);
+    }
+    return buf->Read(size);
+}
+
+bool Message::CheckIntegrity(const std::string& key) const
+{
+    const std::string* v = GetAttribute((uint16_t)ATTRIBUTE::MESSAGE_INTEGRITY);
+    if(!v || _signed.empty())
+    {
+        return false;
+    }
+    uint8_t hmac[MESSAGE_INTEGRITY_SIZE];
+    HmacSha1(key, (const uint8_t*)_signed.data(), _signed.size(), hmac);
+    // Compare in constant time
+    uint8_t diff = 0;
+    for(size_t i = 0; i < MESSAGE_INTEGRITY_SIZE; ++i)
+    {
+        diff |= hmac[i] ^ (uint8_t)(*v)[i];
+    }
+    return diff == 0;
+}
+
+// The most significant 2 bits are 0, magic cookie is present, and length
+// is a multiple of 4 (6)
+size_t Message::Probe(const void* p, size_t n)
+{
+    if(p == nullptr || n < HEADER_SIZE)
+    {
+        return 0;
+    }
+    const uint8_t* b = (const uint8_t*)p;
+    uint32_t cookie;
+    memcpy(&cookie, b + 4, sizeof(cookie));
+    size_t length = ((size_t)b[2] << 8) | b[3];
+    if((b[0] & 0xc0) != 0 || ntohl(cookie) != MAGIC_COOKIE || (length & 3) != 0 ||
+       HEADER_SIZE + length > n)
+    {
+        return 0;
+    }
+    return HEADER_SIZE + length;
+}
+
+uint32_t Message::Fingerprint(const void* p, size_t n)
+{
+    assert(p);
+    return Crc32((const uint8_t*)p, n) ^ FINGERPRINT_XOR;
+}
+
+} // namespace stun
+
+NETB_END
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_STUN_MESSAGE_HPP
+#define NETB_STUN_MESSAGE_HPP
+
+#include "Config.hpp"
+#include "Uncopyable.hpp"
+#include "StreamBuffer.hpp"
+#include "SocketAddress.hpp"
+
+NETB_BEGIN
+
+namespace stun {
+
+/*
+RFC 5389    Session Traversal Utilities for NAT (STUN)    October 2008
+6. STUN Message Structure
+
+STUN messages are encoded in binary using network-oriented format
+(most significant byte or octet first, also commonly known as big-
+endian).  All STUN messages MUST start with a 20-byte header followed
+by zero or more Attributes.
+
+     0                   1                   2                   3
+     0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |0 0|     STUN Message Type     |         Message Length        |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                         Magic Cookie                          |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                                                               |
+    |                     Transaction ID (96 bits)                  |
+    |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+The message type field is decomposed further into the following
+structure:
+
+                        0                 1
+                        2  3  4 5 6 7 8 9 0 1 2 3 4 5
+                       +--+--+-+-+-+-+-+-+-+-+-+-+-+-+
+                       |M |M |M|M|M|C|M|M|M|C|M|M|M|M|
+                       |11|10|9|8|7|1|6|5|4|0|3|2|1|0|
+                       +--+--+-+-+-+-+-+-+-+-+-+-+-+-+
+
+The message length MUST contain the size, in bytes, of the message
+not including the 20-byte STUN header.  Since all STUN attributes are
+padded to a multiple of 4 bytes, the last 2 bits of this field are
+always zero.
+
+15. STUN Attributes
+
+After the STUN header are zero or more attributes.  Each attribute
+MUST be TLV encoded, with a 16-bit type, 16-bit length, and value.
+Each STUN attribute MUST end on a 32-bit boundary.
+
+Attributes with type values between 0x0000 and 0x7FFF are
+comprehension-required attributes, and those between 0x8000 and
+0xFFFF are comprehension-optional attributes.
+*/
+
+// Methods
+enum class METHOD : uint16_t
+{
+    BINDING             = 0x001
+};
+
+// Classes, bits in message type
+enum class CLASS : uint16_t
+{
+    REQUEST             = 0x000,
+    INDICATION          = 0x010,
+    SUCCESS             = 0x100,
+    ERROR               = 0x110
+};
+
+// Attribute types
+enum class ATTRIBUTE : uint16_t
+{
+    MAPPED_ADDRESS      = 0x0001,
+    USERNAME            = 0x0006,
+    MESSAGE_INTEGRITY   = 0x0008,
+    ERROR_CODE          = 0x0009,
+    UNKNOWN_ATTRIBUTES  = 0x000A,
+    REALM               = 0x0014,
+    NONCE               = 0x0015,
+    XOR_MAPPED_ADDRESS  = 0x0020,
+    SOFTWARE            = 0x8022,
+    ALTERNATE_SERVER    = 0x8023,
+    FINGERPRINT         = 0x8028
+};
+
+// Fixed fields
+const uint32_t MAGIC_COOKIE = 0x2112A442;
+const size_t HEADER_SIZE = 20;
+const size_t TRANSACTION_ID_SIZE = 12;
+
+// Sizes of attribute values
+const size_t MESSAGE_INTEGRITY_SIZE = 20;
+const size_t FINGERPRINT_SIZE = 4;
+
+//
+// STUN message with attributes in order. Attribute values are kept as
+// they are on the wire, with helpers for common attributes.
+//
+// MESSAGE-INTEGRITY (HMAC-SHA1) and FINGERPRINT (CRC-32) are computed
+// on packing, after all other attributes. The key of integrity is the
+// password for short-term credentials, or MD5(username:realm:password)
+// computed by the caller for long-term credentials.
+//
+class Message : private Uncopyable
+{
+public:
+    // Empty message, usually for unpacking
+    Message();
+
+    // Message of given method and class, with random transaction ID
+    // from the system CSPRNG
+    Message(uint16_t method, uint16_t klass);
+    ~Message();
+
+    // Type is composed of method and class
+    uint16_t Type() const { return _type; }
+    uint16_t Method() const;
+    uint16_t Class() const;
+
+    // Transaction ID, 12 bytes
+    const uint8_t* TransactionId() const { return _tid; }
+    void TransactionId(const uint8_t* tid);
+
+    // Attributes, type and value without padding
+    typedef std::pair<uint16_t, std::string> Attribute;
+    const std::vector<Attribute>& Attributes() const { return _attributes; }
+    void AddAttribute(uint16_t type, const std::string& value);
+
+    // Value of the first attribute of given type, null if none
+    const std::string* GetAttribute(uint16_t type) const;
+
+    // Mapped address, from XOR-MAPPED-ADDRESS or MAPPED-ADDRESS
+    // Return false if neither is present or valid
+    bool MappedAddress(SocketAddress* addr) const;
+
+    // Add XOR-MAPPED-ADDRESS
+    bool MappedAddress(const SocketAddress& addr);
+
+    // ERROR-CODE, e.g. 420 with reason "Unknown Attribute"
+    void ErrorCode(int code, const std::string& reason);
+
+    // Code of ERROR-CODE, 0 if none
+    int ErrorCode(std::string* reason = nullptr) const;
+
+    // To string
+    std::string String() const;
+
+    // Pack to buffer, with MESSAGE-INTEGRITY if key is given, and
+    // FINGERPRINT if required
+    bool ToBuffer(StreamBuffer* buf, const std::string& key = std::string(), bool fingerprint = true) const;
+
+    // Unpack a message at read position of the buffer
+    // FINGERPRINT is checked if present, attributes after it are ignored,
+    // and so are those after MESSAGE-INTEGRITY except FINGERPRINT
+    bool FromBuffer(StreamBuffer* buf);
+
+    // Check MESSAGE-INTEGRITY of an unpacked message with given key
+    // Return false if missing or mismatched
+    bool CheckIntegrity(const std::string& key) const;
+
+    // Check the header of a packet, without unpacking
+    // Return the size of the message, or 0 if it is not STUN
+    static size_t Probe(const void* p, size_t n);
+
+    // Value of FINGERPRINT over given bytes
+    static uint32_t Fingerprint(const void* p, size_t n);
+
+private:
+    uint16_t _type;
+    uint8_t _tid[TRANSACTION_ID_SIZE];
+    std::vector<Attribute> _attributes;
+
+    // Message before MESSAGE-INTEGRITY with length adjusted, as
+    // input of HMAC, empty if no integrity
+    std::string _signed;
+};
+
+} // namespace stun
+
+NETB_END
+
+#endif
@@ -63,6 +63,12 @@ void TcpAcceptor::SetBacklog(int backlog) noexcept
     _backlog = backlog;
 }
 
+// Tuning options, set on listening socket
+void TcpAcceptor::SetOptions(const TcpOptions& options) noexcept
+{
+    _options = options;
+}
+
 // Open with fix address or fix family with any address
 void TcpAcceptor::Open()
 {
@@ -119,6 +125,11 @@ bool TcpAcceptor::Open(const SocketAddress& addr, bool reuse_addr, bool reuse_po
     {
         return false;
     }
+    // set tuning options before listen, inherited by accepted sockets
+    if(!_options.Apply(Socket::Descriptor(), e))
+    {
+        return false;
+    }
     // bind address and listen
     return Socket::Bind(addr, e) && Socket::Listen(_backlog, e);
 }
@@ -158,7 +169,7 @@ SOCKET TcpAcceptor::Accept(Error* e) noexcept
     {
         return INVALID_SOCKET;
     }
-    return Socket::Accept(e); // block mode
+    return Accepted(Socket::Accept(e)); // block mode
 }
 
 // Accept a connection, in non-block mode with timeout
@@ -192,7 +203,7 @@ SOCKET TcpAcceptor::Accept(int timeout, Error* e) noexcept
     {
         return INVALID_SOCKET;
     }
-    return Socket::Accept(e); // non-block mode
+    return Accepted(Socket::Accept(e)); // non-block mode
 }
 
 // Accept a connection, in block mode
@@ -214,7 +225,7 @@ SOCKET TcpAcceptor::AcceptFrom(SocketAddress* addr, Error* e) noexcept
     {
         return INVALID_SOCKET;
     }
-    return Socket::AcceptFrom(addr, e); // block mode
+    return Accepted(Socket::AcceptFrom(addr, e)); // block mode
 }
 
 // Accept a connection, in non-block mode with timeout
@@ -248,7 +259,18 @@ SOCKET TcpAcceptor::AcceptFrom(SocketAddress* addr, int timeout, Error* e) noexc
     {
         return INVALID_SOCKET;
     }
-    return Socket::AcceptFrom(addr, e); // non-block mode
+    return Accepted(Socket::AcceptFrom(addr, e)); // non-block mode
+}
+
+// Options that are not inherited from listening socket
+// Failure is ignored, the connection is still usable
+SOCKET TcpAcceptor::Accepted(SOCKET s) noexcept
+{
+    if(s != INVALID_SOCKET)
+    {
+        _options.ApplyAccepted(s);
+    }
+    return s;
 }
 
 NETB_END
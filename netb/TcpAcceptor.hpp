@@ -19,6 +19,7 @@
 #define NETB_TCP_ACCEPTOR_HPP
 
 #include "Socket.hpp"
+#include "TcpOptions.hpp"
 
 NETB_BEGIN
 
@@ -50,6 +51,11 @@ public:
     // -1 for system default
     void SetBacklog(int backlog = -1) noexcept;
 
+    // Setup tuning options before open
+    // Accepted sockets inherit them from the listening socket
+    void SetOptions(const TcpOptions& options) noexcept;
+    const TcpOptions& Options() const noexcept { return _options; }
+
     // Open with fixed address, or fixed family with any address
     virtual void Open(); // throw on errors
     virtual bool Open(Error* e) noexcept;
@@ -95,6 +101,12 @@ protected:
     // Backlog for TCP listen, default is SOMAXCONN
     // -1 for default
     int _backlog; 
+
+    // Tuning options of accepted sockets
+    TcpOptions _options;
+
+    // Set up accepted socket
+    SOCKET Accepted(SOCKET s) noexcept;
 };
 
 NETB_END
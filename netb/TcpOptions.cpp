@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TcpOptions.hpp"
+
+NETB_BEGIN
+
+TcpOptions::TcpOptions() noexcept
+: _no_delay(-1)
+, _quick_ack(-1)
+, _send_buffer(-1)
+, _receive_buffer(-1)
+, _notsent_lowat(-1)
+{
+
+}
+
+TcpOptions TcpOptions::Latency() noexcept
+{
+    return TcpOptions().NoDelay(true).QuickAck(true).NotSentLowat(16 * 1024);
+}
+
+TcpOptions TcpOptions::Throughput() noexcept
+{
+    return TcpOptions().NoDelay(false).SendBuffer(4 * 1024 * 1024).ReceiveBuffer(4 * 1024 * 1024);
+}
+
+bool TcpOptions::Empty() const noexcept
+{
+    return _no_delay < 0 && _quick_ack < 0 && _send_buffer < 0 &&
+           _receive_buffer < 0 && _notsent_lowat < 0;
+}
+
+// Set an int option if it is given
+static bool SetIntOption(SOCKET s, int level, int name, int val, const char* what, Error* e) noexcept
+{
+    if(val < 0)
+    {
+        return true;
+    }
+    if(::setsockopt(s, level, name, (char*)&val, sizeof(val)) != 0)
+    {
+        SET_SOCKET_OPTION_ERROR(e, "TcpOptions::Apply [" << s << "][" << what << "," << val << "]");
+        return false;
+    }
+    return true;
+}
+
+bool TcpOptions::Apply(SOCKET s, Error* e) const noexcept
+{
+    if(!SetIntOption(s, IPPROTO_TCP, TCP_NODELAY, _no_delay, "TCP_NODELAY", e) ||
+       !SetIntOption(s, SOL_SOCKET, SO_SNDBUF, _send_buffer, "SO_SNDBUF", e) ||
+       !SetIntOption(s, SOL_SOCKET, SO_RCVBUF, _receive_buffer, "SO_RCVBUF", e))
+    {
+        return false;
+    }
+#ifdef TCP_NOTSENT_LOWAT
+    if(!SetIntOption(s, IPPROTO_TCP, TCP_NOTSENT_LOWAT, _notsent_lowat, "TCP_NOTSENT_LOWAT", e))
+    {
+        return false;
+    }
+#endif
+    return ApplyAccepted(s, e);
+}
+
+// Delayed ACK mode is not inherited, and may be reset by kernel later
+bool TcpOptions::ApplyAccepted(SOCKET s, Error* e) const noexcept
+{
+#ifdef TCP_QUICKACK
+    return SetIntOption(s, IPPROTO_TCP, TCP_QUICKACK, _quick_ack, "TCP_QUICKACK", e);
+#else
+    return true;
+#endif
+}
+
+NETB_END
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_TCP_OPTIONS_HPP
+#define NETB_TCP_OPTIONS_HPP
+
+#include "SocketConfig.hpp"
+
+NETB_BEGIN
+
+//
+// TcpOptions is a set of TCP tuning options that are applied to a socket
+// in one pass. Options that are not set keep the system defaults.
+//
+// Two profiles are predefined:
+// Latency disables Nagle and delayed ACK, and keeps unsent data in kernel
+// small so that the newest data is not queued behind stale data.
+// Throughput keeps Nagle and uses large socket buffers. Note fixed buffer
+// sizes disable auto tuning of Linux, and are capped by net.core.*mem_max.
+//
+// Options not supported by the platform are ignored.
+//
+class TcpOptions
+{
+public:
+    // All system defaults
+    TcpOptions() noexcept;
+
+    // Predefined profiles
+    static TcpOptions Latency() noexcept;
+    static TcpOptions Throughput() noexcept;
+
+    // TCP_NODELAY
+    TcpOptions& NoDelay(bool on) noexcept { _no_delay = on ? 1 : 0; return *this; }
+
+    // TCP_QUICKACK, per connection state of Linux
+    TcpOptions& QuickAck(bool on) noexcept { _quick_ack = on ? 1 : 0; return *this; }
+
+    // SO_SNDBUF and SO_RCVBUF in bytes
+    TcpOptions& SendBuffer(int size) noexcept { _send_buffer = size; return *this; }
+    TcpOptions& ReceiveBuffer(int size) noexcept { _receive_buffer = size; return *this; }
+
+    // TCP_NOTSENT_LOWAT in bytes
+    TcpOptions& NotSentLowat(int bytes) noexcept { _notsent_lowat = bytes; return *this; }
+
+    // No option is set
+    bool Empty() const noexcept;
+
+    // Set all options on a socket
+    // Buffer sizes should be set before connect or listen
+    bool Apply(SOCKET s, Error* e = nullptr) const noexcept;
+
+    // Set options on an accepted socket
+    // Others are inherited from the listening socket
+    bool ApplyAccepted(SOCKET s, Error* e = nullptr) const noexcept;
+
+private:
+    // -1 for system default
+    int _no_delay;
+    int _quick_ack;
+    int _send_buffer;
+    int _receive_buffer;
+    int _notsent_lowat;
+};
+
+NETB_END
+
+#endif
@@ -17,6 +17,8 @@
 
 #include "TcpSocket.hpp"
 #include "SocketSelector.hpp"
+#include <algorithm>
+#include <cstring>
 #include <cassert>
 
 NETB_BEGIN
@@ -71,6 +73,46 @@ TcpSocket::~TcpSocket() noexcept
 
 }
 
+// Tuning options
+void TcpSocket::SetOptions(const TcpOptions& options)
+{
+    Error e;
+    if(!SetOptions(options, &e))
+    {
+        THROW_ERROR(e);
+    }
+}
+
+// Applied at once if opened, otherwise on opening
+bool TcpSocket::SetOptions(const TcpOptions& options, Error* e) noexcept
+{
+    _options = options;
+    return !Socket::Valid() || _options.Apply(Socket::Descriptor(), e);
+}
+
+// Hold partial segments
+void TcpSocket::Cork(bool cork)
+{
+    Error e;
+    if(!Cork(cork, &e))
+    {
+        THROW_ERROR(e);
+    }
+}
+
+// TCP_NOPUSH is the similar option on BSD
+bool TcpSocket::Cork(bool cork, Error* e) noexcept
+{
+    int flag = cork ? 1 : 0;
+#if defined(TCP_CORK)
+    return Socket::SetOption(IPPROTO_TCP, TCP_CORK, &flag, sizeof(flag), e);
+#elif defined(TCP_NOPUSH)
+    return Socket::SetOption(IPPROTO_TCP, TCP_NOPUSH, &flag, sizeof(flag), e);
+#else
+    return true;
+#endif
+}
+
 // Set connected status for externally established connection
 bool TcpSocket::Connected()
 {
@@ -136,7 +178,8 @@ bool TcpSocket::Connected(SOCKET s, const SocketAddress* addr, Error* e) noexcep
 bool TcpSocket::DoConnect(const SocketAddress& addr, bool block, Error* e)
 {
     if(!Socket::Valid() && 
-       !Socket::Create(_address.Empty() ? addr.Family() : _address.Family(), SOCK_STREAM, IPPROTO_TCP, e))
+       (!Socket::Create(_address.Empty() ? addr.Family() : _address.Family(), SOCK_STREAM, IPPROTO_TCP, e) ||
+        !_options.Apply(Socket::Descriptor(), e)))
     {
         return false;
     }
@@ -192,9 +235,21 @@ bool TcpSocket::Connect(const SocketAddress& addr, int timeout, Error* e) noexce
         if(timeout > 0) // Check status in timeout
         {
             // If the status is EINPROGRESS, check ready to write in timeout
-            // Todo: More details need to check here!
+            // and then the result of connecting
             if(SocketError::InProgress() && WaitForWrite(timeout, e))
             {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                if(!Socket::GetOption(SOL_SOCKET, SO_ERROR, &err, &len, e))
+                {
+                    return false;
+                }
+                if(err != 0)
+                {
+                    SocketError::Connect::SetError(e, (Error::MessageStream() << "TcpSocket::Connect [" 
+                                                   << GetSocket() << "][" << addr.String() << "]"), err);
+                    return false;
+                }
                 RESET_ERROR(e);
                 return true;
             }
@@ -249,19 +304,24 @@ ssize_t TcpSocket::Send(StreamBuffer& buf, Error* e) noexcept
 
 // Send data over connection, in non-block mode with timeout
 // timeout of -1 for block mode
+// Mode of the socket is not changed, MSG_DONTWAIT is used instead
 ssize_t TcpSocket::Send(const void* p, size_t n, int timeout, Error* e) noexcept
 {
     if(timeout < 0) return Send(p, n, e);
-    if(!Socket::Block(false, e)) return -1;
 
-    // Here we check ready to write status first and then write.
-    // More official flow is send first, and if sending is failed 
-    // wait for ready to write event in timeout and write again.
-    if(timeout > 0 && !Socket::WaitForWrite(timeout, e))
+    // Send first, and if it would block, wait for ready to write event 
+    // in timeout and send again
+    ssize_t ret = Socket::Send(p, n, MSG_DONTWAIT, e);
+    if(ret >= 0 || timeout == 0 || !SocketError::WouldBlock())
+    {
+        return ret;
+    }
+    if(!Socket::WaitForWrite(timeout, e))
     {
         return -1;
     }
-    return Socket::Send(p, n, 0, e);
+    RESET_ERROR(e);
+    return Socket::Send(p, n, MSG_DONTWAIT, e);
 }
 
 // Send data over connection, in block mode
@@ -302,19 +362,24 @@ ssize_t TcpSocket::Receive(StreamBuffer* buf, Error* e) noexcept
 
 // Receive data from the connection, in non-block mode with timeout
 // timeout of -1 for block mode
+// Mode of the socket is not changed, MSG_DONTWAIT is used instead
 ssize_t TcpSocket::Receive(void* p, size_t n, int timeout, Error* e) noexcept
 {
     if(timeout < 0) return Receive(p, n, e);
-    if(!Socket::Block(false, e)) return -1;
 
-    // Here we check ready to write status first and then write.
-    // More official flow is send first, and if sending is failed 
-    // wait for ready to write event in timeout and write again.
-    if(timeout > 0 && !Socket::WaitForRead(timeout, e))
+    // Receive first, and if it would block, wait for ready to read event 
+    // in timeout and receive again
+    ssize_t ret = Socket::Receive(p, n, MSG_DONTWAIT, e);
+    if(ret >= 0 || timeout == 0 || !SocketError::WouldBlock())
+    {
+        return ret;
+    }
+    if(!Socket::WaitForRead(timeout, e))
     {
         return -1;
     }
-    return Socket::Receive(p, n, 0, e);
+    RESET_ERROR(e);
+    return Socket::Receive(p, n, MSG_DONTWAIT, e);
 }
 
 ssize_t TcpSocket::Receive(StreamBuffer* buf, int timeout, Error* e) noexcept
@@ -329,4 +394,205 @@ ssize_t TcpSocket::Receive(StreamBuffer* buf, int timeout, Error* e) noexcept
     return ret;
 }
 
+// Send segments in block mode if there is no deadline, otherwise with 
+// MSG_DONTWAIT, and wait for ready to write until deadline on would block
+// Segments are advanced on partial writes, so iov is changed
+bool TcpSocket::SendVector(struct iovec* iov, size_t count, const Deadline& deadline, 
+                           size_t* sent, Error* e) noexcept
+{
+    int flags = 0;
+    if(deadline == Deadline::max())
+    {
+        if(!Socket::Block(true, e)) return false;
+    }
+    else
+    {
+        flags = MSG_DONTWAIT;
+    }
+    *sent = 0;
+    while(count > 0 && iov->iov_len == 0)
+    {
+        ++iov;
+        --count;
+    }
+    while(count > 0)
+    {
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t ret = Socket::SendMessage(&msg, flags, e);
+        if(ret < 0)
+        {
+            if(flags == 0 || !SocketError::WouldBlock() || !Socket::WaitForWrite(deadline, e))
+            {
+                return false;
+            }
+            RESET_ERROR(e);
+            continue;
+        }
+        *sent += ret;
+        size_t n = ret;
+        while(count > 0 && n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if(n > 0)
+        {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+// Send all data, timeout for the whole data
+ssize_t TcpSocket::SendAll(const void* p, size_t n, int timeout, Error* e) noexcept
+{
+    struct iovec iov = { const_cast<void*>(p), n };
+    size_t sent;
+    return SendVector(&iov, 1, Socket::DeadlineAfter(timeout), &sent, e) ? (ssize_t)n : -1;
+}
+
+// Send all readable data of the buffer
+ssize_t TcpSocket::SendAll(StreamBuffer& buf, int timeout, Error* e) noexcept
+{
+    return SendAll(buf, nullptr, 0, timeout, e);
+}
+
+// Buffer and extra segments are sent with writev-like gathering writes,
+// e.g. header in buffer and body in application memory
+ssize_t TcpSocket::SendAll(StreamBuffer& buf, const struct iovec* extra, size_t count,
+                           int timeout, Error* e) noexcept
+{
+    if(count > MAX_SEND_SEGMENTS)
+    {
+        SET_LOGIC_ERROR(e, "TcpSocket::SendAll : Too many segments.", ErrorCode::INVAL);
+        return -1;
+    }
+    struct iovec iov[MAX_SEND_SEGMENTS + 1];
+    size_t readable = buf.Readable();
+    iov[0].iov_base = const_cast<void*>(buf.Read());
+    iov[0].iov_len = readable;
+    size_t total = readable;
+    for(size_t i = 0; i < count; ++i)
+    {
+        iov[i + 1] = extra[i];
+        total += extra[i].iov_len;
+    }
+    size_t sent;
+    bool ok = SendVector(iov, count + 1, Socket::DeadlineAfter(timeout), &sent, e);
+    buf.Read(std::min(sent, readable));
+    return ok ? (ssize_t)total : -1;
+}
+
+// Receive in block mode with MSG_WAITALL if there is no deadline, so 
+// usually the data comes in one call, otherwise with MSG_DONTWAIT, 
+// and wait for ready to read until deadline on would block
+ssize_t TcpSocket::ReceiveFully(void* p, size_t n, const Deadline& deadline,
+                                size_t* received, Error* e) noexcept
+{
+    int flags = MSG_DONTWAIT;
+    *received = 0;
+    if(deadline == Deadline::max())
+    {
+        if(!Socket::Block(true, e)) return -1;
+        flags = MSG_WAITALL;
+    }
+    while(*received < n)
+    {
+        ssize_t ret = Socket::Receive((char*)p + *received, n - *received, flags, e);
+        if(ret == 0)
+        {
+            return 0;
+        }
+        if(ret < 0)
+        {
+            if(flags != MSG_DONTWAIT || !SocketError::WouldBlock() || !Socket::WaitForRead(deadline, e))
+            {
+                return -1;
+            }
+            RESET_ERROR(e);
+            continue;
+        }
+        *received += ret;
+    }
+    return n;
+}
+
+// Receive exactly n bytes, timeout for the whole data
+ssize_t TcpSocket::ReceiveExactly(void* p, size_t n, int timeout, Error* e) noexcept
+{
+    size_t received;
+    return ReceiveFully(p, n, Socket::DeadlineAfter(timeout), &received, e);
+}
+
+// Readable data of the buffer is counted in, so that only the rest is 
+// received, and partial data is kept
+ssize_t TcpSocket::ReceiveExactly(StreamBuffer* buf, size_t n, int timeout, Error* e) noexcept
+{
+    size_t readable = buf->Readable();
+    if(readable >= n)
+    {
+        return n;
+    }
+    if(!buf->Writable(n - readable))
+    {
+        SET_RUNTIME_ERROR(e, "TcpSocket::ReceiveExactly : Prepare buffer failed.", ErrorCode::NOBUFS);
+        return -1;
+    }
+    size_t received;
+    ssize_t ret = ReceiveFully(buf->Write(), n - readable, Socket::DeadlineAfter(timeout), &received, e);
+    buf->Write(received);
+    return ret > 0 ? (ssize_t)n : ret;
+}
+
+// Readable data is searched first, and then only the new data with the 
+// tail that may hold part of the delimiter
+ssize_t TcpSocket::ReceiveUntil(StreamBuffer* buf, const char* delim, int timeout, Error* e) noexcept
+{
+    assert(delim && *delim);
+    size_t len = strlen(delim);
+    Deadline deadline = Socket::DeadlineAfter(timeout);
+    int flags = MSG_DONTWAIT;
+    if(deadline == Deadline::max())
+    {
+        if(!Socket::Block(true, e)) return -1;
+        flags = 0;
+    }
+    size_t searched = 0;
+    while(true)
+    {
+        const char* begin = (const char*)buf->Read();
+        const char* end = begin + buf->Readable();
+        const char* it = std::search(begin + searched, end, delim, delim + len);
+        if(it != end)
+        {
+            return it + len - begin;
+        }
+        searched = buf->Readable() < len ? 0 : buf->Readable() - len + 1;
+        if(!buf->Writable(RECEIVE_BUFFER_SIZE))
+        {
+            SET_RUNTIME_ERROR(e, "TcpSocket::ReceiveUntil : Prepare buffer failed.", ErrorCode::NOBUFS);
+            return -1;
+        }
+        ssize_t ret = Socket::Receive(buf->Write(), buf->Writable(), flags, e);
+        if(ret == 0)
+        {
+            return 0;
+        }
+        if(ret < 0)
+        {
+            if(flags == 0 || !SocketError::WouldBlock() || !Socket::WaitForRead(deadline, e))
+            {
+                return -1;
+            }
+            RESET_ERROR(e);
+            continue;
+        }
+        buf->Write(ret);
+    }
+}
+
 NETB_END
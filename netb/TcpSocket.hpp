@@ -19,6 +19,7 @@
 #define NETB_TCP_SOCKET_HPP
 
 #include "Socket.hpp"
+#include "TcpOptions.hpp"
 #include "StreamBuffer.hpp"
 
 NETB_BEGIN
@@ -49,6 +50,17 @@ public:
     // Internal SOCKET descriptor is exposed for external use, e.g. for select
     SOCKET GetSocket() const noexcept { return Socket::Descriptor(); }
 
+    // Tuning options, applied at once if the socket is opened,
+    // otherwise applied when it is opened for connecting
+    void SetOptions(const TcpOptions& options); // throw on errors
+    bool SetOptions(const TcpOptions& options, Error* e) noexcept;
+    const TcpOptions& Options() const noexcept { return _options; }
+
+    // Hold partial segments until uncorked (TCP_CORK)
+    // Uncorking sends out pending data at once
+    void Cork(bool cork); // throw on errors
+    bool Cork(bool cork, Error* e) noexcept;
+
     // Set connected status for externally established connection
     virtual bool Connected(); // throw on errors
     virtual bool Connected(Error* e) noexcept; 
@@ -94,6 +106,31 @@ public:
     virtual ssize_t Receive(void* p, size_t n, int timeout, Error* e = nullptr) noexcept;
     virtual ssize_t Receive(StreamBuffer* buf, int timeout, Error* e = nullptr) noexcept;
 
+    // Send all data over the connection, timeout for the whole data
+    // timeout of -1 for block mode
+    // Return n, or -1 on errors or timeout, when data may be partly sent
+    ssize_t SendAll(const void* p, size_t n, int timeout = -1, Error* e = nullptr) noexcept;
+
+    // Send all readable data of the buffer, and then extra segments if given,
+    // with gathering writes. Data sent from the buffer is read out anyway
+    ssize_t SendAll(StreamBuffer& buf, int timeout = -1, Error* e = nullptr) noexcept;
+    ssize_t SendAll(StreamBuffer& buf, const struct iovec* extra, size_t count,
+                    int timeout = -1, Error* e = nullptr) noexcept;
+
+    // Receive exactly n bytes from the connection, timeout for the whole data
+    // timeout of -1 for block mode
+    // Return n, 0 if the connection is closed before all data is received, 
+    // or -1 on errors or timeout. For the buffer, n bytes are readable on
+    // success, counting data already in it, and received data is kept anyway
+    ssize_t ReceiveExactly(void* p, size_t n, int timeout = -1, Error* e = nullptr) noexcept;
+    ssize_t ReceiveExactly(StreamBuffer* buf, size_t n, int timeout = -1, Error* e = nullptr) noexcept;
+
+    // Receive data to the buffer until the delimiter is in readable data
+    // timeout of -1 for block mode
+    // Return the length of readable data up to and including the delimiter,
+    // 0 if the connection is closed, or -1 on errors, timeout or full buffer
+    ssize_t ReceiveUntil(StreamBuffer* buf, const char* delim, int timeout = -1, Error* e = nullptr) noexcept;
+
 protected:
     // Initial local address: empty, fixed family, or fixed address
     SocketAddress _address;
@@ -105,8 +142,23 @@ protected:
     bool _reuse_addr;
     bool _reuse_port;
 
+    // Tuning options
+    TcpOptions _options;
+
     // Actual connect in block or non-block mode
     bool DoConnect(const SocketAddress& addr, bool block, Error* e);
+
+    // Max number of extra segments of gathering writes
+    static const size_t MAX_SEND_SEGMENTS = 15;
+
+    // Send segments until all sent or deadline, iov is consumed
+    bool SendVector(struct iovec* iov, size_t count, const Deadline& deadline, 
+                    size_t* sent, Error* e) noexcept;
+
+    // Receive n bytes until all received, closed or deadline
+    // Return n, 0 if closed, or -1 on errors or timeout
+    ssize_t ReceiveFully(void* p, size_t n, const Deadline& deadline,
+                         size_t* received, Error* e) noexcept;
 };
 
 NETB_END
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimingWheel.hpp"
+#include <chrono>
+#include <cassert>
+
+NETB_BEGIN
+
+TimingWheel::Timer::Timer() noexcept
+: _wheel(nullptr)
+, _deadline(0)
+, _tick(0)
+{
+
+}
+
+TimingWheel::Timer::~Timer() noexcept
+{
+    Cancel();
+}
+
+// Later deadline is picked up lazily when the slot is visited
+// Earlier deadline must be re-filed to not miss it
+void TimingWheel::Timer::Deadline(int64_t deadline) noexcept
+{
+    if(_wheel == nullptr)
+    {
+        _deadline = deadline;
+        return;
+    }
+    _wheel->Schedule(this, deadline);
+}
+
+void TimingWheel::Timer::Cancel() noexcept
+{
+    if(_wheel != nullptr)
+    {
+        _wheel->Cancel(this);
+    }
+}
+
+TimingWheel::TimingWheel(size_t slots, int tick) noexcept
+: _slots(slots)
+, _tick_ms(tick)
+, _tick(Now() / tick)
+, _size(0)
+{
+    assert(slots > 1);
+    assert(tick > 0);
+}
+
+// Timers are owned by users, just unlink them
+TimingWheel::~TimingWheel() noexcept
+{
+    for(size_t i = 0; i < _slots.size(); ++i)
+    {
+        while(_slots[i].Linked())
+        {
+            Cancel(static_cast<Timer*>(_slots[i].next));
+        }
+    }
+}
+
+int64_t TimingWheel::Now() noexcept
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Active timer moving to a later deadline stays in its slot
+void TimingWheel::Schedule(Timer* timer, int64_t deadline) noexcept
+{
+    assert(timer);
+    if(timer->_wheel == this && deadline >= timer->_deadline)
+    {
+        timer->_deadline = deadline;
+        return;
+    }
+    if(timer->_wheel != nullptr)
+    {
+        timer->_wheel->Cancel(timer);
+    }
+    timer->_deadline = deadline;
+    timer->_wheel = this;
+    ++_size;
+    File(timer);
+}
+
+void TimingWheel::Cancel(Timer* timer) noexcept
+{
+    assert(timer);
+    if(timer->_wheel != this)
+    {
+        return;
+    }
+    timer->Unlink();
+    timer->_wheel = nullptr;
+    --_size;
+}
+
+// File in the tick that the deadline is reached at its beginning
+// always a tick after the last processed one
+void TimingWheel::File(Timer* timer) noexcept
+{
+    int64_t tick = (timer->_deadline + _tick_ms - 1) / _tick_ms;
+    int64_t last = _tick + (int64_t)_slots.size() - 1;
+    if(tick <= _tick) tick = _tick + 1;
+    if(tick > last) tick = last; // park beyond the span
+    timer->Unlink();
+    timer->_tick = tick;
+    _slots[tick % _slots.size()].Append(timer);
+}
+
+int TimingWheel::Timeout(int64_t now) const noexcept
+{
+    if(_size == 0)
+    {
+        return -1;
+    }
+    int64_t tick = _tick + 1;
+    for(size_t i = 0; i < _slots.size(); ++i, ++tick)
+    {
+        if(_slots[tick % _slots.size()].Linked())
+        {
+            break;
+        }
+    }
+    int64_t timeout = tick * _tick_ms - now;
+    return timeout > 0 ? (int)timeout : 0;
+}
+
+// Visit passed slots, at most one round
+// Timers in a visited slot are moved to a pending list first, so that
+// callbacks may freely schedule, cancel or destroy any timers
+void TimingWheel::Advance(int64_t now) noexcept
+{
+    int64_t target = now / _tick_ms;
+    if(target <= _tick)
+    {
+        return;
+    }
+    int64_t first = target - (int64_t)_slots.size() + 1;
+    if(first <= _tick) first = _tick + 1;
+    _tick = target;
+    for(int64_t tick = first; tick <= target; ++tick)
+    {
+        Link pending;
+        Link& slot = _slots[tick % _slots.size()];
+        while(slot.Linked())
+        {
+            Link* node = slot.next;
+            node->Unlink();
+            pending.Append(node);
+        }
+        while(pending.Linked())
+        {
+            Timer* timer = static_cast<Timer*>(pending.next);
+            if(timer->_deadline > now)
+            {
+                File(timer);
+                continue;
+            }
+            Cancel(timer);
+            if(timer->_expired_callback)
+            {
+                timer->_expired_callback(timer);
+            }
+        }
+    }
+}
+
+NETB_END
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2017, Maoxu Li. http://maoxuli.com/dev
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETB_TIMING_WHEEL_HPP
+#define NETB_TIMING_WHEEL_HPP
+
+#include "Uncopyable.hpp"
+#include <functional>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+NETB_BEGIN
+
+//
+// TimingWheel is a hashed wheel of timer slots, each slot covers one tick
+// of time and keeps an intrusive list of timers that due in that tick.
+// Adding and removing a timer are O(1), and advancing the wheel only
+// visits the slots that have passed.
+//
+// Timers are owned by users, the wheel only links them. A timer may be
+// moved to a later deadline at any time without touching the wheel,
+// it is re-filed lazily when its slot comes around. So a deadline that
+// is refreshed on each I/O costs nothing but a store.
+//
+// Deadlines beyond the span of the wheel are parked in the last slot
+// and re-filed on each round.
+//
+// The wheel is not thread safe, it is driven by the owner event loop
+// and must only be used in the loop thread.
+//
+class TimingWheel : private Uncopyable
+{
+private:
+    // Node of intrusive double linked list
+    struct Link
+    {
+        Link* prev;
+        Link* next;
+
+        Link() : prev(this), next(this) { }
+        Link(const Link&) = delete;
+        Link& operator=(const Link&) = delete;
+        bool Linked() const { return next != this; }
+        void Unlink()
+        {
+            prev->next = next;
+            next->prev = prev;
+            prev = next = this;
+        }
+        void Append(Link* node)
+        {
+            node->prev = prev;
+            node->next = this;
+            prev->next = node;
+            prev = node;
+        }
+    };
+
+public:
+    //
+    // Timer linked in the wheel
+    // Deadline is absolute time in milliseconds, on the clock of Now()
+    //
+    class Timer : private Link, private Uncopyable
+    {
+    public:
+        Timer() noexcept;
+        ~Timer() noexcept;
+
+        // Notification of expiry, the timer is not active in callback
+        typedef std::function<void (Timer*)> ExpiredCallback;
+        void SetExpiredCallback(const ExpiredCallback& cb) noexcept { _expired_callback = cb; }
+
+        // Current deadline
+        int64_t Deadline() const noexcept { return _deadline; }
+
+        // Move the deadline of active timer
+        // Later deadline is only stored, earlier one re-files the timer
+        void Deadline(int64_t deadline) noexcept;
+
+        // Linked in a wheel
+        bool Active() const noexcept { return _wheel != nullptr; }
+
+        // Remove from the wheel
+        void Cancel() noexcept;
+
+    private:
+        friend class TimingWheel;
+        TimingWheel* _wheel;
+        int64_t _deadline;
+        int64_t _tick; // tick of the slot it is filed
+        ExpiredCallback _expired_callback;
+    };
+
+public:
+    // Number of slots and milliseconds per tick
+    static const size_t DEFAULT_SLOTS = 512;
+    static const int DEFAULT_TICK = 100;
+
+    explicit TimingWheel(size_t slots = DEFAULT_SLOTS, int tick = DEFAULT_TICK) noexcept;
+    ~TimingWheel() noexcept;
+
+    // Current time in milliseconds of monotonic clock
+    static int64_t Now() noexcept;
+
+    // Start a timer with deadline, or move an active timer
+    void Schedule(Timer* timer, int64_t deadline) noexcept;
+
+    // Remove a timer from the wheel
+    void Cancel(Timer* timer) noexcept;
+
+    // Number of active timers
+    size_t Size() const noexcept { return _size; }
+    bool Empty() const noexcept { return _size == 0; }
+
+    // Milliseconds from now to next non-empty tick
+    // -1 if no active timers
+    int Timeout(int64_t now) const noexcept;
+
+    // Advance the wheel to given time and notify expired timers
+    void Advance(int64_t now) noexcept;
+
+private:
+    std::vector<Link> _slots;
+    const int _tick_ms;
+    int64_t _tick; // last processed tick
+    size_t _size;
+
+    // File the timer in the slot of its deadline
+    void File(Timer* timer) noexcept;
+};
+
+NETB_END
+
+#endif
@@ -189,6 +189,7 @@ ssize_t UdpSocket::SendTo(StreamBuffer& buf, const SocketAddress& addr, Error* e
 }
 
 // Send data to given address, in non-block mode with timeout
+// Mode of the socket is not changed, MSG_DONTWAIT is used instead
 ssize_t UdpSocket::SendTo(const void* p, size_t n, const SocketAddress& addr, int timeout, Error* e) noexcept
 {
     if(timeout < 0) return SendTo(p, n, addr, e);
@@ -203,12 +204,17 @@ ssize_t UdpSocket::SendTo(const void* p, size_t n, const SocketAddress& addr, in
     {
         return false;
     }
-    if(Socket::Block(false, e)) return -1;
-    if(timeout > 0 && !Socket::WaitForWrite(timeout, e))
+    ssize_t ret = Socket::SendTo(p, n, addr, MSG_DONTWAIT, e);
+    if(ret >= 0 || timeout == 0 || !SocketError::WouldBlock())
+    {
+        return ret;
+    }
+    if(!Socket::WaitForWrite(timeout, e))
     {
         return -1;
     }
-    return Socket::SendTo(p, n, addr, 0, e);
+    RESET_ERROR(e);
+    return Socket::SendTo(p, n, addr, MSG_DONTWAIT, e);
 }
 
 // Send data to given address, in non-block mode with timeout
@@ -235,16 +241,21 @@ ssize_t UdpSocket::Send(StreamBuffer& buf, Error* e) noexcept
 }
 
 // Send data to connected address, non-block mode with timeout
+// Mode of the socket is not changed, MSG_DONTWAIT is used instead
 ssize_t UdpSocket::Send(const void* p, size_t n, int timeout, Error* e) noexcept
 {
     if(timeout < 0) return Send(p, n, e);
-    if(Socket::Block(false, e)) return -1;
-
-    if(timeout > 0 && !Socket::WaitForWrite(timeout, e))
+    ssize_t ret = Socket::Send(p, n, MSG_DONTWAIT, e);
+    if(ret >= 0 || timeout == 0 || !SocketError::WouldBlock())
+    {
+        return ret;
+    }
+    if(!Socket::WaitForWrite(timeout, e))
     {
         return -1;
     }
-    return Socket::Send(p, n, 0, e);
+    RESET_ERROR(e);
+    return Socket::Send(p, n, MSG_DONTWAIT, e);
 }
 
 // Send data to connected address, non-block mode with timeout
@@ -283,16 +294,21 @@ ssize_t UdpSocket::ReceiveFrom(StreamBuffer* buf, SocketAddress* addr, Error* e)
 }
 
 // Receive data and get remote address, non-block mode with timeout
+// Mode of the socket is not changed, MSG_DONTWAIT is used instead
 ssize_t UdpSocket::ReceiveFrom(void* p, size_t n, SocketAddress* addr, int timeout, Error* e) noexcept
 {
     if(timeout < 0) return ReceiveFrom(p, n, addr, e);
-    if(!Socket::Block(false, e)) return -1;
-
-    if(timeout > 0 && !Socket::WaitForRead(timeout, e))
+    ssize_t ret = Socket::ReceiveFrom(p, n, addr, MSG_DONTWAIT, e);
+    if(ret >= 0 || timeout == 0 || !SocketError::WouldBlock())
+    {
+        return ret;
+    }
+    if(!Socket::WaitForRead(timeout, e))
     {
         return -1;
     }
-    return Socket::ReceiveFrom(p, n, addr, 0, e);
+    RESET_ERROR(e);
+    return Socket::ReceiveFrom(p, n, addr, MSG_DONTWAIT, e);
 }
 
 // Receive data and get remote address, non-block mode with timeout
@@ -332,15 +348,22 @@ ssize_t UdpSocket::Receive(StreamBuffer* buf, Error* e) noexcept
 }
 
 // Receive data from connected address, non-block mode with timeout
+// Mode of the socket is not changed, MSG_DONTWAIT is used instead
 ssize_t UdpSocket::Receive(void* p, size_t n, int timeout, Error* e) noexcept
 {
     assert(p != NULL && n > 0);
-    if(!Socket::Block(false, e)) return -1;
-    if(timeout > 0 && !Socket::WaitForRead(timeout, e))
+    if(timeout < 0) return Receive(p, n, e);
+    ssize_t ret = Socket::Receive(p, n, MSG_DONTWAIT, e);
+    if(ret >= 0 || timeout == 0 || !SocketError::WouldBlock())
+    {
+        return ret;
+    }
+    if(!Socket::WaitForRead(timeout, e))
     {
         return -1;
     }
-    return Socket::Receive(p, n, 0, e);
+    RESET_ERROR(e);
+    return Socket::Receive(p, n, MSG_DONTWAIT, e);
 }
 
 // Receive data from connected address, non-block mode with timeout